@@ -0,0 +1,452 @@
+#include "bigint.h"
+#include "evalservice.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace calc {
+
+namespace {
+
+using Words = std::vector<std::uint32_t>;
+
+constexpr std::uint64_t kBase = BigInt::kBase;
+constexpr std::size_t kKaratsubaThreshold = 32;
+constexpr std::size_t kToomThreshold = 120;
+
+// 只读的字序列片段，避免递归时复制
+struct View {
+    const std::uint32_t* data;
+    std::size_t size;
+};
+
+View view(const Words& w)
+{
+    return View{ w.data(), w.size() };
+}
+
+View trim(View v)
+{
+    while (v.size > 0 && v.data[v.size - 1] == 0) {
+        --v.size;
+    }
+    return v;
+}
+
+View slice(View v, std::size_t from, std::size_t count)
+{
+    if (from >= v.size) {
+        return View{ v.data, 0 };
+    }
+    return trim(View{ v.data + from, std::min(count, v.size - from) });
+}
+
+void trim(Words& w)
+{
+    while (!w.empty() && w.back() == 0) {
+        w.pop_back();
+    }
+}
+
+int compare(View a, View b)
+{
+    if (a.size != b.size) {
+        return a.size < b.size ? -1 : 1;
+    }
+    for (std::size_t i = a.size; i > 0; --i) {
+        if (a.data[i - 1] != b.data[i - 1]) {
+            return a.data[i - 1] < b.data[i - 1] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// acc += v * kBase^shift
+void addInto(Words& acc, View v, std::size_t shift)
+{
+    if (acc.size() < shift + v.size + 1) {
+        acc.resize(shift + v.size + 1, 0);
+    }
+    std::uint32_t carry = 0;
+    std::size_t i = 0;
+    for (; i < v.size; ++i) {
+        std::uint32_t sum = acc[shift + i] + v.data[i] + carry;
+        carry = sum >= kBase;
+        acc[shift + i] = carry ? sum - static_cast<std::uint32_t>(kBase) : sum;
+    }
+    for (std::size_t j = shift + i; carry; ++j) {
+        if (j == acc.size()) {
+            acc.push_back(0);
+        }
+        std::uint32_t sum = acc[j] + carry;
+        carry = sum >= kBase;
+        acc[j] = carry ? sum - static_cast<std::uint32_t>(kBase) : sum;
+    }
+}
+
+Words add(View a, View b)
+{
+    Words result(a.data, a.data + a.size);
+    addInto(result, b, 0);
+    trim(result);
+    return result;
+}
+
+// a -= b，要求 a >= b
+void subtractFrom(Words& a, View b)
+{
+    std::uint32_t borrow = 0;
+    std::size_t i = 0;
+    for (; i < b.size; ++i) {
+        const std::uint32_t sub = b.data[i] + borrow;
+        borrow = a[i] < sub;
+        a[i] = borrow ? static_cast<std::uint32_t>(a[i] + kBase - sub) : a[i] - sub;
+    }
+    for (; borrow; ++i) {
+        borrow = a[i] == 0;
+        a[i] = borrow ? static_cast<std::uint32_t>(kBase - 1) : a[i] - 1;
+    }
+    trim(a);
+}
+
+Words multiply(View a, View b);
+
+Words multiplySchool(View a, View b)
+{
+    Words result(a.size + b.size, 0);
+    for (std::size_t i = 0; i < a.size; ++i) {
+        const std::uint64_t x = a.data[i];
+        if (x == 0) {
+            continue;
+        }
+        std::uint64_t carry = 0;
+        std::uint32_t* out = result.data() + i;
+        for (std::size_t j = 0; j < b.size; ++j) {
+            const std::uint64_t cur = out[j] + x * b.data[j] + carry;
+            carry = cur / kBase;
+            out[j] = static_cast<std::uint32_t>(cur - carry * kBase);
+        }
+        out[b.size] = static_cast<std::uint32_t>(carry);
+    }
+    trim(result);
+    return result;
+}
+
+Words multiplyKaratsuba(View a, View b)
+{
+    // (a1·X + a0)(b1·X + b0) = z2·X² + ((a0+a1)(b0+b1) - z0 - z2)·X + z0
+    const std::size_t m = (std::max(a.size, b.size) + 1) / 2;
+    const View a0 = slice(a, 0, m), a1 = slice(a, m, a.size);
+    const View b0 = slice(b, 0, m), b1 = slice(b, m, b.size);
+
+    const Words z0 = multiply(a0, b0);
+    const Words z2 = multiply(a1, b1);
+    const Words sa = add(a0, a1);
+    const Words sb = add(b0, b1);
+    Words z1 = multiply(view(sa), view(sb));
+    subtractFrom(z1, view(z0));
+    subtractFrom(z1, view(z2));
+
+    Words result(a.size + b.size + 1, 0);
+    addInto(result, view(z0), 0);
+    addInto(result, view(z1), m);
+    addInto(result, view(z2), 2 * m);
+    trim(result);
+    return result;
+}
+
+// Toom-3 插值需要的带符号中间量
+struct Signed {
+    Words mag;
+    bool negative = false;
+};
+
+Signed makeSigned(View v)
+{
+    return Signed{ Words(v.data, v.data + v.size), false };
+}
+
+Signed addSigned(const Signed& a, const Signed& b, bool negateB = false)
+{
+    const bool bNegative = b.negative != negateB;
+    if (a.negative == bNegative) {
+        return Signed{ add(view(a.mag), view(b.mag)), a.negative };
+    }
+    if (compare(view(a.mag), view(b.mag)) >= 0) {
+        Signed result{ a.mag, a.negative };
+        subtractFrom(result.mag, view(b.mag));
+        result.negative = !result.mag.empty() && result.negative;
+        return result;
+    }
+    Signed result{ b.mag, bNegative };
+    subtractFrom(result.mag, view(a.mag));
+    result.negative = !result.mag.empty() && result.negative;
+    return result;
+}
+
+Signed subSigned(const Signed& a, const Signed& b)
+{
+    return addSigned(a, b, true);
+}
+
+Signed mulSigned(const Signed& a, const Signed& b)
+{
+    Signed result{ multiply(view(a.mag), view(b.mag)), false };
+    result.negative = !result.mag.empty() && a.negative != b.negative;
+    return result;
+}
+
+Signed mulSmall(Signed a, std::uint32_t factor)
+{
+    std::uint64_t carry = 0;
+    for (std::uint32_t& w : a.mag) {
+        const std::uint64_t cur = static_cast<std::uint64_t>(w) * factor + carry;
+        carry = cur / kBase;
+        w = static_cast<std::uint32_t>(cur - carry * kBase);
+    }
+    if (carry) {
+        a.mag.push_back(static_cast<std::uint32_t>(carry));
+    }
+    return a;
+}
+
+// 插值中的除法都是整除
+Signed divExact(Signed a, std::uint32_t divisor)
+{
+    std::uint64_t remainder = 0;
+    for (std::size_t i = a.mag.size(); i > 0; --i) {
+        const std::uint64_t cur = remainder * kBase + a.mag[i - 1];
+        a.mag[i - 1] = static_cast<std::uint32_t>(cur / divisor);
+        remainder = cur % divisor;
+    }
+    assert(remainder == 0);
+    trim(a.mag);
+    return a;
+}
+
+Words multiplyToom3(View a, View b)
+{
+    const std::size_t k = (std::max(a.size, b.size) + 2) / 3;
+    const View a0 = slice(a, 0, k), a1 = slice(a, k, k), a2 = slice(a, 2 * k, a.size);
+    const View b0 = slice(b, 0, k), b1 = slice(b, k, k), b2 = slice(b, 2 * k, b.size);
+
+    // 在 0, 1, -1, -2, ∞ 五个点求值
+    auto evaluate = [](View x0, View x1, View x2, Signed* at) {
+        const Signed s0 = makeSigned(x0), s1 = makeSigned(x1), s2 = makeSigned(x2);
+        const Signed p = addSigned(s0, s2);
+        at[0] = s0;
+        at[1] = addSigned(p, s1);
+        at[2] = subSigned(p, s1);
+        at[3] = subSigned(mulSmall(addSigned(at[2], s2), 2), s0);
+        at[4] = s2;
+    };
+    Signed pa[5], pb[5];
+    evaluate(a0, a1, a2, pa);
+    evaluate(b0, b1, b2, pb);
+
+    const Signed r0 = mulSigned(pa[0], pb[0]);
+    const Signed r1 = mulSigned(pa[1], pb[1]);
+    const Signed rm1 = mulSigned(pa[2], pb[2]);
+    const Signed rm2 = mulSigned(pa[3], pb[3]);
+    const Signed rinf = mulSigned(pa[4], pb[4]);
+
+    // Bodrato 插值序列
+    Signed t3 = divExact(subSigned(rm2, r1), 3);
+    Signed t1 = divExact(subSigned(r1, rm1), 2);
+    Signed t2 = subSigned(rm1, r0);
+    t3 = addSigned(divExact(subSigned(t2, t3), 2), mulSmall(rinf, 2));
+    t2 = subSigned(addSigned(t2, t1), rinf);
+    t1 = subSigned(t1, t3);
+    assert(!t1.negative && !t2.negative && !t3.negative);
+
+    Words result(a.size + b.size + 1, 0);
+    addInto(result, view(r0.mag), 0);
+    addInto(result, view(t1.mag), k);
+    addInto(result, view(t2.mag), 2 * k);
+    addInto(result, view(t3.mag), 3 * k);
+    addInto(result, view(rinf.mag), 4 * k);
+    trim(result);
+    return result;
+}
+
+Words multiply(View a, View b)
+{
+    a = trim(a);
+    b = trim(b);
+    if (a.size < b.size) {
+        std::swap(a, b);
+    }
+    if (b.size == 0) {
+        return Words();
+    }
+    if (b.size < kKaratsubaThreshold) {
+        return multiplySchool(a, b);
+    }
+
+    // 长度悬殊：把长的一边按短边长度切块，逐块相乘后错位相加
+    if (a.size >= 2 * b.size) {
+        Words result(a.size + b.size + 1, 0);
+        for (std::size_t from = 0; from < a.size; from += b.size) {
+            const Words part = multiply(slice(a, from, b.size), b);
+            addInto(result, view(part), from);
+        }
+        trim(result);
+        return result;
+    }
+
+    return b.size < kToomThreshold ? multiplyKaratsuba(a, b) : multiplyToom3(a, b);
+}
+
+// 质数筛，返回不超过 n 的全部质数
+std::vector<std::uint32_t> primesUpTo(std::uint32_t n)
+{
+    std::vector<bool> composite(static_cast<std::size_t>(n) + 1, false);
+    std::vector<std::uint32_t> primes;
+    for (std::uint32_t i = 2; i <= n; ++i) {
+        if (composite[i]) {
+            continue;
+        }
+        primes.push_back(i);
+        for (std::uint64_t j = static_cast<std::uint64_t>(i) * i; j <= n; j += i) {
+            composite[static_cast<std::size_t>(j)] = true;
+        }
+    }
+    return primes;
+}
+
+// 二分乘积树，保证每次乘法两边规模接近
+Words product(const std::vector<std::uint32_t>& factors, std::size_t begin, std::size_t end)
+{
+    if (end - begin == 1) {
+        return Words(1, factors[begin]);
+    }
+    const std::size_t mid = begin + (end - begin) / 2;
+    const Words left = product(factors, begin, mid);
+    const Words right = product(factors, mid, end);
+    return multiply(view(left), view(right));
+}
+
+// n 的摆动阶乘 n≀ = n! / ((n/2)!)²，等于满足条件的质数幂之积
+Words swing(std::uint32_t n, const std::vector<std::uint32_t>& primes)
+{
+    // 把质数幂先在单字内相乘，凑满接近 10^9 再进入乘积树
+    std::vector<std::uint32_t> factors;
+    std::uint64_t packed = 1;
+    for (const std::uint32_t p : primes) {
+        if (p > n) {
+            break;
+        }
+        std::uint64_t power = 1;
+        for (std::uint32_t q = n / p; q > 0; q /= p) {
+            if (q & 1) {
+                power *= p;
+            }
+        }
+        if (power == 1) {
+            continue;
+        }
+        if (packed * power >= kBase) {
+            factors.push_back(static_cast<std::uint32_t>(packed));
+            packed = 1;
+        }
+        packed *= power;
+    }
+    factors.push_back(static_cast<std::uint32_t>(packed));
+    return product(factors, 0, factors.size());
+}
+
+char* putWord(char* out, std::uint32_t word, bool pad)
+{
+    char digits[BigInt::kBaseDigits];
+    std::size_t length = 0;
+    do {
+        digits[length++] = static_cast<char>('0' + word % 10);
+        word /= 10;
+    } while (word > 0);
+    if (pad) {
+        for (; length < BigInt::kBaseDigits; ++length) {
+            digits[length] = '0';
+        }
+    }
+    while (length > 0) {
+        *out++ = digits[--length];
+    }
+    return out;
+}
+
+} // namespace
+
+BigInt::BigInt(std::uint64_t value)
+{
+    while (value > 0) {
+        words.push_back(static_cast<std::uint32_t>(value % kBase));
+        value /= kBase;
+    }
+}
+
+std::size_t BigInt::digitCount() const
+{
+    if (words.empty()) {
+        return 1;
+    }
+    std::size_t digits = (words.size() - 1) * kBaseDigits;
+    for (std::uint32_t top = words.back(); top > 0; top /= 10) {
+        ++digits;
+    }
+    return digits;
+}
+
+BigInt operator*(const BigInt& a, const BigInt& b)
+{
+    BigInt result;
+    result.words = multiply(view(a.words), view(b.words));
+    return result;
+}
+
+std::optional<BigInt> BigInt::factorial(std::uint32_t n, JobContext* job)
+{
+    BigInt result(1);
+    if (n < 2) {
+        return result;
+    }
+
+    // n! = ((n/2)!)² · n≀，从最小的 n >> k 开始向上迭代
+    const std::vector<std::uint32_t> primes = primesUpTo(n);
+    std::vector<std::uint32_t> steps;
+    for (std::uint32_t m = n; m >= 2; m /= 2) {
+        steps.push_back(m);
+    }
+    for (std::size_t i = steps.size(); i > 0; --i) {
+        if (job && job->isCancelled()) {
+            return std::nullopt;
+        }
+        const std::uint32_t m = steps[i - 1];
+        const Words squared = multiply(view(result.words), view(result.words));
+        const Words swung = swing(m, primes);
+        result.words = multiply(view(squared), view(swung));
+        if (job) {
+            // 最后几步占绝大部分时间，按 m / n 粗略估计进度
+            job->reportProgress(static_cast<double>(m) / n);
+        }
+    }
+    return result;
+}
+
+std::size_t BigInt::writeDecimal(std::size_t first, std::size_t count, char* out) const
+{
+    char* const begin = out;
+    for (std::size_t i = first; i < first + count && i < words.size(); ++i) {
+        out = putWord(out, words[words.size() - 1 - i], i != 0);
+    }
+    return static_cast<std::size_t>(out - begin);
+}
+
+std::string BigInt::toString() const
+{
+    std::string text;
+    text.reserve(digitCount());
+    writeDecimal([&text](std::string_view chunk) { text.append(chunk.data(), chunk.size()); });
+    return text;
+}
+
+} // namespace calc
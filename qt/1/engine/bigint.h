@@ -0,0 +1,71 @@
+#ifndef CALC_BIGINT_H
+#define CALC_BIGINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace calc {
+
+class JobContext;
+
+// 非负任意精度整数，用于精确阶乘。
+//
+// 以 10^9 为基数存放（低位在前），十进制输出不需要进制转换，可以按段流式写出。
+// 乘法按规模选择算法：小于 kKaratsubaThreshold 个字用竖式，
+// 小于 kToomThreshold 用 Karatsuba，更大用 Toom-3；两边长度悬殊时先切块
+class BigInt
+{
+public:
+    static constexpr std::uint32_t kBase = 1000000000;
+    static constexpr std::size_t kBaseDigits = 9;
+
+    BigInt() = default;
+    explicit BigInt(std::uint64_t value);
+
+    bool isZero() const { return words.empty(); }
+    std::size_t wordCount() const { return words.size(); }
+    std::size_t digitCount() const;
+
+    friend BigInt operator*(const BigInt& a, const BigInt& b);
+    bool operator==(const BigInt& other) const { return words == other.words; }
+
+    // 用质数摆动（prime swing）算法求 n!；job 被取消时返回空
+    static std::optional<BigInt> factorial(std::uint32_t n, JobContext* job = nullptr);
+
+    // 从最高位起第 first 个字开始，写出 count 个字对应的十进制数字，返回写入的字节数。
+    // out 至少需要 count * kBaseDigits 字节；最高字不补前导 0，其余每字固定 9 位
+    std::size_t writeDecimal(std::size_t first, std::size_t count, char* out) const;
+
+    // 以约 4KB 一段的方式依次把十进制数字交给 sink(std::string_view)
+    template <typename Sink>
+    void writeDecimal(Sink&& sink) const;
+
+    std::string toString() const;
+
+private:
+    std::vector<std::uint32_t> words;  // 低位在前，没有多余的高位 0
+
+    static constexpr std::size_t kChunkWords = 455;
+};
+
+template <typename Sink>
+void BigInt::writeDecimal(Sink&& sink) const
+{
+    if (words.empty()) {
+        sink(std::string_view("0", 1));
+        return;
+    }
+    char buffer[kChunkWords * kBaseDigits];
+    for (std::size_t first = 0; first < words.size(); first += kChunkWords) {
+        const std::size_t count = words.size() - first < kChunkWords ? words.size() - first : kChunkWords;
+        sink(std::string_view(buffer, writeDecimal(first, count, buffer)));
+    }
+}
+
+} // namespace calc
+
+#endif // CALC_BIGINT_H
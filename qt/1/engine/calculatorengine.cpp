@@ -0,0 +1,894 @@
+#include "calculatorengine.h"
+#include "evalservice.h"
+#include "parser.h"
+
+#include <charconv>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+namespace calc {
+
+namespace {
+
+std::string_view trimmed(std::string_view text)
+{
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front()))) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+char symbolOf(OpCode op)
+{
+    switch (op) {
+    case OpCode::Add: return '+';
+    case OpCode::Sub: return '-';
+    case OpCode::Mul: return '*';
+    case OpCode::Div: return '/';
+    case OpCode::Mod: return '%';
+    case OpCode::Pow: return '^';
+    default: return 0;
+    }
+}
+
+// 超出 double 范围的大整数按 formatNumber 的科学计数法写出近似值，如 171! 为 1.241018e+309
+std::size_t formatApproximation(const BigInt& value, char* buffer)
+{
+    char digits[2 * BigInt::kBaseDigits];
+    const std::size_t words = std::min<std::size_t>(value.wordCount(), 2);
+    const std::size_t length = value.writeDecimal(0, words, digits);
+    // 取 7 位有效数字，按第 8 位四舍五入，可能进位成 10000000
+    unsigned long mantissa = 0;
+    for (std::size_t i = 0; i < 7; ++i) {
+        mantissa = mantissa * 10 + static_cast<unsigned long>(i < length ? digits[i] - '0' : 0);
+    }
+    std::size_t exponent = value.digitCount() - 1;
+    if (length > 7 && digits[7] >= '5' && ++mantissa == 10000000) {
+        mantissa = 1000000;
+        ++exponent;
+    }
+    const int written = std::snprintf(buffer, kNumberBufferSize, "%lu.%06lue+%zu", mantissa / 1000000,
+                                      mantissa % 1000000, exponent);
+    return static_cast<std::size_t>(written);
+}
+
+} // namespace
+
+std::optional<Key> keyFromChar(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return static_cast<Key>(static_cast<int>(Key::Digit0) + (c - '0'));
+    }
+    switch (c) {
+    case '.': return Key::Point;
+    case '+': return Key::Add;
+    case '-': return Key::Subtract;
+    case '*': return Key::Multiply;
+    case '/': return Key::Divide;
+    case '%': return Key::Modulo;
+    case '^': return Key::Power;
+    case '(': return Key::OpenParen;
+    case ')': return Key::CloseParen;
+    case '~': return Key::ToggleSign;
+    case '<': return Key::Backspace;
+    case 'e': return Key::ClearEntry;
+    case 'c': return Key::ClearAll;
+    case '=': return Key::Equals;
+    case 'z': return Key::Undo;
+    case 'y': return Key::Redo;
+    case 's': return Key::Square;
+    case 'r': return Key::SquareRoot;
+    case 'l': return Key::NaturalLog;
+    case 'g': return Key::Log10;
+    case '!': return Key::Factorial;
+    case 'M': return Key::MemoryStore;
+    case 'R': return Key::MemoryRecall;
+    case 'P': return Key::MemoryAdd;
+    case 'N': return Key::MemorySubtract;
+    case 'X': return Key::MemoryClear;
+    case 'a': return Key::ToggleAngle;
+    default: return std::nullopt;
+    }
+}
+
+const char* describe(ErrorCode error)
+{
+    switch (error) {
+    case ErrorCode::None:
+        return "ok";
+    case ErrorCode::MathError:
+        return "math error";
+    case ErrorCode::DivisionByZero:
+        return "division by zero";
+    case ErrorCode::Overflow:
+        return "overflow";
+    case ErrorCode::InvalidExpression:
+        return "invalid expression";
+    case ErrorCode::NegativeSquareRoot:
+        return "square root of a negative number";
+    case ErrorCode::NonPositiveLog:
+        return "logarithm of a non-positive number";
+    case ErrorCode::FactorialRange:
+        return "factorial out of range";
+    case ErrorCode::TanUndefined:
+        return "tan undefined";
+    case ErrorCode::EmptyMemory:
+        return "memory empty";
+    case ErrorCode::Cancelled:
+        return "cancelled";
+    }
+    return "unknown error";
+}
+
+ErrorCode diagnoseFailure(const Expression& expression, const EvalOptions& options)
+{
+    if (!expression.isValid()) {
+        return ErrorCode::InvalidExpression;
+    }
+
+    // 与 Expression::evaluate 相同的栈式求值，只是每一步都检查结果。
+    // 只在出错之后调用一次，不在乎多出的开销
+    std::vector<double> stack;
+    stack.reserve(static_cast<std::size_t>(expression.maxStackDepth()));
+    for (const Instruction& ins : expression.code()) {
+        if (ins.op == OpCode::PushConst) {
+            // 超出 double 范围的字面量，如大数阶乘结果的近似值
+            if (std::isinf(ins.value)) {
+                return ErrorCode::Overflow;
+            }
+            stack.push_back(ins.value);
+            continue;
+        }
+        if (ins.op == OpCode::PushVar) {
+            stack.push_back(options.x);
+            continue;
+        }
+
+        double result;
+        double operand;
+        if (isBinary(ins.op)) {
+            operand = stack.back();
+            stack.pop_back();
+            const double lhs = stack.back();
+            if ((ins.op == OpCode::Div || ins.op == OpCode::Mod) && isZeroDivisor(operand)) {
+                return ErrorCode::DivisionByZero;
+            }
+            result = applyBinary(ins.op, lhs, operand);
+            if (std::isnan(lhs) || std::isinf(lhs)) {
+                return ErrorCode::MathError;
+            }
+        }
+        else {
+            operand = stack.back();
+            result = applyUnary(ins.op, operand, options);
+            if (std::isnan(result) && !std::isnan(operand)) {
+                switch (ins.op) {
+                case OpCode::Sqrt: return ErrorCode::NegativeSquareRoot;
+                case OpCode::Ln:
+                case OpCode::Log10: return ErrorCode::NonPositiveLog;
+                case OpCode::Tan: return ErrorCode::TanUndefined;
+                case OpCode::Factorial: return ErrorCode::FactorialRange;
+                default: break;
+                }
+            }
+        }
+        if (std::isnan(operand) || std::isinf(operand)) {
+            return ErrorCode::MathError;
+        }
+        if (std::isinf(result)) {
+            return ErrorCode::Overflow;
+        }
+        if (std::isnan(result)) {
+            return ErrorCode::MathError;
+        }
+        stack.back() = result;
+    }
+    return ErrorCode::MathError;
+}
+
+OpCode functionOf(Key key)
+{
+    switch (key) {
+    case Key::Square: return OpCode::Square;
+    case Key::SquareRoot: return OpCode::Sqrt;
+    case Key::NaturalLog: return OpCode::Ln;
+    case Key::Log10: return OpCode::Log10;
+    case Key::Factorial: return OpCode::Factorial;
+    default: return OpCode::PushConst;
+    }
+}
+
+void CalculatorEngine::StateStack::push(const CalculatorState& state)
+{
+    if (count < slots.size()) {
+        slots[(first + count) % slots.size()] = state;
+        ++count;
+    }
+    else if (slots.size() < kUndoLimit) {
+        // 还没攒满时 first 总是 0，直接在末尾扩充
+        slots.push_back(state);
+        ++count;
+    }
+    else {
+        slots[first] = state;
+        first = (first + 1) % slots.size();
+    }
+}
+
+bool CalculatorEngine::StateStack::pop(CalculatorState& state)
+{
+    if (count == 0) {
+        return false;
+    }
+    --count;
+    state = slots[(first + count) % slots.size()];
+    return true;
+}
+
+CalculatorEngine::CalculatorEngine(const CalculatorState& state)
+    : current(state)
+{
+    recompileRepeat();
+}
+
+void CalculatorEngine::setState(const CalculatorState& state)
+{
+    pushUndo();
+    current = state;
+    recompileRepeat();
+    touch(0);
+}
+
+void CalculatorEngine::recompileRepeat()
+{
+    repeatExpression = current.repeatSuffix.empty() ? Expression() : Expression::compile("x" + current.repeatSuffix.str());
+    EvalOptions options;
+    options.angleInDegrees = current.angleInDegrees;
+    repeatProgram = Program::compile(repeatExpression, options);
+}
+
+void CalculatorEngine::pushUndo()
+{
+    undoStack.push(current);
+    redoStack.clear();
+}
+
+void CalculatorEngine::restore(const CalculatorState& state)
+{
+    // 内存和设置不属于输入历史，保持当前值
+    CalculatorState next = state;
+    next.memoryValue = current.memoryValue;
+    next.hasMemoryValue = current.hasMemoryValue;
+    next.angleInDegrees = current.angleInDegrees;
+    next.adaptivePrecision = current.adaptivePrecision;
+    current = std::move(next);
+    recompileRepeat();
+    touch(0);
+}
+
+bool CalculatorEngine::undo()
+{
+    if (undoStack.empty()) {
+        return false;
+    }
+    redoStack.push(current);
+    CalculatorState previous;
+    undoStack.pop(previous);
+    restore(previous);
+    return true;
+}
+
+bool CalculatorEngine::redo()
+{
+    if (redoStack.empty()) {
+        return false;
+    }
+    undoStack.push(current);
+    CalculatorState next;
+    redoStack.pop(next);
+    restore(next);
+    return true;
+}
+
+ErrorCode CalculatorEngine::press(Key key, std::string* historyEntry)
+{
+    if (key <= Key::Digit9) {
+        inputDigit(static_cast<char>('0' + static_cast<int>(key)));
+        return ErrorCode::None;
+    }
+    switch (key) {
+    case Key::Point: inputDecimalPoint(); break;
+    case Key::Add: inputOperator(OpCode::Add); break;
+    case Key::Subtract: inputOperator(OpCode::Sub); break;
+    case Key::Multiply: inputOperator(OpCode::Mul); break;
+    case Key::Divide: inputOperator(OpCode::Div); break;
+    case Key::Modulo: inputOperator(OpCode::Mod); break;
+    case Key::Power: inputOperator(OpCode::Pow); break;
+    case Key::OpenParen: openParenthesis(); break;
+    case Key::CloseParen: closeParenthesis(); break;
+    case Key::ToggleSign: toggleSign(); break;
+    case Key::Backspace: backspace(); break;
+    case Key::ClearEntry: clearEntry(); break;
+    case Key::ClearAll: clearAll(); break;
+    case Key::Equals: return equals(historyEntry);
+    case Key::Undo: undo(); break;
+    case Key::Redo: redo(); break;
+    case Key::Square:
+    case Key::SquareRoot:
+    case Key::NaturalLog:
+    case Key::Log10:
+    case Key::Factorial:
+        return applyFunction(functionOf(key));
+    case Key::MemoryStore: memoryStore(); break;
+    case Key::MemoryRecall: return memoryRecall();
+    case Key::MemoryAdd: memoryAdd(); break;
+    case Key::MemorySubtract: memorySubtract(); break;
+    case Key::MemoryClear: memoryClear(); break;
+    case Key::ToggleAngle: toggleAngleUnit(); break;
+    default: break;
+    }
+    return ErrorCode::None;
+}
+
+void CalculatorEngine::inputDigit(char digit)
+{
+    pushUndo();
+    CalculatorState& s = current;
+    s.exactValue.reset();
+    multiplyAfterGroup();
+    if (s.hasResult && s.waitingForOperand) {
+        // 如果刚计算完结果，开始新的输入
+        s.currentNumber.assign(&digit, 1);
+        s.hasResult = false;
+        s.waitingForOperand = false;
+    }
+    else if (s.waitingForOperand || s.currentNumber == "0") {
+        s.currentNumber.assign(&digit, 1);
+        s.waitingForOperand = false;
+    }
+    else if (s.currentNumber.size() < 15) {
+        // 限制数字长度，防止显示溢出
+        s.currentNumber += digit;
+    }
+}
+
+void CalculatorEngine::inputDecimalPoint()
+{
+    pushUndo();
+    CalculatorState& s = current;
+    s.exactValue.reset();
+    multiplyAfterGroup();
+    if (s.hasResult && s.waitingForOperand) {
+        // 如果刚计算完结果，开始新的小数
+        s.currentNumber = "0.";
+        s.hasResult = false;
+    }
+    else if (s.waitingForOperand || s.currentNumber.empty() || s.currentNumber == "0") {
+        s.currentNumber = "0.";
+    }
+    else if (s.currentNumber.find('.') == std::string::npos) {
+        s.currentNumber += '.';
+    }
+    s.waitingForOperand = false;
+}
+
+void CalculatorEngine::inputOperator(OpCode op)
+{
+    pushUndo();
+    CalculatorState& s = current;
+    s.exactValue.reset();
+    const char lastTail[] = { ' ', symbolOf(s.lastOperator), ' ' };
+
+    if (s.waitingForOperand && !s.hasResult && s.lastOperator != OpCode::PushConst && s.displayText.endsWith(std::string_view(lastTail, 3))) {
+        // 连续按下运算符：替换表达式末尾的运算符
+        s.displayText = s.displayText.erase(s.displayText.size() - 3);
+        touch(s.displayText.size());
+    }
+    else if (s.hasResult || s.displayText.empty()) {
+        // 以当前数字（或上次结果）开始新的表达式
+        s.displayText = Rope(s.currentNumber);
+        touch(0);
+    }
+    else {
+        // 连续运算：把当前数字追加到表达式，按优先级统一求值
+        touch(s.displayText.size());
+        s.displayText += s.currentNumber;
+    }
+    const char tail[] = { ' ', symbolOf(op), ' ' };
+    s.displayText += std::string_view(tail, 3);
+    s.lastOperator = op;
+    s.waitingForOperand = true;
+    s.hasResult = false;
+}
+
+void CalculatorEngine::openParenthesis()
+{
+    CalculatorState& s = current;
+    pushUndo();
+    if (!s.waitingForOperand) {
+        // 数字或刚闭合的括号后面直接开括号，按省略了乘号处理：2(3) 即 2 * (3)
+        s.exactValue.reset();
+        if (s.hasResult || s.displayText.empty()) {
+            s.displayText = Rope(s.currentNumber);
+            s.hasResult = false;
+            touch(0);
+        }
+        else {
+            touch(s.displayText.size());
+            s.displayText += s.currentNumber;
+        }
+        s.currentNumber.clear();
+        multiplyAfterGroup();
+    }
+    if (s.hasResult || s.displayText.empty()) {
+        s.displayText = Rope("( ");
+        s.hasResult = false;
+        touch(0);
+    }
+    else {
+        touch(s.displayText.size());
+        s.displayText += "( ";
+    }
+    ++s.parenthesesCount;
+}
+
+void CalculatorEngine::closeParenthesis()
+{
+    CalculatorState& s = current;
+    if (s.parenthesesCount <= 0 || s.waitingForOperand) {
+        return;
+    }
+    pushUndo();
+    // 闭合后整组作为一个操作数，currentNumber 留空；之后直接输入数字见 multiplyAfterGroup
+    touch(s.displayText.size());
+    s.displayText += s.currentNumber;
+    s.displayText += " )";
+    s.currentNumber.clear();
+    --s.parenthesesCount;
+}
+
+void CalculatorEngine::multiplyAfterGroup()
+{
+    CalculatorState& s = current;
+    if (!s.currentNumber.empty() || s.waitingForOperand) {
+        return;
+    }
+    // 刚闭合的括号后面直接输入数字，按省略了乘号处理：(2)5 即 (2) * 5
+    touch(s.displayText.size());
+    s.displayText += " * ";
+    s.lastOperator = OpCode::Mul;
+    s.waitingForOperand = true;
+}
+
+void CalculatorEngine::toggleSign()
+{
+    CalculatorState& s = current;
+    const bool resultShown = s.waitingForOperand && s.hasResult;
+    if (!resultShown && (s.currentNumber.empty() || s.currentNumber == "0")) {
+        return;
+    }
+    pushUndo();
+    s.exactValue.reset();
+    if (!s.currentNumber.empty() && s.currentNumber.front() == '-') {
+        s.currentNumber.popFront();
+    }
+    else {
+        s.currentNumber.pushFront('-');
+    }
+}
+
+void CalculatorEngine::backspace()
+{
+    CalculatorState& s = current;
+    if (s.waitingForOperand) {
+        return;
+    }
+    pushUndo();
+    s.exactValue.reset();
+    if (s.currentNumber.empty() && s.displayText.endsWith(" )")) {
+        reopenGroup();
+        return;
+    }
+    if (s.currentNumber.size() > 1) {
+        s.currentNumber.pop_back();
+        if (s.currentNumber.empty() || s.currentNumber == "-") {
+            s.currentNumber = "0";
+            s.waitingForOperand = true;
+        }
+    }
+    else {
+        s.currentNumber = "0";
+        s.waitingForOperand = true;
+    }
+}
+
+void CalculatorEngine::reopenGroup()
+{
+    // 退格删掉刚输入的 " )"：重新打开这一组，组内最后一个数字回到输入框继续编辑
+    CalculatorState& s = current;
+    std::size_t end = s.displayText.size() - 2;
+    s.displayText = s.displayText.erase(end);
+    ++s.parenthesesCount;
+    if (!s.displayText.endsWith(" )")) {
+        // 数字不含空格，从末尾往前找到上一个空格即是数字的起点
+        const std::size_t window = std::min(end, kNumberBufferSize);
+        const std::string tail = s.displayText.substr(end - window);
+        const std::size_t space = tail.rfind(' ');
+        const std::size_t start = end - window + (space == std::string::npos ? 0 : space + 1);
+        s.currentNumber = std::string_view(tail).substr(start - (end - window));
+        s.displayText = s.displayText.erase(start);
+        end = start;
+    }
+    touch(end);
+}
+
+void CalculatorEngine::clearEntry()
+{
+    pushUndo();
+    current.exactValue.reset();
+    // 刚闭合的括号后清除输入，清出来的 0 是括号之后的新操作数：(2+3) CE 5 即 (2+3) * 5
+    multiplyAfterGroup();
+    current.currentNumber = "0";
+    current.waitingForOperand = true;
+}
+
+void CalculatorEngine::clearAll()
+{
+    pushUndo();
+    reset();
+}
+
+void CalculatorEngine::reset()
+{
+    CalculatorState& s = current;
+    s.exactValue.reset();
+    s.currentNumber = "0";
+    s.displayText.clear();
+    s.lastOperator = OpCode::PushConst;
+    s.lastResult = 0.0;
+    s.waitingForOperand = true;
+    s.hasResult = false;
+    s.parenthesesCount = 0;
+    s.repeatSuffix.clear();
+    recompileRepeat();
+    touch(0);
+}
+
+ErrorCode CalculatorEngine::equals(std::string* historyEntry)
+{
+    return calculate(historyEntry, true);
+}
+
+ErrorCode CalculatorEngine::calculate(std::string* historyEntry, bool recordUndo)
+{
+    CalculatorState& s = current;
+    std::string expression;
+    double result;
+    double zeroThreshold = kDisplayZeroThreshold;
+    ErrorCode error = ErrorCode::None;
+
+    const bool repeat = s.displayText.empty() && s.hasResult && s.waitingForOperand && repeatProgram.isValid();
+    if (!repeat && (s.displayText.empty() || s.waitingForOperand)) {
+        return ErrorCode::None;
+    }
+    if (recordUndo) {
+        pushUndo();
+    }
+
+    if (repeat) {
+        // 重复按 "="：以当前结果为 x 再执行一次最后的运算，直接复用已编译的字节码
+        const double operand = currentValue();
+        expression = formatNumber(operand);
+        expression += s.repeatSuffix;
+        if (s.adaptivePrecision) {
+            // 与第一次 "=" 走同一个求值器，对很小除数的处理才一致
+            EvalOptions options;
+            options.angleInDegrees = s.angleInDegrees;
+            options.x = operand;
+            result = evaluatePrecise(repeatExpression, options, sharedCache).value;
+            zeroThreshold = 0.0;
+        }
+        else {
+            result = repeatProgram.run(operand);
+        }
+        // 上一次同样的运算成功了，这次出错多半是结果越滚越大
+        error = std::isinf(result) ? ErrorCode::Overflow : ErrorCode::MathError;
+    }
+    else {
+        expression = s.displayText.toString();
+        expression += s.currentNumber;
+        // 自动补齐未闭合的括号
+        for (; s.parenthesesCount > 0; --s.parenthesesCount) {
+            expression += " )";
+        }
+        EvalOptions options;
+        options.angleInDegrees = s.angleInDegrees;
+        const Expression compiled = Expression::compile(expression);
+        if (!compiled.isValid()) {
+            reset();
+            return ErrorCode::InvalidExpression;
+        }
+        if (s.adaptivePrecision) {
+            result = evaluatePrecise(compiled, options, sharedCache).value;
+            zeroThreshold = 0.0;
+        }
+        else if (sharedCache) {
+            result = evaluateCached(compiled, options, *sharedCache);
+        }
+        else {
+            result = Program::compile(compiled, options).run();
+        }
+
+        // 记录最后一步运算，供重复按 "=" 使用
+        if (s.lastOperator != OpCode::PushConst && !s.currentNumber.empty()) {
+            const char head[] = { ' ', symbolOf(s.lastOperator), ' ' };
+            s.repeatSuffix = std::string_view(head, 3);
+            s.repeatSuffix += s.currentNumber;
+        }
+        else {
+            s.repeatSuffix.clear();
+        }
+        recompileRepeat();
+        if (std::isinf(result) || std::isnan(result)) {
+            error = diagnoseFailure(compiled, options);
+        }
+    }
+
+    if (std::isinf(result) || std::isnan(result)) {
+        reset();
+        return error;
+    }
+
+    finishCalculation(expression, result, historyEntry, zeroThreshold);
+    return ErrorCode::None;
+}
+
+void CalculatorEngine::finishCalculation(const std::string& expression, double result, std::string* historyEntry,
+                                         double zeroThreshold)
+{
+    CalculatorState& s = current;
+    char buffer[kNumberBufferSize];
+    s.currentNumber.assign(buffer, formatNumber(result, buffer, zeroThreshold));
+    s.exactValue.reset();
+    if (historyEntry) {
+        *historyEntry = expression + " = ";
+        *historyEntry += s.currentNumber;
+    }
+    s.displayText.clear();
+    touch(0);
+    s.lastOperator = OpCode::PushConst;
+    s.waitingForOperand = true;
+    s.hasResult = true;
+    s.lastResult = result;
+}
+
+ErrorCode CalculatorEngine::applyFunction(OpCode function, JobContext* job)
+{
+    CalculatorState& s = current;
+    if (s.currentNumber.empty()) {
+        return ErrorCode::None;
+    }
+
+    const double value = currentValue();
+    switch (function) {
+    case OpCode::Sqrt:
+        if (value < 0) {
+            return ErrorCode::NegativeSquareRoot;
+        }
+        break;
+    case OpCode::Ln:
+    case OpCode::Log10:
+        if (value <= 0) {
+            return ErrorCode::NonPositiveLog;
+        }
+        break;
+    case OpCode::Factorial: {
+        if (value != std::floor(value) || value < 0 || value > kMaxExactFactorial) {
+            return ErrorCode::FactorialRange;
+        }
+        if (value > 20) {
+            // double 只能精确到 20!，更大的改用大整数
+            std::optional<BigInt> exact = BigInt::factorial(static_cast<std::uint32_t>(value), job);
+            if (!exact) {
+                return ErrorCode::Cancelled;
+            }
+            pushUndo();
+            // 170! 以上 double 放不下，显示文本由大整数的前几位得到；拿它继续运算会报 Overflow
+            char buffer[kNumberBufferSize];
+            const double approximation = applyUnary(OpCode::Factorial, value, EvalOptions());
+            s.currentNumber.assign(buffer, std::isinf(approximation) ? formatApproximation(*exact, buffer)
+                                                                     : formatNumber(approximation, buffer));
+            s.exactValue = std::make_shared<const BigInt>(std::move(*exact));
+            s.waitingForOperand = true;
+            s.hasResult = true;
+            return ErrorCode::None;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    EvalOptions options;
+    options.angleInDegrees = s.angleInDegrees;
+    const double result = applyUnary(function, value, options);
+    if (std::isnan(result) && function == OpCode::Tan) {
+        return ErrorCode::TanUndefined;
+    }
+    if (std::isinf(result)) {
+        return ErrorCode::Overflow;
+    }
+    if (std::isnan(result)) {
+        return ErrorCode::MathError;
+    }
+
+    pushUndo();
+    char buffer[kNumberBufferSize];
+    s.currentNumber.assign(buffer, formatNumber(result, buffer));
+    s.exactValue.reset();
+    s.waitingForOperand = true;
+    s.hasResult = true;
+    return ErrorCode::None;
+}
+
+ErrorCode CalculatorEngine::pasteExpression(std::string_view text, std::string* historyEntry)
+{
+    text = trimmed(text);
+    if (text.empty()) {
+        return ErrorCode::None;
+    }
+
+    // 粘贴和随后的求值合成一步撤销
+    pushUndo();
+    CalculatorState& s = current;
+    s.exactValue.reset();
+    s.displayText = Rope(text);
+    touch(0);
+    s.currentNumber.clear();
+    s.lastOperator = OpCode::PushConst;
+    s.parenthesesCount = 0;
+    s.waitingForOperand = false;
+    s.hasResult = false;
+    return calculate(historyEntry, false);
+}
+
+void CalculatorEngine::memoryStore()
+{
+    // 超出 double 范围的大数阶乘结果存不进内存
+    if (!current.currentNumber.empty() && std::isfinite(currentValue())) {
+        current.memoryValue = currentValue();
+        current.hasMemoryValue = true;
+    }
+}
+
+ErrorCode CalculatorEngine::memoryRecall()
+{
+    CalculatorState& s = current;
+    if (!s.hasMemoryValue) {
+        return ErrorCode::EmptyMemory;
+    }
+    pushUndo();
+    s.exactValue.reset();
+    multiplyAfterGroup();
+    char buffer[kNumberBufferSize];
+    s.currentNumber.assign(buffer, formatNumber(s.memoryValue, buffer));
+    s.waitingForOperand = false;
+    // 表达式中途调出的内存值只是一个操作数，不能让下一个运算符丢掉前面的表达式
+    s.hasResult = s.displayText.empty();
+    return ErrorCode::None;
+}
+
+void CalculatorEngine::memoryAdd()
+{
+    CalculatorState& s = current;
+    if (!s.currentNumber.empty() && std::isfinite(currentValue())) {
+        if (!s.hasMemoryValue) {
+            s.memoryValue = 0.0;
+            s.hasMemoryValue = true;
+        }
+        s.memoryValue += currentValue();
+    }
+}
+
+void CalculatorEngine::memorySubtract()
+{
+    CalculatorState& s = current;
+    if (!s.currentNumber.empty() && std::isfinite(currentValue())) {
+        if (!s.hasMemoryValue) {
+            s.memoryValue = 0.0;
+            s.hasMemoryValue = true;
+        }
+        s.memoryValue -= currentValue();
+    }
+}
+
+void CalculatorEngine::memoryClear()
+{
+    current.memoryValue = 0.0;
+    current.hasMemoryValue = false;
+}
+
+void CalculatorEngine::toggleAngleUnit()
+{
+    current.angleInDegrees = !current.angleInDegrees;
+    // 已编译的重复运算依赖角度单位
+    recompileRepeat();
+}
+
+std::string CalculatorEngine::displayString() const
+{
+    const CalculatorState& s = current;
+    if (s.hasResult && s.waitingForOperand && s.displayText.empty()) {
+        // 显示最终结果
+        return "= " + s.currentNumber.str();
+    }
+    if (!s.displayText.empty() && !s.waitingForOperand) {
+        // 显示完整的表达式（包括当前输入）
+        return s.displayText.toString() + s.currentNumber.str();
+    }
+    if (!s.displayText.empty()) {
+        // 显示表达式（等待输入），末尾加光标
+        return s.displayText.toString() + "_";
+    }
+    return s.currentNumber.str();
+}
+
+Rope CalculatorEngine::pendingExpression() const
+{
+    const CalculatorState& s = current;
+    if (s.displayText.empty()) {
+        return Rope();
+    }
+    return s.waitingForOperand ? s.displayText : s.displayText.append(s.currentNumber);
+}
+
+std::size_t CalculatorEngine::takeUnchangedPrefix()
+{
+    // 改动之后 displayText 只会在末尾追加或截断，正在输入的数字总在它后面
+    const std::size_t prefix = std::min(editFloor, current.displayText.size());
+    editFloor = Rope::npos;
+    return prefix;
+}
+
+const BigInt* CalculatorEngine::exactResult() const
+{
+    const CalculatorState& s = current;
+    if (s.exactValue && s.hasResult && s.waitingForOperand && s.displayText.empty()) {
+        return s.exactValue.get();
+    }
+    return nullptr;
+}
+
+Program CalculatorEngine::compile(std::string_view expression) const
+{
+    EvalOptions options;
+    options.angleInDegrees = current.angleInDegrees;
+    return Program::compile(Expression::compile(expression), options);
+}
+
+double CalculatorEngine::evaluate(std::string_view expression) const
+{
+    return compile(expression).run();
+}
+
+double CalculatorEngine::currentValue() const
+{
+    const std::string_view text = current.currentNumber;
+    double value = 0.0;
+    const auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (result.ec == std::errc::result_out_of_range) {
+        // 与表达式里的字面量一致：上溢为 inf，下溢为 0
+        const bool negative = text.front() == '-';
+        const double magnitude = decimalOverflows(text.data() + negative, result.ptr)
+                                     ? std::numeric_limits<double>::infinity() : 0.0;
+        return negative ? -magnitude : magnitude;
+    }
+    return result.ec == std::errc() ? value : 0.0;
+}
+
+} // namespace calc
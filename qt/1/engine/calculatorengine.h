@@ -0,0 +1,228 @@
+#ifndef CALC_CALCULATORENGINE_H
+#define CALC_CALCULATORENGINE_H
+
+#include "bigint.h"
+#include "expression.h"
+#include "fixedstring.h"
+#include "numberformat.h"
+#include "precise.h"
+#include "program.h"
+#include "resultcache.h"
+#include "rope.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace calc {
+
+// 引擎返回给界面的错误码，界面负责转换成提示文字
+enum class ErrorCode : std::uint8_t {
+    None,
+    MathError,           // 计算结果为 NaN，且不属于下面更具体的情况
+    DivisionByZero,      // 除数或取模的模数为 0
+    Overflow,            // 结果超出 double 范围
+    InvalidExpression,   // 粘贴的公式无法解析
+    NegativeSquareRoot,  // 负数开平方
+    NonPositiveLog,      // ln/log 的参数不大于 0
+    FactorialRange,      // 阶乘参数不是 0 到 kMaxExactFactorial 之间的整数
+    TanUndefined,        // tan 在该角度无定义
+    EmptyMemory,         // 内存中没有存储值
+    Cancelled            // 后台求值被取消
+};
+
+constexpr std::size_t kErrorCodeCount = static_cast<std::size_t>(ErrorCode::Cancelled) + 1;
+
+// 错误码的简短英文描述，用于日志和命令行输出
+const char* describe(ErrorCode error);
+
+// 求值得到 inf/NaN 时找出原因：按后缀指令重放，返回第一个出错的运算对应的错误码
+ErrorCode diagnoseFailure(const Expression& expression, const EvalOptions& options);
+
+// 计算器按键。按钮、键盘和按键录制都先翻译成它，再交给 CalculatorEngine::press。
+// 数值会写进按键录制文件，新的键只能加在末尾
+enum class Key : std::uint8_t {
+    Digit0, Digit1, Digit2, Digit3, Digit4, Digit5, Digit6, Digit7, Digit8, Digit9,
+    Point,
+    Add,
+    Subtract,
+    Multiply,
+    Divide,
+    Modulo,
+    Power,
+    OpenParen,
+    CloseParen,
+    ToggleSign,
+    Backspace,
+    ClearEntry,
+    ClearAll,
+    Equals,
+    Undo,
+    Redo,
+    Square,
+    SquareRoot,
+    NaturalLog,
+    Log10,
+    Factorial,
+    MemoryStore,
+    MemoryRecall,
+    MemoryAdd,
+    MemorySubtract,
+    MemoryClear,
+    ToggleAngle
+};
+
+constexpr std::size_t kKeyCount = static_cast<std::size_t>(Key::ToggleAngle) + 1;
+
+// 单字符的按键记法，用于按键序列的文本形式：
+// 数字 . + - * / % ^ ( ) 照写，= 求值，~ 正负号，< 退格，e 清除输入，c 全部清除，z 撤销，y 重做，
+// s 平方，r 开方，l ln，g log，! 阶乘，M 存储，R 读取，P M+，N M-，X 清除内存，a 切换角度单位
+std::optional<Key> keyFromChar(char c);
+
+// 一元函数键对应的运算，其他键返回 PushConst
+OpCode functionOf(Key key);
+
+// n! 超过 20 时改用大整数精确计算，这是允许的最大 n
+constexpr std::uint32_t kMaxExactFactorial = 1000000;
+
+// 计算器的全部输入状态，纯值类型，可以拷贝、比较、在线程之间传递
+struct CalculatorState {
+    // 当前输入的数字或结果的显示文本，formatNumber 的输出总能放下
+    FixedString<kNumberBufferSize> currentNumber = "0";
+    Rope displayText;                 // 已输入的表达式前缀，可能很长，拷贝只复制根指针
+    OpCode lastOperator = OpCode::PushConst;  // 最后一个二元运算符，PushConst 表示没有
+    double lastResult = 0.0;          // 最后的计算结果
+    bool waitingForOperand = true;    // 是否等待新的操作数
+    bool hasResult = false;           // 是否已有结果
+    bool angleInDegrees = true;       // 角度单位：true为度，false为弧度
+    double memoryValue = 0.0;         // 内存存储值
+    bool hasMemoryValue = false;      // 是否有内存值
+    int parenthesesCount = 0;         // 未闭合的括号数
+    FixedString<kNumberBufferSize + 4> repeatSuffix;  // 重复按 "=" 时追加的运算，如 " + 3"
+    bool adaptivePrecision = true;    // "=" 求值时跟踪误差界，必要时用双双精度重算
+    std::shared_ptr<const BigInt> exactValue;  // 当前结果的精确值（大整数阶乘），此时 currentNumber 只是近似值
+};
+
+// 与界面无关的计算器核心：处理按键、维护状态、求值。
+// 所有按键处理都只修改 state，不做任何绘制，界面在调用之后读取 displayString() 刷新
+class CalculatorEngine
+{
+public:
+    CalculatorEngine() = default;
+    explicit CalculatorEngine(const CalculatorState& state);
+
+    const CalculatorState& state() const { return current; }
+    // 整体替换状态（如后台求值的结果），可以撤销
+    void setState(const CalculatorState& state);
+
+    // 撤销/重做最近的输入，内存值和角度单位不受影响；没有可撤销的内容时返回 false。
+    // 状态中的长表达式是共享的 Rope，每一步只保存一个指针
+    static constexpr std::size_t kUndoLimit = 200;
+    bool undo();
+    bool redo();
+    bool canUndo() const { return !undoStack.empty(); }
+    bool canRedo() const { return !redoStack.empty(); }
+
+    // "=" 求值前先查的结果缓存，可以在多个引擎副本之间共享；为空时不缓存
+    void setResultCache(ResultCache* cache) { sharedCache = cache; }
+    ResultCache* resultCache() const { return sharedCache; }
+
+    // 按一个键。状态只在固定大小的缓冲区和 Rope 的暂存区里变化，除 "=" 和大数阶乘之外
+    // 的按键通常不分配内存；historyEntry 只对 Key::Equals 有意义
+    ErrorCode press(Key key, std::string* historyEntry = nullptr);
+
+    // 按键输入
+    void inputDigit(char digit);
+    void inputDecimalPoint();
+    void inputOperator(OpCode op);
+    void openParenthesis();
+    void closeParenthesis();
+    void toggleSign();
+    void backspace();
+    void clearEntry();
+    void clearAll();
+
+    // 计算当前表达式；成功时若 historyEntry 非空则写入 "表达式 = 结果"，
+    // 没有可计算内容时返回 None 且不写入。adaptivePrecision 打开时结果的误差界已知，
+    // 不再把 1e-10 以下的值一律显示为 0
+    ErrorCode equals(std::string* historyEntry = nullptr);
+
+    // 对当前数字应用一元函数（x²、√x、ln、log、n!、sin/cos/tan）。
+    // n > 20 的阶乘按大整数精确计算，可能较慢，job 用于取消和报告进度
+    ErrorCode applyFunction(OpCode function, JobContext* job = nullptr);
+
+    // 粘贴整条公式并立即计算
+    ErrorCode pasteExpression(std::string_view text, std::string* historyEntry = nullptr);
+
+    // 内存功能
+    void memoryStore();
+    ErrorCode memoryRecall();
+    void memoryAdd();
+    void memorySubtract();
+    void memoryClear();
+
+    void toggleAngleUnit();
+
+    // 当前应显示在屏幕上的文本
+    std::string displayString() const;
+
+    // 尚未求值的表达式（已输入的前缀加正在输入的数字），供实时预览使用；
+    // 没有待计算的运算时为空
+    Rope pendingExpression() const;
+
+    // 自上次调用以来 pendingExpression() 开头没有被改动过的字节数，
+    // 交给 IncrementalEvaluator 后不必再逐字节比较整条公式
+    std::size_t takeUnchangedPrefix();
+
+    // 屏幕显示的最终结果有精确的大整数值时返回它，界面应改为流式显示其全部数字
+    const BigInt* exactResult() const;
+
+    // 求值任意表达式文本（使用当前角度单位），非法表达式返回 NaN
+    double evaluate(std::string_view expression) const;
+    Program compile(std::string_view expression) const;
+
+    double currentValue() const;
+
+private:
+    // 定长的状态栈，满了以后覆盖最旧的一项。槽位反复使用，攒满之后压栈不再分配内存
+    class StateStack
+    {
+    public:
+        void push(const CalculatorState& state);
+        bool pop(CalculatorState& state);
+        void clear() { count = 0; }
+        bool empty() const { return count == 0; }
+
+    private:
+        std::vector<CalculatorState> slots;
+        std::size_t first = 0;  // 最旧一项所在的槽位
+        std::size_t count = 0;
+    };
+
+    CalculatorState current;
+    Expression repeatExpression;  // 由 repeatSuffix 编译得到的 "x op 操作数"，adaptivePrecision 时用它求值
+    Program repeatProgram;        // 同一运算的字节码，关闭 adaptivePrecision 时使用
+    ResultCache* sharedCache = nullptr;
+    StateStack undoStack;
+    StateStack redoStack;
+    std::size_t editFloor = 0;  // 自上次 takeUnchangedPrefix() 以来 displayText 最靠前的改动位置
+
+    void pushUndo();
+    void touch(std::size_t position) { editFloor = std::min(editFloor, position); }
+    void restore(const CalculatorState& state);
+    ErrorCode calculate(std::string* historyEntry, bool recordUndo);
+    void recompileRepeat();
+    void multiplyAfterGroup();
+    void reopenGroup();
+    void reset();
+    void finishCalculation(const std::string& expression, double result, std::string* historyEntry,
+                           double zeroThreshold = kDisplayZeroThreshold);
+};
+
+} // namespace calc
+
+#endif // CALC_CALCULATORENGINE_H
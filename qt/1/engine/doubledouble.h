@@ -0,0 +1,103 @@
+#ifndef CALC_DOUBLEDOUBLE_H
+#define CALC_DOUBLEDOUBLE_H
+
+#include <cmath>
+
+namespace calc {
+
+// 双双精度数：值为 hi + lo，|lo| <= ulp(hi) / 2，约 106 位有效位。
+// 只提供自适应求值需要的四则运算和开方，算法见 Dekker / Knuth 的无误差变换
+struct DoubleDouble {
+    double hi = 0.0;
+    double lo = 0.0;
+
+    DoubleDouble() = default;
+    DoubleDouble(double value) : hi(value) {}
+    DoubleDouble(double high, double low) : hi(high), lo(low) {}
+
+    double toDouble() const { return hi + lo; }
+};
+
+// a + b = s + err，精确成立
+inline DoubleDouble twoSum(double a, double b)
+{
+    const double s = a + b;
+    const double bb = s - a;
+    return DoubleDouble(s, (a - (s - bb)) + (b - bb));
+}
+
+// 要求 |a| >= |b|
+inline DoubleDouble quickTwoSum(double a, double b)
+{
+    const double s = a + b;
+    return DoubleDouble(s, b - (s - a));
+}
+
+// a * b = p + err，精确成立（不溢出时）
+inline DoubleDouble twoProd(double a, double b)
+{
+    const double p = a * b;
+#ifdef __FMA__
+    return DoubleDouble(p, std::fma(a, b, -p));
+#else
+    // Dekker 拆分，不依赖硬件 FMA
+    constexpr double split = 134217729.0;  // 2^27 + 1
+    const double ca = split * a;
+    const double ah = ca - (ca - a);
+    const double al = a - ah;
+    const double cb = split * b;
+    const double bh = cb - (cb - b);
+    const double bl = b - bh;
+    return DoubleDouble(p, ((ah * bh - p) + ah * bl + al * bh) + al * bl);
+#endif
+}
+
+inline DoubleDouble operator-(const DoubleDouble& a)
+{
+    return DoubleDouble(-a.hi, -a.lo);
+}
+
+inline DoubleDouble operator+(const DoubleDouble& a, const DoubleDouble& b)
+{
+    const DoubleDouble s = twoSum(a.hi, b.hi);
+    const DoubleDouble t = twoSum(a.lo, b.lo);
+    DoubleDouble r = quickTwoSum(s.hi, s.lo + t.hi);
+    return quickTwoSum(r.hi, r.lo + t.lo);
+}
+
+inline DoubleDouble operator-(const DoubleDouble& a, const DoubleDouble& b)
+{
+    return a + (-b);
+}
+
+inline DoubleDouble operator*(const DoubleDouble& a, const DoubleDouble& b)
+{
+    const DoubleDouble p = twoProd(a.hi, b.hi);
+    return quickTwoSum(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+}
+
+inline DoubleDouble operator/(const DoubleDouble& a, const DoubleDouble& b)
+{
+    // 先用 double 估商，再用余数修正两次
+    const double q1 = a.hi / b.hi;
+    const DoubleDouble r1 = a - b * DoubleDouble(q1);
+    const double q2 = r1.hi / b.hi;
+    const DoubleDouble r2 = r1 - b * DoubleDouble(q2);
+    const double q3 = r2.hi / b.hi;
+    return quickTwoSum(q1, q2) + DoubleDouble(q3);
+}
+
+inline DoubleDouble sqrt(const DoubleDouble& a)
+{
+    if (a.hi <= 0.0) {
+        return DoubleDouble(std::sqrt(a.hi));
+    }
+    // 一步牛顿迭代：x + (a - x²) / 2x
+    const double x = std::sqrt(a.hi);
+    const DoubleDouble residual = a - twoProd(x, x);
+    return quickTwoSum(x, residual.hi / (2.0 * x));
+}
+
+} // namespace calc
+
+#endif // CALC_DOUBLEDOUBLE_H
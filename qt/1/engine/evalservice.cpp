@@ -0,0 +1,115 @@
+#include "evalservice.h"
+
+#include <algorithm>
+
+namespace calc {
+
+namespace {
+
+constexpr std::chrono::milliseconds kProgressInterval(16);
+
+} // namespace
+
+void JobContext::reportProgress(double fraction)
+{
+    if (!progress || isCancelled()) {
+        return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (fraction < 1.0 && now - lastReport < kProgressInterval) {
+        return;
+    }
+    lastReport = now;
+    progress(std::clamp(fraction, 0.0, 1.0));
+}
+
+EvalService::EvalService(unsigned threads)
+{
+    if (threads == 0) {
+        const unsigned hardware = std::thread::hardware_concurrency();
+        threads = hardware > 1 ? hardware - 1 : 1;
+    }
+    running.resize(threads);
+    workers.reserve(threads);
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.emplace_back(&EvalService::workerLoop, this, i);
+    }
+}
+
+EvalService::~EvalService()
+{
+    shutdown();
+}
+
+CancelToken EvalService::submit(Task task, ProgressCallback progress)
+{
+    Job job;
+    job.task = std::move(task);
+    job.context.progress = std::move(progress);
+    CancelToken token = job.context.token;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            token.cancel();
+            return token;
+        }
+        queue.push_back(std::move(job));
+    }
+    ready.notify_one();
+    return token;
+}
+
+void EvalService::cancelAll()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const Job& job : queue) {
+        job.context.token.cancel();
+    }
+    queue.clear();
+    for (const CancelToken& token : running) {
+        token.cancel();
+    }
+}
+
+void EvalService::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            return;
+        }
+        stopping = true;
+    }
+    cancelAll();
+    ready.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void EvalService::workerLoop(std::size_t worker)
+{
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping && queue.empty()) {
+                return;
+            }
+            job = std::move(queue.front());
+            queue.pop_front();
+            running[worker] = job.context.token;
+        }
+
+        if (!job.context.isCancelled()) {
+            job.task(job.context);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        running[worker] = CancelToken();
+    }
+}
+
+} // namespace calc
@@ -0,0 +1,91 @@
+#ifndef CALC_EVALSERVICE_H
+#define CALC_EVALSERVICE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace calc {
+
+// 取消标志，拷贝之间共享同一个状态，可以跨线程传递
+class CancelToken
+{
+public:
+    CancelToken() : flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() const { flag->store(true, std::memory_order_relaxed); }
+    bool isCancelled() const { return flag->load(std::memory_order_relaxed); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag;
+};
+
+// 任务运行时可见的上下文：长循环应定期检查 isCancelled() 并报告进度
+class JobContext
+{
+public:
+    bool isCancelled() const { return token.isCancelled(); }
+
+    // fraction 取 0~1；两次回调至少间隔一帧（16ms），避免进度事件淹没界面线程
+    void reportProgress(double fraction);
+
+private:
+    friend class EvalService;
+
+    CancelToken token;
+    std::function<void(double)> progress;
+    std::chrono::steady_clock::time_point lastReport;
+};
+
+// 后台求值线程池。任务在工作线程上运行，结果由任务自己投递回界面线程
+// （Qt 中通过 queued 信号），本类不依赖 Qt
+class EvalService
+{
+public:
+    using Task = std::function<void(JobContext&)>;
+    using ProgressCallback = std::function<void(double)>;
+
+    // threads 为 0 时使用硬件线程数减一（至少一个），给界面线程留出一个核心
+    explicit EvalService(unsigned threads = 0);
+    ~EvalService();
+
+    EvalService(const EvalService&) = delete;
+    EvalService& operator=(const EvalService&) = delete;
+
+    // 提交任务，返回的标志可用于取消；尚未开始的已取消任务直接丢弃
+    CancelToken submit(Task task, ProgressCallback progress = {});
+
+    // 取消所有排队中和运行中的任务
+    void cancelAll();
+
+    // 取消全部任务并等待工作线程退出，之后 submit 的任务不会再运行
+    void shutdown();
+
+    std::size_t threadCount() const { return workers.size(); }
+
+private:
+    struct Job {
+        Task task;
+        JobContext context;
+    };
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<Job> queue;
+    std::vector<CancelToken> running;  // 每个工作线程当前任务的标志
+    std::vector<std::thread> workers;
+    bool stopping = false;
+
+    void workerLoop(std::size_t worker);
+};
+
+} // namespace calc
+
+#endif // CALC_EVALSERVICE_H
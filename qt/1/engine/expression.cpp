@@ -0,0 +1,343 @@
+#include "expression.h"
+#include "doubledouble.h"
+#include "parser.h"
+#include "trig.h"
+
+#include <charconv>
+#include <cmath>
+#include <limits>
+
+namespace calc {
+
+namespace {
+
+double factorial(double n)
+{
+    if (n < 0 || n != std::floor(n)) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    if (n > 170) {
+        return std::numeric_limits<double>::infinity();
+    }
+    double result = 1.0;
+    for (int i = 2; i <= static_cast<int>(n); ++i) {
+        result *= i;
+    }
+    return result;
+}
+
+} // namespace
+
+double decimalResidual(const char* begin, const char* end, double value)
+{
+    if (!std::isfinite(value) || value == 0.0) {
+        return 0.0;
+    }
+
+    std::uint64_t high = 0;
+    std::uint64_t low = 0;
+    int highDigits = 0;
+    int lowDigits = 0;
+    int exponent = 0;
+    bool seenDot = false;
+    bool leading = true;
+    const char* p = begin;
+    for (; p != end; ++p) {
+        const char c = *p;
+        if (c == '.') {
+            seenDot = true;
+            continue;
+        }
+        if (c < '0' || c > '9') {
+            break;
+        }
+        if (leading && c == '0') {
+            exponent -= seenDot;
+            continue;
+        }
+        leading = false;
+        if (highDigits < 15) {
+            high = high * 10 + static_cast<std::uint64_t>(c - '0');
+            ++highDigits;
+            exponent -= seenDot;
+        }
+        else if (lowDigits < 15) {
+            low = low * 10 + static_cast<std::uint64_t>(c - '0');
+            ++lowDigits;
+            exponent -= seenDot;
+        }
+        else if (!seenDot) {
+            ++exponent;  // 多余的整数位只影响数量级
+        }
+    }
+    if (p != end && (*p == 'e' || *p == 'E')) {
+        int power = 0;
+        const char* digits = p + 1;
+        if (digits != end && *digits == '+') {
+            ++digits;
+        }
+        std::from_chars(digits, end, power);
+        exponent += power;
+    }
+
+    // 整数且不超过 2^53 时 double 已经精确
+    if (lowDigits == 0 && exponent == 0) {
+        return 0.0;
+    }
+
+    constexpr double kPow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    DoubleDouble exact = DoubleDouble(static_cast<double>(high)) * DoubleDouble(kPow10[lowDigits])
+                       + DoubleDouble(static_cast<double>(low));
+    // 10^22 以内的 10 的幂都能被 double 精确表示，更大的分段乘除
+    while (exponent > 0) {
+        const int step = exponent < 22 ? exponent : 22;
+        exact = exact * DoubleDouble(kPow10[step]);
+        exponent -= step;
+    }
+    while (exponent < 0) {
+        const int step = -exponent < 22 ? -exponent : 22;
+        exact = exact / DoubleDouble(kPow10[step]);
+        exponent += step;
+    }
+    if (!std::isfinite(exact.hi)) {
+        return 0.0;
+    }
+    return (exact.hi - value) + exact.lo;
+}
+
+bool decimalOverflows(const char* begin, const char* end)
+{
+    // 首位有效数字是 10^(magnitude - 1) 位，全是 0 的字面量不会越界
+    long magnitude = 0;
+    bool seenDot = false;
+    bool leading = true;
+    const char* p = begin;
+    for (; p != end && *p != 'e' && *p != 'E'; ++p) {
+        if (*p == '.') {
+            seenDot = true;
+        }
+        else if (leading && *p == '0') {
+            magnitude -= seenDot;
+        }
+        else {
+            leading = false;
+            magnitude += !seenDot;
+        }
+    }
+    if (leading) {
+        return false;
+    }
+    long power = 0;
+    bool negative = false;
+    if (p != end) {
+        ++p;
+        if (p != end && (*p == '+' || *p == '-')) {
+            negative = *p == '-';
+            ++p;
+        }
+        // 指数可能超出 int，饱和累加，只关心符号和大致量级
+        for (; p != end && power < 1000000; ++p) {
+            power = power * 10 + (*p - '0');
+        }
+    }
+    return magnitude + (negative ? -power : power) > 0;
+}
+
+
+const char* describe(ParseError error)
+{
+    switch (error) {
+    case ParseError::None:
+        return "ok";
+    case ParseError::EmptyExpression:
+        return "empty expression";
+    case ParseError::UnexpectedToken:
+        return "unexpected token";
+    case ParseError::UnbalancedParentheses:
+        return "unbalanced parentheses";
+    case ParseError::UnknownIdentifier:
+        return "unknown identifier";
+    }
+    return "unknown error";
+}
+
+bool isBinary(OpCode op)
+{
+    switch (op) {
+    case OpCode::Add:
+    case OpCode::Sub:
+    case OpCode::Mul:
+    case OpCode::Div:
+    case OpCode::Mod:
+    case OpCode::Pow:
+        return true;
+    default:
+        return false;
+    }
+}
+
+double applyUnary(OpCode op, double a, const EvalOptions& options)
+{
+    constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+
+    switch (op) {
+    case OpCode::Neg:
+        return -a;
+    case OpCode::Factorial:
+        return factorial(a);
+    case OpCode::Square:
+        return a * a;
+    case OpCode::Sin:
+    case OpCode::Cos:
+    case OpCode::Tan:
+        // 角度制的特殊角是精确的，tan 在无定义处返回 NaN
+        return trigFunction(op, options.angleInDegrees)(a);
+    case OpCode::Ln:
+        return a > 0 ? std::log(a) : nan;
+    case OpCode::Log10:
+        return a > 0 ? std::log10(a) : nan;
+    case OpCode::Sqrt:
+        return a >= 0 ? std::sqrt(a) : nan;
+    default:
+        return nan;
+    }
+}
+
+double applyBinary(OpCode op, double a, double b)
+{
+    switch (op) {
+    case OpCode::Add:
+        return a + b;
+    case OpCode::Sub:
+        return a - b;
+    case OpCode::Mul:
+        return a * b;
+    case OpCode::Div:
+        if (isZeroDivisor(b)) {
+            return std::numeric_limits<double>::infinity();
+        }
+        return a / b;
+    case OpCode::Mod:
+        if (isZeroDivisor(b)) {
+            return std::numeric_limits<double>::infinity();
+        }
+        return std::fmod(a, b);
+    case OpCode::Pow:
+        return std::pow(a, b);
+    default:
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+}
+
+Expression Expression::compile(std::string_view text)
+{
+    // 调度场算法：单遍扫描，运算符栈和输出都是线性的，
+    // 不做递归，因此很长或嵌套很深的公式也不会爆栈
+    Expression expr;
+    expr.instructions.reserve(text.size() / 2 + 1);
+
+    ParserState state;
+    int depth = 0;
+
+    auto emit = [&](OpCode op, double value, double residual) {
+        if (residual != 0.0) {
+            expr.residuals.resize(expr.instructions.size() + 1, 0.0);
+            expr.residuals.back() = residual;
+        }
+        expr.instructions.push_back({ op, value });
+        if (op == OpCode::PushConst || op == OpCode::PushVar) {
+            ++depth;
+            if (depth > expr.stackDepth) {
+                expr.stackDepth = depth;
+            }
+        }
+        else if (isBinary(op)) {
+            --depth;
+        }
+    };
+
+    auto fail = [&](ParseError error, std::size_t pos) {
+        expr.instructions.clear();
+        expr.residuals.clear();
+        expr.stackDepth = 0;
+        expr.error = error;
+        expr.errorPos = pos;
+        return expr;
+    };
+
+    Lexer lexer(text);
+    for (Token tok = lexer.next(); tok.kind != TokenKind::End; tok = lexer.next()) {
+        const ParseError error = parseToken(state, tok, text, emit);
+        if (error != ParseError::None) {
+            return fail(error, tok.pos);
+        }
+    }
+
+    std::vector<StackEntry>& stack = state.stack;
+    if (expr.instructions.empty() && stack.empty()) {
+        return fail(ParseError::EmptyExpression, text.size());
+    }
+    if (state.expectOperand || state.needParen) {
+        return fail(ParseError::UnexpectedToken, text.size());
+    }
+
+    while (!stack.empty()) {
+        if (stack.back().kind != StackKind::Operator) {
+            return fail(ParseError::UnbalancedParentheses, stack.back().pos);
+        }
+        emit(stack.back().op, 0.0, 0.0);
+        stack.pop_back();
+    }
+
+    expr.instructions.shrink_to_fit();
+    expr.error = ParseError::None;
+    return expr;
+}
+
+bool Expression::usesVariable() const
+{
+    for (const Instruction& ins : instructions) {
+        if (ins.op == OpCode::PushVar) {
+            return true;
+        }
+    }
+    return false;
+}
+
+double Expression::evaluate(const EvalOptions& options) const
+{
+    if (!isValid()) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+
+    // 编译期已知最大栈深，常见表达式直接使用栈上数组
+    constexpr int kInlineDepth = 64;
+    double inlineStack[kInlineDepth] = {};
+    std::vector<double> heapStack;
+    double* stack = inlineStack;
+    if (stackDepth > kInlineDepth) {
+        heapStack.resize(static_cast<std::size_t>(stackDepth));
+        stack = heapStack.data();
+    }
+
+    int top = -1;
+    for (const Instruction& ins : instructions) {
+        if (ins.op == OpCode::PushConst) {
+            stack[++top] = ins.value;
+        }
+        else if (ins.op == OpCode::PushVar) {
+            stack[++top] = options.x;
+        }
+        else if (isBinary(ins.op)) {
+            const double rhs = stack[top--];
+            stack[top] = applyBinary(ins.op, stack[top], rhs);
+        }
+        else {
+            stack[top] = applyUnary(ins.op, stack[top], options);
+        }
+    }
+    return stack[0];
+}
+
+} // namespace calc
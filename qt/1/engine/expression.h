@@ -0,0 +1,107 @@
+#ifndef CALC_EXPRESSION_H
+#define CALC_EXPRESSION_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace calc {
+
+// 后缀指令操作码
+enum class OpCode : std::uint8_t {
+    PushConst,  // 压入常量
+    PushVar,    // 压入变量 x
+    Neg,        // 一元负号
+    Add,
+    Sub,
+    Mul,
+    Div,
+    Mod,
+    Pow,
+    Factorial,  // 后缀 n!
+    Square,     // 后缀 x²
+    Sin,
+    Cos,
+    Tan,
+    Ln,
+    Log10,
+    Sqrt
+};
+
+// 紧凑的后缀指令，value 只对 PushConst 有意义
+struct Instruction {
+    OpCode op;
+    double value;
+};
+
+// 编译错误类型
+enum class ParseError : std::uint8_t {
+    None,
+    EmptyExpression,        // 空表达式
+    UnexpectedToken,        // 出现在错误位置的记号
+    UnbalancedParentheses,  // 括号不匹配
+    UnknownIdentifier       // 未知的函数或常量名
+};
+
+// 编译错误的简短英文描述，用于日志和命令行输出
+const char* describe(ParseError error);
+
+// 求值选项
+struct EvalOptions {
+    bool angleInDegrees = true;  // 三角函数参数是否为角度
+    double x = 0.0;              // 变量 x 的取值
+};
+
+// 编译后的表达式：一次词法/语法分析生成后缀指令，之后可反复求值
+class Expression
+{
+public:
+    // 解析 UTF-8 表达式，支持 + - * / % ^、括号、一元负号、
+    // 后缀 ! 和 ²、sin/cos/tan/ln/log/sqrt、常量 pi、e 以及变量 x
+    static Expression compile(std::string_view text);
+
+    bool isValid() const { return error == ParseError::None; }
+    ParseError parseError() const { return error; }
+    std::size_t errorPosition() const { return errorPos; }
+
+    // 非法表达式或数学错误返回 NaN，除零返回 inf
+    double evaluate(const EvalOptions& options = EvalOptions()) const;
+
+    const std::vector<Instruction>& code() const { return instructions; }
+
+    // 第 index 条 PushConst 的十进制字面量与其 double 值之差（精确值 - value），
+    // 供高精度重算使用；能被 double 精确表示的常量为 0
+    double literalResidual(std::size_t index) const
+    {
+        return index < residuals.size() ? residuals[index] : 0.0;
+    }
+
+    int maxStackDepth() const { return stackDepth; }
+    bool usesVariable() const;
+
+private:
+    std::vector<Instruction> instructions;
+    std::vector<double> residuals;  // 按需增长，只有出现非零余量时才分配
+    int stackDepth = 0;
+    ParseError error = ParseError::EmptyExpression;
+    std::size_t errorPos = 0;
+};
+
+// 单步运算，供解释器和后续的求值路径共用
+bool isBinary(OpCode op);
+// 绝对值低于此值的除数当作 0（与界面原有的除零判断保持一致）。
+// 标量解释器、SIMD 列求值和弧度制 tan 的无定义判断都用它，不要在别处另写一个
+constexpr double kZeroDivisorThreshold = 1e-10;
+// 除数是否小到被当作 0，applyBinary 此时对 / 和 % 返回 inf。放在头文件里，列求值的内层循环可以内联
+inline bool isZeroDivisor(double divisor)
+{
+    return std::fabs(divisor) < kZeroDivisorThreshold;
+}
+double applyUnary(OpCode op, double a, const EvalOptions& options);
+double applyBinary(OpCode op, double a, double b);
+
+} // namespace calc
+
+#endif // CALC_EXPRESSION_H
@@ -0,0 +1,89 @@
+#ifndef CALC_FIXEDSTRING_H
+#define CALC_FIXEDSTRING_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace calc {
+
+// 容量固定、存放在对象内部的短字符串，拷贝和修改都不分配内存。
+// 用于正在输入的数字这类长度有明确上限的文本，超出容量的部分被截掉
+template <std::size_t N>
+class FixedString
+{
+public:
+    static constexpr std::size_t kCapacity = N;
+
+    FixedString() = default;
+    FixedString(std::string_view text) { assign(text.data(), text.size()); }
+    FixedString(const char* text) : FixedString(std::string_view(text)) {}
+
+    FixedString& operator=(std::string_view text) { return assign(text.data(), text.size()); }
+    FixedString& operator=(const char* text) { return *this = std::string_view(text); }
+
+    FixedString& assign(const char* text, std::size_t count)
+    {
+        length = std::min(count, N);
+        std::memmove(chars, text, length);
+        return *this;
+    }
+
+    std::size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    const char* data() const { return chars; }
+    char front() const { return chars[0]; }
+    char back() const { return chars[length - 1]; }
+    std::string_view view() const { return std::string_view(chars, length); }
+    operator std::string_view() const { return view(); }
+    std::string str() const { return std::string(chars, length); }
+
+    std::size_t find(char c) const { return view().find(c); }
+
+    void clear() { length = 0; }
+    void pop_back() { --length; }
+
+    FixedString& operator+=(char c)
+    {
+        if (length < N) {
+            chars[length++] = c;
+        }
+        return *this;
+    }
+
+    FixedString& operator+=(std::string_view text)
+    {
+        const std::size_t count = std::min(text.size(), N - length);
+        std::memcpy(chars + length, text.data(), count);
+        length += count;
+        return *this;
+    }
+
+    // 在开头插入或删除一个字符，用于切换正负号
+    void pushFront(char c)
+    {
+        length = std::min(length + 1, N);
+        std::memmove(chars + 1, chars, length - 1);
+        chars[0] = c;
+    }
+
+    void popFront()
+    {
+        std::memmove(chars, chars + 1, --length);
+    }
+
+    friend bool operator==(const FixedString& a, std::string_view b) { return a.view() == b; }
+    friend bool operator!=(const FixedString& a, std::string_view b) { return a.view() != b; }
+    friend bool operator==(const FixedString& a, const char* b) { return a.view() == b; }
+    friend bool operator!=(const FixedString& a, const char* b) { return a.view() != b; }
+
+private:
+    char chars[N] = {};
+    std::size_t length = 0;
+};
+
+} // namespace calc
+
+#endif // CALC_FIXEDSTRING_H
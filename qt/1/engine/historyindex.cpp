@@ -0,0 +1,129 @@
+#include "historyindex.h"
+#include "historylog.h"
+
+namespace calc {
+
+namespace {
+
+constexpr std::size_t kGram = 3;
+
+inline std::uint32_t gramAt(const char* p)
+{
+    return (static_cast<std::uint32_t>(static_cast<unsigned char>(p[0])) << 16)
+         | (static_cast<std::uint32_t>(static_cast<unsigned char>(p[1])) << 8)
+         | static_cast<std::uint32_t>(static_cast<unsigned char>(p[2]));
+}
+
+inline void putVarint(std::vector<std::uint8_t>& out, std::uint32_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+inline bool matches(std::string_view text, std::string_view query, MatchMode mode)
+{
+    if (mode == MatchMode::Prefix) {
+        return text.substr(0, query.size()) == query;
+    }
+    return text.find(query) != std::string_view::npos;
+}
+
+} // namespace
+
+void HistoryIndex::add(std::uint32_t id, std::string_view text)
+{
+    if (text.size() < kGram) {
+        return;
+    }
+    const char* p = text.data();
+    const char* end = p + text.size() - kGram + 1;
+    for (; p != end; ++p) {
+        Postings& list = postings[gramAt(p)];
+        // 同一条记录里重复出现的片段只记一次
+        if (list.count > 0 && list.last == id) {
+            continue;
+        }
+        putVarint(list.deltas, list.count > 0 ? id - list.last : id);
+        list.last = id;
+        ++list.count;
+    }
+}
+
+void HistoryIndex::update(const HistoryLog& log)
+{
+    update(log, log.size());
+}
+
+bool HistoryIndex::update(const HistoryLog& log, std::size_t limit)
+{
+    const std::size_t total = log.size();
+    const std::size_t stop = total - indexed > limit ? indexed + limit : total;
+    for (; indexed < stop; ++indexed) {
+        add(static_cast<std::uint32_t>(indexed), log.text(indexed));
+    }
+    return indexed == total;
+}
+
+void HistoryIndex::clear()
+{
+    postings.clear();
+    indexed = 0;
+}
+
+std::vector<std::uint32_t> HistoryIndex::search(const HistoryLog& log, std::string_view query,
+                                                MatchMode mode, std::size_t limit) const
+{
+    std::vector<std::uint32_t> result;
+
+    // 查询太短，没有可用的片段，从新到旧直接扫描
+    if (query.size() < kGram) {
+        for (std::size_t i = indexed; i > 0 && result.size() < limit; --i) {
+            if (matches(log.text(i - 1), query, mode)) {
+                result.push_back(static_cast<std::uint32_t>(i - 1));
+            }
+        }
+        return result;
+    }
+
+    // 找出倒排表最短的片段；任何一个片段不存在就不可能匹配
+    const Postings* rarest = nullptr;
+    for (std::size_t i = 0; i + kGram <= query.size(); ++i) {
+        const auto it = postings.find(gramAt(query.data() + i));
+        if (it == postings.end()) {
+            return result;
+        }
+        if (!rarest || it->second.count < rarest->count) {
+            rarest = &it->second;
+        }
+    }
+
+    std::vector<std::uint32_t> candidates;
+    candidates.reserve(rarest->count);
+    std::uint32_t id = 0;
+    for (std::size_t pos = 0; pos < rarest->deltas.size();) {
+        std::uint32_t delta = 0;
+        int shift = 0;
+        std::uint8_t byte;
+        do {
+            byte = rarest->deltas[pos++];
+            delta |= static_cast<std::uint32_t>(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        id += delta;
+        candidates.push_back(id);
+    }
+
+    // 恰好三字节的包含查询，候选即结果，不必再读文本
+    const bool exact = mode == MatchMode::Contains && query.size() == kGram;
+    for (auto it = candidates.rbegin(); it != candidates.rend() && result.size() < limit; ++it) {
+        if (exact || matches(log.text(*it), query, mode)) {
+            result.push_back(*it);
+        }
+    }
+    return result;
+}
+
+} // namespace calc
@@ -0,0 +1,56 @@
+#ifndef CALC_HISTORYINDEX_H
+#define CALC_HISTORYINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace calc {
+
+class HistoryLog;
+
+enum class MatchMode : std::uint8_t {
+    Contains,  // 文本中任意位置包含查询串
+    Prefix     // 文本以查询串开头
+};
+
+// 计算历史的三元组（trigram）倒排索引。
+//
+// 每个三字节片段对应一条按记录号递增的倒排表，用差分 varint 压缩存放。
+// 查询时取查询串中最稀有的片段，只对它的倒排表中的记录做最终校验，
+// 因此耗时与候选数成正比，与历史总条数无关。不足三字节的查询退化为从新到旧扫描
+class HistoryIndex
+{
+public:
+    // 已建立索引的记录数
+    std::size_t size() const { return indexed; }
+
+    // 把 log 中尚未建立索引的记录补进索引，已跟上时为 O(1)
+    void update(const HistoryLog& log);
+    // 最多补进 limit 条，返回之后是否已经跟上。大量历史可以分批建立，不长时间占住调用线程
+    bool update(const HistoryLog& log, std::size_t limit);
+    void clear();
+
+    // 返回匹配的记录号，从新到旧排列，最多 limit 条
+    std::vector<std::uint32_t> search(const HistoryLog& log, std::string_view query,
+                                      MatchMode mode = MatchMode::Contains,
+                                      std::size_t limit = 1000) const;
+
+private:
+    struct Postings {
+        std::vector<std::uint8_t> deltas;  // 与上一个记录号之差，varint 编码
+        std::uint32_t count = 0;
+        std::uint32_t last = 0;
+    };
+
+    std::unordered_map<std::uint32_t, Postings> postings;
+    std::size_t indexed = 0;
+
+    void add(std::uint32_t id, std::string_view text);
+};
+
+} // namespace calc
+
+#endif // CALC_HISTORYINDEX_H
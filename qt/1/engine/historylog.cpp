@@ -0,0 +1,359 @@
+#include "historylog.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace calc {
+
+namespace {
+
+constexpr char kMagic[8] = { 'C', 'A', 'L', 'C', 'H', 'I', 'S', 'T' };
+constexpr std::uint32_t kVersion = 1;
+constexpr std::size_t kInitialRecords = 4096;
+constexpr std::uint64_t kInitialArena = 1 << 20;
+
+// 索引文件头，固定 64 字节，之后紧跟 HistoryRecord 数组
+struct IndexHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t recordSize;
+    std::uint64_t count;  // 已提交的记录数，追加时最后写入
+    std::uint64_t reserved[5];
+};
+
+static_assert(sizeof(IndexHeader) == 64, "IndexHeader must stay 64 bytes");
+static_assert(sizeof(HistoryRecord) == 32, "HistoryRecord must stay 32 bytes");
+
+} // namespace
+
+// 可读写的共享内存映射文件，resize 之后映射地址会改变
+struct HistoryLog::MappedFile {
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+    char* data = nullptr;
+    std::uint64_t size = 0;
+
+    bool open(const std::string& path)
+    {
+#ifdef _WIN32
+        const int wideLength = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+        std::wstring widePath(static_cast<std::size_t>(wideLength), L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &widePath[0], wideLength);
+        // 不允许其他进程同时写入，避免两个计算器实例交错追加
+        file = CreateFileW(widePath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                           OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize)) {
+            return false;
+        }
+        size = static_cast<std::uint64_t>(fileSize.QuadPart);
+#else
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        // 不允许其他进程同时写入，避免两个计算器实例交错追加
+        if (::flock(fd, LOCK_EX | LOCK_NB) != 0) {
+            return false;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            return false;
+        }
+        size = static_cast<std::uint64_t>(st.st_size);
+#endif
+        return size == 0 || map();
+    }
+
+    bool map()
+    {
+#ifdef _WIN32
+        mapping = CreateFileMappingW(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32),
+                                     static_cast<DWORD>(size), nullptr);
+        if (!mapping) {
+            return false;
+        }
+        data = static_cast<char*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+        return data != nullptr;
+#else
+        void* address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED) {
+            return false;
+        }
+        data = static_cast<char*>(address);
+        return true;
+#endif
+    }
+
+    void unmap()
+    {
+        if (!data) {
+            return;
+        }
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+        CloseHandle(mapping);
+        mapping = nullptr;
+#else
+        ::munmap(data, size);
+#endif
+        data = nullptr;
+    }
+
+    bool resize(std::uint64_t newSize)
+    {
+        unmap();
+#ifdef _WIN32
+        LARGE_INTEGER position;
+        position.QuadPart = static_cast<LONGLONG>(newSize);
+        if (!SetFilePointerEx(file, position, nullptr, FILE_BEGIN) || !SetEndOfFile(file)) {
+            return false;
+        }
+#else
+        if (::ftruncate(fd, static_cast<off_t>(newSize)) != 0) {
+            return false;
+        }
+#endif
+        size = newSize;
+        return map();
+    }
+
+    void flush()
+    {
+        if (!data) {
+            return;
+        }
+#ifdef _WIN32
+        FlushViewOfFile(data, 0);
+        FlushFileBuffers(file);
+#else
+        ::msync(data, size, MS_SYNC);
+#endif
+    }
+
+    void close()
+    {
+        unmap();
+#ifdef _WIN32
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+            file = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+#endif
+        size = 0;
+    }
+};
+
+namespace {
+
+IndexHeader* headerOf(char* data)
+{
+    return reinterpret_cast<IndexHeader*>(data);
+}
+
+HistoryRecord* recordsOf(char* data)
+{
+    return reinterpret_cast<HistoryRecord*>(data + sizeof(IndexHeader));
+}
+
+std::size_t capacityOf(std::uint64_t indexSize)
+{
+    return static_cast<std::size_t>((indexSize - sizeof(IndexHeader)) / sizeof(HistoryRecord));
+}
+
+} // namespace
+
+HistoryLog::HistoryLog()
+    : index(new MappedFile)
+    , arena(new MappedFile)
+    , arenaUsed(0)
+{
+}
+
+HistoryLog::~HistoryLog()
+{
+    close();
+    delete index;
+    delete arena;
+}
+
+bool HistoryLog::fail(const std::string& message)
+{
+    error = message;
+    close();
+    return false;
+}
+
+bool HistoryLog::open(const std::string& basePath)
+{
+    close();
+    error.clear();
+
+    if (!index->open(basePath + ".idx")) {
+        return fail("cannot open " + basePath + ".idx");
+    }
+    if (!arena->open(basePath + ".dat")) {
+        return fail("cannot open " + basePath + ".dat");
+    }
+
+    if (index->size == 0) {
+        // 新文件：写入文件头
+        if (!index->resize(sizeof(IndexHeader) + kInitialRecords * sizeof(HistoryRecord))) {
+            return fail("cannot grow " + basePath + ".idx");
+        }
+        IndexHeader* header = headerOf(index->data);
+        std::memset(header, 0, sizeof(IndexHeader));
+        std::memcpy(header->magic, kMagic, sizeof(kMagic));
+        header->version = kVersion;
+        header->recordSize = sizeof(HistoryRecord);
+    }
+
+    if (index->size < sizeof(IndexHeader)) {
+        return fail(basePath + ".idx is not a calculator history file");
+    }
+    IndexHeader* header = headerOf(index->data);
+    if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 || header->version != kVersion
+        || header->recordSize != sizeof(HistoryRecord)) {
+        return fail(basePath + ".idx is not a calculator history file");
+    }
+    // 截断到放不下一条记录的索引（如被外部截断）按空历史重新分配，resize 之后映射地址会改变
+    if (capacityOf(index->size) == 0) {
+        if (!index->resize(sizeof(IndexHeader) + kInitialRecords * sizeof(HistoryRecord))) {
+            return fail("cannot grow " + basePath + ".idx");
+        }
+        header = headerOf(index->data);
+        header->count = 0;
+    }
+
+    if (arena->size == 0 && !arena->resize(kInitialArena)) {
+        return fail("cannot grow " + basePath + ".dat");
+    }
+
+    // 字符串区被截断或换成了别的文件时，文件头会指向不存在的文本，丢弃越界的尾部记录
+    std::uint64_t count = std::min<std::uint64_t>(header->count, capacityOf(index->size));
+    const HistoryRecord* records = recordsOf(index->data);
+    while (count > 0 && records[count - 1].offset + records[count - 1].length > arena->size) {
+        --count;
+    }
+    header->count = count;
+    arenaUsed = count > 0 ? records[count - 1].offset + records[count - 1].length : 0;
+    return true;
+}
+
+void HistoryLog::close()
+{
+    if (index->data) {
+        flush();
+    }
+    index->close();
+    arena->close();
+    arenaUsed = 0;
+}
+
+bool HistoryLog::isOpen() const
+{
+    return index->data != nullptr && arena->data != nullptr;
+}
+
+bool HistoryLog::reserve(std::size_t records, std::uint64_t bytes)
+{
+    const std::size_t capacity = capacityOf(index->size);
+    if (records > capacity) {
+        std::size_t newCapacity = std::max(capacity, kInitialRecords) * 2;
+        while (newCapacity < records) {
+            newCapacity *= 2;
+        }
+        if (!index->resize(sizeof(IndexHeader) + newCapacity * sizeof(HistoryRecord))) {
+            error = "cannot grow history index";
+            return false;
+        }
+    }
+    if (bytes > arena->size) {
+        std::uint64_t newSize = std::max(arena->size, kInitialArena) * 2;
+        while (newSize < bytes) {
+            newSize *= 2;
+        }
+        if (!arena->resize(newSize)) {
+            error = "cannot grow history text";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HistoryLog::append(std::string_view text, double result, std::int64_t timestamp)
+{
+    if (!isOpen()) {
+        return false;
+    }
+
+    const std::size_t count = size();
+    if (!reserve(count + 1, arenaUsed + text.size())) {
+        return false;
+    }
+
+    std::memcpy(arena->data + arenaUsed, text.data(), text.size());
+
+    HistoryRecord& record = recordsOf(index->data)[count];
+    record.offset = arenaUsed;
+    record.length = static_cast<std::uint32_t>(text.size());
+    record.flags = 0;
+    record.result = result;
+    record.timestamp = timestamp;
+
+    // 文本和记录写完之后才提交记录数。栅栏只约束本进程的写入顺序，不约束写回磁盘的顺序
+    std::atomic_thread_fence(std::memory_order_release);
+    headerOf(index->data)->count = count + 1;
+    arenaUsed += text.size();
+    return true;
+}
+
+std::size_t HistoryLog::size() const
+{
+    return index->data ? static_cast<std::size_t>(headerOf(index->data)->count) : 0;
+}
+
+const HistoryRecord& HistoryLog::record(std::size_t i) const
+{
+    return recordsOf(index->data)[i];
+}
+
+std::string_view HistoryLog::text(std::size_t i) const
+{
+    const HistoryRecord& r = record(i);
+    return std::string_view(arena->data + r.offset, r.length);
+}
+
+void HistoryLog::flush()
+{
+    index->flush();
+    arena->flush();
+}
+
+} // namespace calc
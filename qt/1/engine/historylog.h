@@ -0,0 +1,70 @@
+#ifndef CALC_HISTORYLOG_H
+#define CALC_HISTORYLOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace calc {
+
+// 索引文件中的定长记录，文本本身存放在字符串区文件中
+struct HistoryRecord {
+    std::uint64_t offset;     // 文本在字符串区中的偏移
+    std::uint32_t length;     // 文本字节数（UTF-8）
+    std::uint32_t flags;      // 预留
+    double result;            // 计算结果
+    std::int64_t timestamp;   // 毫秒级 Unix 时间戳
+};
+
+// 内存映射实现的持久化计算历史，只追加、不限条数。
+//
+// 由两个文件组成：<base>.idx 为文件头加定长 HistoryRecord 数组，
+// <base>.dat 为连续存放的文本。追加时先写文本和记录，最后才递增文件头中的
+// 记录数，因此进程在任意时刻崩溃都只会丢失最后一条未提交的记录。
+// 这只针对进程崩溃：脏页写回磁盘的先后由内核决定，掉电时文件头可能先于文本落盘，
+// 恢复出的尾部记录文本可能是预分配的零字节，不做保证。
+// 打开时只读取文件头并校验最后一条记录，与历史条数无关。
+class HistoryLog
+{
+public:
+    HistoryLog();
+    ~HistoryLog();
+
+    HistoryLog(const HistoryLog&) = delete;
+    HistoryLog& operator=(const HistoryLog&) = delete;
+
+    // basePath 不含扩展名，文件不存在时自动创建
+    bool open(const std::string& basePath);
+    void close();
+    bool isOpen() const;
+
+    // O(1) 追加；映射区容量不足时按倍数扩展文件
+    bool append(std::string_view text, double result, std::int64_t timestamp);
+
+    std::size_t size() const;
+    const HistoryRecord& record(std::size_t index) const;
+
+    // 返回的视图直接指向映射内存，下一次 append 之前有效
+    std::string_view text(std::size_t index) const;
+
+    // 同步把映射区写回磁盘，调用之前追加的记录此后不受掉电影响；进程崩溃不需要调用
+    void flush();
+
+    const std::string& errorString() const { return error; }
+
+private:
+    struct MappedFile;
+
+    MappedFile* index;
+    MappedFile* arena;
+    std::uint64_t arenaUsed;
+    std::string error;
+
+    bool fail(const std::string& message);
+    bool reserve(std::size_t records, std::uint64_t bytes);
+};
+
+} // namespace calc
+
+#endif // CALC_HISTORYLOG_H
@@ -0,0 +1,188 @@
+#include "incremental.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace calc {
+
+namespace {
+
+constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// 这些记号的长度与后面的字符无关，结束处就是安全的检查点
+bool isSelfDelimiting(TokenKind kind)
+{
+    switch (kind) {
+    case TokenKind::Operator:
+    case TokenKind::Postfix:
+    case TokenKind::Prefix:
+    case TokenKind::LParen:
+    case TokenKind::RParen:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// 先按块用 memcmp 跳过相同部分，长公式每次按键的比较开销接近内存带宽
+std::size_t commonPrefix(std::string_view a, std::string_view b)
+{
+    constexpr std::size_t kBlock = 4096;
+    const std::size_t length = std::min(a.size(), b.size());
+    std::size_t i = 0;
+    while (i + kBlock <= length && std::memcmp(a.data() + i, b.data() + i, kBlock) == 0) {
+        i += kBlock;
+    }
+    while (i < length && a[i] == b[i]) {
+        ++i;
+    }
+    return i;
+}
+
+} // namespace
+
+IncrementalEvaluator::IncrementalEvaluator(const EvalOptions& options)
+    : options(options)
+{
+    reset();
+}
+
+void IncrementalEvaluator::setEvalOptions(const EvalOptions& newOptions)
+{
+    options = newOptions;
+    reset();
+}
+
+void IncrementalEvaluator::reset()
+{
+    source.clear();
+    checkpoints.clear();
+    checkpoints.emplace_back();
+    resumeOffset = 0;
+}
+
+void IncrementalEvaluator::commit(const Checkpoint& checkpoint)
+{
+    // 与倒数第二个检查点太近时说明末尾那个只是上次留下的候选，直接覆盖
+    if (checkpoints.size() >= 2
+        && checkpoint.offset - checkpoints[checkpoints.size() - 2].offset < kCheckpointSpacing) {
+        checkpoints.back() = checkpoint;
+    }
+    else {
+        checkpoints.push_back(checkpoint);
+    }
+}
+
+void IncrementalEvaluator::rewind(std::size_t unchangedPrefix)
+{
+    while (checkpoints.size() > 1 && checkpoints.back().offset > unchangedPrefix) {
+        checkpoints.pop_back();
+    }
+}
+
+double IncrementalEvaluator::evaluate(std::string_view text)
+{
+    rewind(commonPrefix(source, text));
+    source.assign(text.data(), text.size());
+    const std::size_t base = checkpoints.back().offset;
+    return run(text.substr(base), base);
+}
+
+double IncrementalEvaluator::evaluate(const Rope& text, std::size_t unchangedPrefix)
+{
+    rewind(std::min(unchangedPrefix, text.size()));
+    // 保存的文本不再对应最新输入，之后若改用 string_view 接口就从头比较
+    source.clear();
+    const std::size_t base = checkpoints.back().offset;
+    tailBuffer.resize(text.size() - base);
+    text.copy(&tailBuffer[0], base, tailBuffer.size());
+    return run(tailBuffer, base);
+}
+
+double IncrementalEvaluator::run(std::string_view text, std::size_t base)
+{
+    work = checkpoints.back();
+    resumeOffset = base;
+    latest.offset = base;
+
+    std::vector<double>& values = work.values;
+    auto emit = [&](OpCode op, double value, double) {
+        if (op == OpCode::PushConst) {
+            values.push_back(value);
+        }
+        else if (op == OpCode::PushVar) {
+            values.push_back(options.x);
+        }
+        else if (isBinary(op)) {
+            const double rhs = values.back();
+            values.pop_back();
+            values.back() = applyBinary(op, values.back(), rhs);
+        }
+        else {
+            values.back() = applyUnary(op, values.back(), options);
+        }
+    };
+
+    Lexer lexer(text);
+    for (Token tok = lexer.next(); tok.kind != TokenKind::End; tok = lexer.next()) {
+        if (parseToken(work.parser, tok, text, emit) != ParseError::None) {
+            return kNaN;
+        }
+
+        std::size_t offset = lexer.position();
+        if (!isSelfDelimiting(tok.kind)) {
+            // 数字和标识符可能还会变长，后面有空白才算结束
+            if (offset >= text.size() || !isSpace(text[offset])) {
+                continue;
+            }
+            ++offset;
+        }
+        offset += base;
+        if (offset - checkpoints.back().offset >= kCheckpointSpacing) {
+            work.offset = offset;
+            checkpoints.push_back(work);
+        }
+        latest.offset = offset;
+        latest.parser = work.parser;
+        latest.values = work.values;
+    }
+    if (latest.offset > checkpoints.back().offset) {
+        commit(latest);
+    }
+
+    // 去掉末尾悬空的部分，如 "12 + " 预览 12、"3 * (" 预览 3
+    ParserState& state = work.parser;
+    std::vector<StackEntry>& stack = state.stack;
+    while ((state.expectOperand || state.needParen) && !stack.empty()) {
+        if (stack.back().kind == StackKind::Operator && isBinary(stack.back().op)) {
+            state.expectOperand = false;
+        }
+        state.needParen = false;
+        stack.pop_back();
+    }
+    if (state.expectOperand) {
+        return kNaN;
+    }
+
+    // 补齐括号并输出剩余的运算符
+    while (!stack.empty()) {
+        const StackEntry entry = stack.back();
+        stack.pop_back();
+        if (entry.kind == StackKind::Operator) {
+            emit(entry.op, 0.0, 0.0);
+        }
+        else if (entry.kind == StackKind::Paren && !stack.empty() && stack.back().kind == StackKind::Function) {
+            emit(stack.back().op, 0.0, 0.0);
+            stack.pop_back();
+        }
+    }
+    return values.size() == 1 ? values.front() : kNaN;
+}
+
+} // namespace calc
@@ -0,0 +1,69 @@
+#ifndef CALC_INCREMENTAL_H
+#define CALC_INCREMENTAL_H
+
+#include "expression.h"
+#include "parser.h"
+#include "rope.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace calc {
+
+// 边输入边求值，用于实时预览。
+//
+// 调度场算法已经输出的指令当场执行，因此扫描到任意位置的全部状态就是
+// 运算符栈加值栈，两者的大小只与嵌套深度有关，与公式长度无关。在不会被后续输入
+// 改变的记号边界（运算符、括号之后或空白处）保存检查点，下次求值时从与上次文本
+// 共同前缀内的最后一个检查点继续，每次按键只重新扫描和求值末尾的一小段。
+// 检查点按 kCheckpointSpacing 字节稀疏保存，另外总保留最靠近末尾的一个
+class IncrementalEvaluator
+{
+public:
+    static constexpr std::size_t kCheckpointSpacing = 512;
+
+    explicit IncrementalEvaluator(const EvalOptions& options = EvalOptions());
+
+    const EvalOptions& evalOptions() const { return options; }
+    // 选项变化后已有的检查点全部作废
+    void setEvalOptions(const EvalOptions& options);
+
+    // 求值 text：末尾悬空的运算符、函数名和左括号被忽略，未闭合的括号自动补齐。
+    // 无法求值（语法错误或还没有操作数）时返回 NaN；数学错误与 Expression::evaluate 一致
+    double evaluate(std::string_view text);
+
+    // 同上，调用方给出 text 开头与上一次求值的文本相同的字节数，省去比较，
+    // 只把恢复点之后的一小段从 Rope 中取出扫描，每次按键与公式总长无关
+    double evaluate(const Rope& text, std::size_t unchangedPrefix);
+
+    void reset();
+
+    // 上一次求值从哪个字节开始重新扫描，用于观察增量效果
+    std::size_t resumedFrom() const { return resumeOffset; }
+
+private:
+    struct Checkpoint {
+        std::size_t offset = 0;  // 从这里继续扫描
+        ParserState parser;
+        std::vector<double> values;
+    };
+
+    void commit(const Checkpoint& checkpoint);
+    void rewind(std::size_t unchangedPrefix);
+    // 从 base 处的检查点继续扫描 tail（文本在 base 之后的部分）
+    double run(std::string_view tail, std::size_t base);
+
+    EvalOptions options;
+    std::string source;                   // 上一次按 string_view 求值的文本
+    std::vector<Checkpoint> checkpoints;  // offset 递增，第一个总是文本开头的空状态
+    Checkpoint work;                      // 当前扫描状态，重复使用避免分配
+    Checkpoint latest;                    // 本次扫描中最靠后的检查点候选
+    std::string tailBuffer;               // 从 Rope 取出的待扫描部分
+    std::size_t resumeOffset = 0;
+};
+
+} // namespace calc
+
+#endif // CALC_INCREMENTAL_H
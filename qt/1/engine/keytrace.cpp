@@ -0,0 +1,134 @@
+#include "keytrace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+namespace calc {
+
+namespace {
+
+constexpr char kMagic[4] = { 'C', 'K', 'T', '1' };
+
+bool fail(std::string* error, const std::string& message)
+{
+    if (error) {
+        *error = message;
+    }
+    return false;
+}
+
+} // namespace
+
+KeyTraceWriter::~KeyTraceWriter()
+{
+    close();
+}
+
+bool KeyTraceWriter::open(const std::string& path)
+{
+    close();
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        error = "cannot create " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    buffer.clear();
+    buffer.reserve(kFlushBytes + 8);
+    buffer.insert(buffer.end(), kMagic, kMagic + sizeof(kMagic));
+    last = std::chrono::steady_clock::now();
+    error.clear();
+    return true;
+}
+
+void KeyTraceWriter::close()
+{
+    if (!file) {
+        return;
+    }
+    flush();
+    std::fclose(file);
+    file = nullptr;
+}
+
+void KeyTraceWriter::record(Key key)
+{
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(now - last).count();
+    last = now;
+    const auto limit = static_cast<long long>(std::numeric_limits<std::uint32_t>::max());
+    record(KeyEvent{ key, static_cast<std::uint32_t>(std::min<long long>(micros, limit)) });
+}
+
+void KeyTraceWriter::record(const KeyEvent& event)
+{
+    if (!file) {
+        return;
+    }
+    buffer.push_back(static_cast<unsigned char>(event.key));
+    std::uint32_t delay = event.delayMicros;
+    while (delay >= 0x80) {
+        buffer.push_back(static_cast<unsigned char>(delay | 0x80));
+        delay >>= 7;
+    }
+    buffer.push_back(static_cast<unsigned char>(delay));
+    if (buffer.size() >= kFlushBytes) {
+        flush();
+    }
+}
+
+void KeyTraceWriter::flush()
+{
+    if (!buffer.empty() && std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+        error = std::string("write failed: ") + std::strerror(errno);
+    }
+    buffer.clear();
+    std::fflush(file);
+}
+
+bool readKeyTrace(const std::string& path, std::vector<KeyEvent>& events, std::string* error)
+{
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return fail(error, "cannot open " + path + ": " + std::strerror(errno));
+    }
+    std::vector<unsigned char> data;
+    unsigned char chunk[1 << 16];
+    for (std::size_t n; (n = std::fread(chunk, 1, sizeof(chunk), file)) > 0;) {
+        data.insert(data.end(), chunk, chunk + n);
+    }
+    std::fclose(file);
+
+    if (data.size() < sizeof(kMagic) || std::memcmp(data.data(), kMagic, sizeof(kMagic)) != 0) {
+        return fail(error, path + " is not a key trace");
+    }
+    events.clear();
+    std::size_t pos = sizeof(kMagic);
+    while (pos < data.size()) {
+        const unsigned char key = data[pos++];
+        if (key >= kKeyCount) {
+            return fail(error, "unknown key " + std::to_string(key) + " at byte " + std::to_string(pos - 1));
+        }
+        std::uint32_t delay = 0;
+        int shift = 0;
+        for (;;) {
+            // 截断的最后一个事件直接丢弃，录制进程被强行结束时会出现
+            if (pos >= data.size()) {
+                return true;
+            }
+            const unsigned char byte = data[pos++];
+            if (shift < 32) {
+                delay |= static_cast<std::uint32_t>(byte & 0x7f) << shift;
+            }
+            shift += 7;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        events.push_back(KeyEvent{ static_cast<Key>(key), delay });
+    }
+    return true;
+}
+
+} // namespace calc
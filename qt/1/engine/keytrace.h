@@ -0,0 +1,60 @@
+#ifndef CALC_KEYTRACE_H
+#define CALC_KEYTRACE_H
+
+#include "calculatorengine.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace calc {
+
+// 录制下来的一次按键
+struct KeyEvent {
+    Key key;
+    std::uint32_t delayMicros;  // 距上一次按键（第一次为开始录制）的微秒数
+};
+
+// 按键录制文件的写入端。
+//
+// 格式：4 字节文件头 "CKT1"，之后每个事件是一个字节的 Key 加上 LEB128 编码的
+// delayMicros，人手按键的间隔在几十到几百毫秒，每个事件通常只占 3~4 字节。
+// 事件先写入内存缓冲区，攒满 kFlushBytes 才写文件，按键路径上不做 I/O
+class KeyTraceWriter
+{
+public:
+    static constexpr std::size_t kFlushBytes = 4096;
+
+    KeyTraceWriter() = default;
+    ~KeyTraceWriter();
+
+    KeyTraceWriter(const KeyTraceWriter&) = delete;
+    KeyTraceWriter& operator=(const KeyTraceWriter&) = delete;
+
+    // 创建（覆盖）录制文件，从此刻开始计时
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return file != nullptr; }
+
+    void record(Key key);
+    void record(const KeyEvent& event);
+
+    const std::string& errorString() const { return error; }
+
+private:
+    std::FILE* file = nullptr;
+    std::vector<unsigned char> buffer;
+    std::chrono::steady_clock::time_point last;
+    std::string error;
+
+    void flush();
+};
+
+// 读出整个录制文件；文件头不对或出现未知的键时返回 false，并把原因写入 error
+bool readKeyTrace(const std::string& path, std::vector<KeyEvent>& events, std::string* error = nullptr);
+
+} // namespace calc
+
+#endif // CALC_KEYTRACE_H
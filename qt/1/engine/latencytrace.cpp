@@ -0,0 +1,259 @@
+#include "latencytrace.h"
+#include "samplestats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace calc {
+
+namespace {
+
+// 直方图按 2 的幂分桶，单位毫秒，最后一桶收下所有更大的值
+constexpr double kBucketLimits[] = { 1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024 };
+constexpr std::size_t kBucketCount = sizeof(kBucketLimits) / sizeof(kBucketLimits[0]) + 1;
+constexpr int kBarWidth = 40;
+
+void appendJsonString(std::string& out, const std::string& text)
+{
+    out += '"';
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        }
+        else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+void appendSeries(std::string& out, const char* label, std::vector<double> samples)
+{
+    const SampleStats stats = summarizeSamples(samples);
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-18s %8zu %9.2f %9.2f %9.2f %9.2f\n", label, stats.count, stats.p50 / 1000.0,
+                  stats.p90 / 1000.0, stats.p99 / 1000.0, stats.max / 1000.0);
+    out += line;
+}
+
+void appendHistogram(std::string& out, const char* label, const std::vector<double>& samples)
+{
+    if (samples.empty()) {
+        return;
+    }
+    std::size_t buckets[kBucketCount] = {};
+    for (const double micros : samples) {
+        const double millis = micros / 1000.0;
+        const std::size_t index =
+            std::upper_bound(std::begin(kBucketLimits), std::end(kBucketLimits), millis) - std::begin(kBucketLimits);
+        ++buckets[index];
+    }
+    const std::size_t largest = *std::max_element(std::begin(buckets), std::end(buckets));
+
+    out += "\n";
+    out += label;
+    out += " (ms)\n";
+    for (std::size_t i = 0; i < kBucketCount; ++i) {
+        if (buckets[i] == 0) {
+            continue;
+        }
+        char range[32];
+        if (i + 1 < kBucketCount) {
+            std::snprintf(range, sizeof(range), "< %g", kBucketLimits[i]);
+        }
+        else {
+            std::snprintf(range, sizeof(range), ">= %g", kBucketLimits[kBucketCount - 2]);
+        }
+        const int width = static_cast<int>((buckets[i] * kBarWidth + largest - 1) / largest);
+        char line[128];
+        std::snprintf(line, sizeof(line), "  %8s %-*s %zu\n", range, kBarWidth, std::string(width, '#').c_str(),
+                      buckets[i]);
+        out += line;
+    }
+}
+
+void appendHistogramJson(std::string& out, const char* name, std::vector<double> samples)
+{
+    std::size_t buckets[kBucketCount] = {};
+    for (const double micros : samples) {
+        const double millis = micros / 1000.0;
+        ++buckets[std::upper_bound(std::begin(kBucketLimits), std::end(kBucketLimits), millis) -
+                  std::begin(kBucketLimits)];
+    }
+    const SampleStats stats = summarizeSamples(samples);
+
+    std::ostringstream json;
+    json << "\"" << name << "\": {\"count\": " << stats.count << ", \"p50_us\": " << stats.p50
+         << ", \"p90_us\": " << stats.p90 << ", \"p99_us\": " << stats.p99 << ", \"max_us\": " << stats.max
+         << ", \"bucket_limits_ms\": [";
+    for (std::size_t i = 0; i + 1 < kBucketCount; ++i) {
+        json << (i ? ", " : "") << kBucketLimits[i];
+    }
+    json << "], \"buckets\": [";
+    for (std::size_t i = 0; i < kBucketCount; ++i) {
+        json << (i ? ", " : "") << buckets[i];
+    }
+    json << "]}";
+    out += json.str();
+}
+
+} // namespace
+
+LatencyTrace::LatencyTrace(Micros stallBudget)
+    : origin(std::chrono::steady_clock::now())
+    , budget(stallBudget)
+{
+}
+
+LatencyTrace::Micros LatencyTrace::now() const
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+void LatencyTrace::keyPressed(Key key)
+{
+    const Micros time = now();
+    // 有的按键（如存入内存）不改变显示器，等不到绘制，过久就放弃
+    const auto stale = [&](const PendingKey& pending) { return time - pending.time > kUnpaintedTimeout; };
+    const std::size_t before = pendingKeys.size();
+    pendingKeys.erase(std::remove_if(pendingKeys.begin(), pendingKeys.end(), stale), pendingKeys.end());
+    unpaintedKeys += before - pendingKeys.size();
+
+    pendingKeys.push_back({ key, time, false });
+}
+
+void LatencyTrace::displayUpdated()
+{
+    const Micros time = now();
+    for (PendingKey& pending : pendingKeys) {
+        if (!pending.updated) {
+            pending.updated = true;
+            keyToUpdate.push_back(static_cast<double>(time - pending.time));
+        }
+    }
+}
+
+void LatencyTrace::displayPainted(Micros start, Micros end)
+{
+    paintTimes.push_back(static_cast<double>(end - start));
+    addSpan({ "paint display", "paint", start, end - start, 1, -1 });
+
+    // 只有显示内容已经更新过的按键才算画出来了；后台求值还没返回的 "=" 继续等待
+    auto painted = std::partition(pendingKeys.begin(), pendingKeys.end(),
+                                  [](const PendingKey& pending) { return !pending.updated; });
+    for (auto it = painted; it != pendingKeys.end(); ++it) {
+        keyToPaint.push_back(static_cast<double>(end - it->time));
+        addSpan({ "key", "latency", it->time, end - it->time, 2, static_cast<int>(it->key) });
+    }
+    pendingKeys.erase(painted, pendingKeys.end());
+}
+
+void LatencyTrace::eventHandled(const std::string& name, Micros start, Micros duration, bool topLevel)
+{
+    if (topLevel) {
+        eventTimes.push_back(static_cast<double>(duration));
+    }
+    if (topLevel && duration >= budget) {
+        stalls.push_back({ name, "stall", start, duration, 1, -1 });
+        addSpan(stalls.back());
+        return;
+    }
+    addSpan({ name, "event", start, duration, 1, -1 });
+}
+
+void LatencyTrace::addSpan(Span span)
+{
+    if (spans.size() >= kMaxEvents) {
+        ++droppedSpans;
+        return;
+    }
+    spans.push_back(std::move(span));
+}
+
+std::string LatencyTrace::summary() const
+{
+    std::string out;
+    char line[200];
+    std::snprintf(line, sizeof(line), "%-18s %8s %9s %9s %9s %9s\n", "latency (ms)", "count", "p50", "p90", "p99",
+                  "max");
+    out += line;
+    appendSeries(out, "key -> display", keyToUpdate);
+    appendSeries(out, "key -> paint", keyToPaint);
+    appendSeries(out, "display paint", paintTimes);
+    appendSeries(out, "slow events", eventTimes);
+    if (unpaintedKeys > 0) {
+        std::snprintf(line, sizeof(line), "%zu keys never reached the display\n", unpaintedKeys);
+        out += line;
+    }
+
+    appendHistogram(out, "key -> paint", keyToPaint);
+
+    std::snprintf(line, sizeof(line), "\nstalls over %.1f ms: %zu\n", budget / 1000.0, stalls.size());
+    out += line;
+    std::vector<Span> worst = stalls;
+    std::sort(worst.begin(), worst.end(), [](const Span& a, const Span& b) { return a.duration > b.duration; });
+    for (std::size_t i = 0; i < worst.size() && i < 10; ++i) {
+        std::snprintf(line, sizeof(line), "  %9.1f ms at %9.3f s  %s\n", worst[i].duration / 1000.0,
+                      worst[i].start / 1e6, worst[i].name.c_str());
+        out += line;
+    }
+    if (droppedSpans > 0) {
+        std::snprintf(line, sizeof(line), "trace full, %zu spans not recorded\n", droppedSpans);
+        out += line;
+    }
+    return out;
+}
+
+bool LatencyTrace::writeChromeTrace(const std::string& path, std::string* error) const
+{
+    std::string out;
+    out.reserve(spans.size() * 96 + 1024);
+    out += "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    out += "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"GUI thread\"}},\n";
+    out += "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2, \"args\": {\"name\": \"key to paint\"}}";
+    char numbers[128];
+    for (const Span& span : spans) {
+        out += ",\n{\"name\": ";
+        appendJsonString(out, span.name);
+        std::snprintf(numbers, sizeof(numbers), ", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %lld, \"dur\": %lld, "
+                      "\"pid\": 1, \"tid\": %d", span.category, static_cast<long long>(span.start),
+                      static_cast<long long>(span.duration), span.track);
+        out += numbers;
+        if (span.key >= 0) {
+            std::snprintf(numbers, sizeof(numbers), ", \"args\": {\"key\": %d}", span.key);
+            out += numbers;
+        }
+        out += '}';
+    }
+    out += "\n],\n\"otherData\": {";
+    appendHistogramJson(out, "key_to_display", keyToUpdate);
+    out += ", ";
+    appendHistogramJson(out, "key_to_paint", keyToPaint);
+    out += ", ";
+    appendHistogramJson(out, "display_paint", paintTimes);
+    out += ", ";
+    appendHistogramJson(out, "slow_events", eventTimes);
+    std::snprintf(numbers, sizeof(numbers), ", \"stall_budget_us\": %lld, \"stalls\": %zu}\n}\n",
+                  static_cast<long long>(budget), stalls.size());
+    out += numbers;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << out;
+    if (!file) {
+        if (error) {
+            *error = "cannot write " + path;
+        }
+        return false;
+    }
+    return true;
+}
+
+} // namespace calc
@@ -0,0 +1,84 @@
+#ifndef CALC_LATENCYTRACE_H
+#define CALC_LATENCYTRACE_H
+
+#include "calculatorengine.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace calc {
+
+// 按键到画面的延迟和事件循环卡顿的记录器，本身不依赖 Qt。
+//
+// 界面在收到按键、更新显示内容、显示器绘制完成时各报告一次，事件分发层报告每个事件的处理时长。
+// 一次按键的延迟从 keyPressed 算到它之后第一次完成的显示器绘制；
+// 处理时间超过卡顿阈值的顶层事件（包括在处理函数里跑嵌套事件循环的）记为卡顿。
+// 结束时输出文本直方图和 Chrome trace JSON，后者可以用 chrome://tracing 或 ui.perfetto.dev 打开。
+// 只在界面线程使用，不加锁
+class LatencyTrace
+{
+public:
+    using Micros = std::int64_t;
+
+    static constexpr Micros kMinEventMicros = 500;         // 更短的事件只统计不写进 trace
+    static constexpr std::size_t kMaxEvents = 1 << 20;     // trace 事件数上限，超过后不再记录
+    static constexpr Micros kUnpaintedTimeout = 1000000;   // 超过这么久没画出来的按键不再等待
+
+    explicit LatencyTrace(Micros stallBudget = 50000);
+
+    Micros now() const;  // 自创建以来的微秒数
+    Micros stallBudget() const { return budget; }
+
+    void keyPressed(Key key);
+    void displayUpdated();
+    void displayPainted(Micros start, Micros end);
+
+    // 事件分发层的一次事件处理；topLevel 表示由事件循环直接分发，而不是在别的处理函数里同步发送。
+    // 先用 shouldRecord 判断，避免为大量短事件构造名字
+    bool shouldRecord(Micros duration) const { return duration >= kMinEventMicros; }
+    void eventHandled(const std::string& name, Micros start, Micros duration, bool topLevel);
+
+    std::size_t stallCount() const { return stalls.size(); }
+
+    // 各项延迟的分位数、对数刻度的直方图和最严重的几次卡顿
+    std::string summary() const;
+    bool writeChromeTrace(const std::string& path, std::string* error = nullptr) const;
+
+private:
+    struct PendingKey {
+        Key key;
+        Micros time;
+        bool updated;  // 显示内容是否已为它更新
+    };
+
+    struct Span {
+        std::string name;
+        const char* category;
+        Micros start;
+        Micros duration;
+        int track;     // Chrome trace 的 tid：1 事件分发，2 按键延迟
+        int key;       // 按键延迟的 Key 值，其他为 -1
+    };
+
+    std::chrono::steady_clock::time_point origin;
+    Micros budget;
+    std::vector<PendingKey> pendingKeys;
+    std::vector<Span> spans;
+    std::vector<Span> stalls;
+    std::size_t droppedSpans = 0;
+    std::size_t unpaintedKeys = 0;
+
+    // 以微秒为单位的样本
+    std::vector<double> keyToUpdate;
+    std::vector<double> keyToPaint;
+    std::vector<double> paintTimes;
+    std::vector<double> eventTimes;  // 不短于 kMinEventMicros 的顶层事件
+
+    void addSpan(Span span);
+};
+
+} // namespace calc
+
+#endif // CALC_LATENCYTRACE_H
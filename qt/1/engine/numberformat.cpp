@@ -0,0 +1,59 @@
+#include "numberformat.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+namespace calc {
+
+namespace {
+
+constexpr int kMaxFractionDigits = 10;
+
+} // namespace
+
+std::size_t formatNumber(double number, char* buffer, double zeroThreshold)
+{
+    char* const end = buffer + kNumberBufferSize - 1;
+    const double magnitude = std::fabs(number);
+
+    // 避免把计算误差显示成极小的非零值
+    if (magnitude < zeroThreshold || number == 0.0) {
+        buffer[0] = '0';
+        buffer[1] = '\0';
+        return 1;
+    }
+
+    char* last;
+    if (magnitude >= 1e10 || magnitude < 1e-6) {
+        // 也覆盖 inf 和 nan
+        last = std::to_chars(buffer, end, number, std::chars_format::scientific, 6).ptr;
+    }
+    else {
+        // 先取最短往返表示（Ryu），小数位不超过上限时直接使用；
+        // 否则按上限四舍五入，再原地去掉末尾的 0 和小数点
+        last = std::to_chars(buffer, end, number, std::chars_format::fixed).ptr;
+        const char* dot = static_cast<const char*>(std::memchr(buffer, '.', static_cast<std::size_t>(last - buffer)));
+        if (dot && last - dot - 1 > kMaxFractionDigits) {
+            last = std::to_chars(buffer, end, number, std::chars_format::fixed, kMaxFractionDigits).ptr;
+            while (last[-1] == '0') {
+                --last;
+            }
+            if (last[-1] == '.') {
+                --last;
+            }
+        }
+    }
+
+    *last = '\0';
+    return static_cast<std::size_t>(last - buffer);
+}
+
+std::string formatNumber(double number)
+{
+    char buffer[kNumberBufferSize];
+    const std::size_t length = formatNumber(number, buffer);
+    return std::string(buffer, length);
+}
+
+} // namespace calc
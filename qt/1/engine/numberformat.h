@@ -0,0 +1,26 @@
+#ifndef CALC_NUMBERFORMAT_H
+#define CALC_NUMBERFORMAT_H
+
+#include <cstddef>
+#include <string>
+
+namespace calc {
+
+// formatNumber 所需的缓冲区大小（含结尾的 '\0'）
+constexpr std::size_t kNumberBufferSize = 32;
+
+// 默认把绝对值低于此值的结果显示为 0，掩盖 double 计算的舍入误差
+constexpr double kDisplayZeroThreshold = 1e-10;
+
+// 结果显示格式，写入调用方提供的栈缓冲区，不做任何堆分配，返回写入的长度：
+//   |x| < zeroThreshold    显示为 0（结果误差已知时可传 0）
+//   1e-6 <= |x| < 1e10     定点小数，取最短的可精确往返表示，最多保留 10 位小数
+//   其余                   科学计数法，6 位小数（如 1.234568e+10）
+std::size_t formatNumber(double number, char* buffer, double zeroThreshold = kDisplayZeroThreshold);
+
+// 便于非热点路径使用的字符串版本
+std::string formatNumber(double number);
+
+} // namespace calc
+
+#endif // CALC_NUMBERFORMAT_H
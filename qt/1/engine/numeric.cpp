@@ -0,0 +1,579 @@
+#include "numeric.h"
+#include "parallel.h"
+#include "trig.h"
+#include "vectoreval.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace calc {
+
+namespace {
+
+constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+constexpr double kEpsilon = std::numeric_limits<double>::epsilon();
+constexpr double kDegree = 3.14159265358979323846 / 180.0;
+
+// ---- 前向自动微分 ----
+
+// f(a) = value 时 f'(a)，与 applyUnary 的函数一一对应
+double unarySlope(OpCode op, double a, double value, const EvalOptions& options)
+{
+    const double scale = options.angleInDegrees ? kDegree : 1.0;
+    switch (op) {
+    case OpCode::Neg:
+        return -1.0;
+    case OpCode::Square:
+        return 2.0 * a;
+    case OpCode::Sin:
+        return scale * trigFunction(OpCode::Cos, options.angleInDegrees)(a);
+    case OpCode::Cos:
+        return -scale * trigFunction(OpCode::Sin, options.angleInDegrees)(a);
+    case OpCode::Tan:
+        return scale * (1.0 + value * value);
+    case OpCode::Ln:
+        return 1.0 / a;
+    case OpCode::Log10:
+        return 1.0 / (a * std::log(10.0));
+    case OpCode::Sqrt:
+        return 0.5 / value;
+    default:
+        // n! 只在整数上有定义，没有导数
+        return kNaN;
+    }
+}
+
+// 除法的导数：除数被当作 0 时商为 inf，导数不存在
+double quotientSlope(double quotient, double divisor, double da, double db)
+{
+    return isZeroDivisor(divisor) ? kNaN : (da - quotient * db) / divisor;
+}
+
+double powerSlope(double a, double b, double value, double da, double db)
+{
+    // 只在确实依赖 x 的一侧求导，常数底数或指数为负数、0 时不引入 log 的 NaN
+    const double viaBase = da != 0.0 ? b * std::pow(a, b - 1.0) * da : 0.0;
+    const double viaExponent = db != 0.0 ? value * std::log(a) * db : 0.0;
+    return viaBase + viaExponent;
+}
+
+// ---- Gauss-Kronrod 15 点规则，节点与权重取自 QUADPACK 的 qk15 ----
+
+constexpr int kNodes = 15;
+// Kronrod 节点 xgk[0..6] 与中心 0；奇数下标（1、3、5）同时也是 7 点 Gauss 节点
+constexpr double kKronrodNodes[8] = {
+    0.991455371120812639206854697526329, 0.949107912342758524526189684047851, 0.864864423359769072789712788640926,
+    0.741531185599394439863864773280788, 0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+    0.207784955007898467600689403773245, 0.000000000000000000000000000000000,
+};
+constexpr double kKronrodWeights[8] = {
+    0.022935322010529224963732008058970, 0.063092092629978553290700663189204, 0.104790010322250183839876322541518,
+    0.140653259715525918745189590510238, 0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+    0.204432940075298892414161999234649, 0.209482141084727828012999174891714,
+};
+constexpr double kGaussWeights[4] = {
+    0.129484966168869693270611432679082, 0.279705391489276667901467771423780, 0.381830050505118944950369775488975,
+    0.417959183673469387755102040816327,
+};
+constexpr std::size_t kNodesPerTask = 4096;  // 每个线程至少分到的节点数，少于此数不值得分给辅助线程
+
+struct Interval {
+    double a;
+    double b;
+    double value;
+    double error;
+    double roundoff;  // 舍入误差的下限，误差估计不会低于它
+    bool finite;      // 15 个节点上的函数值都是有限数
+    bool refinable;   // 细分后出现 inf/NaN 的区间保留原结果，不再细分
+};
+
+// 区间 (a, b) 上 15 个节点的位置：中心、再依次是 ±xgk[j]
+void kronrodNodes(double a, double b, double* x)
+{
+    const double center = 0.5 * (a + b);
+    const double half = 0.5 * (b - a);
+    x[0] = center;
+    for (int j = 0; j < 7; ++j) {
+        x[1 + 2 * j] = center - half * kKronrodNodes[j];
+        x[2 + 2 * j] = center + half * kKronrodNodes[j];
+    }
+}
+
+// 由节点上的函数值求积分与误差估计，误差按 QUADPACK 的经验公式放缩
+Interval kronrodRule(double a, double b, const double* f)
+{
+    const double half = 0.5 * (b - a);
+    double kronrod = f[0] * kKronrodWeights[7];
+    double gauss = f[0] * kGaussWeights[3];
+    double absolute = std::fabs(kronrod);
+    for (int j = 0; j < 7; ++j) {
+        const double sum = f[1 + 2 * j] + f[2 + 2 * j];
+        kronrod += kKronrodWeights[j] * sum;
+        absolute += kKronrodWeights[j] * (std::fabs(f[1 + 2 * j]) + std::fabs(f[2 + 2 * j]));
+        if (j % 2 == 1) {
+            gauss += kGaussWeights[j / 2] * sum;
+        }
+    }
+    const double mean = 0.5 * kronrod;
+    double spread = kKronrodWeights[7] * std::fabs(f[0] - mean);
+    for (int j = 0; j < 7; ++j) {
+        spread += kKronrodWeights[j] * (std::fabs(f[1 + 2 * j] - mean) + std::fabs(f[2 + 2 * j] - mean));
+    }
+
+    bool finite = true;
+    for (int i = 0; i < kNodes; ++i) {
+        finite = finite && std::isfinite(f[i]);
+    }
+    Interval interval{a, b, kronrod * half, std::fabs((kronrod - gauss) * half), 0.0, finite, true};
+    spread *= std::fabs(half);
+    absolute *= std::fabs(half);
+    if (spread != 0.0 && interval.error != 0.0) {
+        interval.error = spread * std::min(1.0, std::pow(200.0 * interval.error / spread, 1.5));
+    }
+    interval.roundoff = 50.0 * kEpsilon * absolute;
+    interval.error = std::max(interval.error, interval.roundoff);
+    return interval;
+}
+
+// 对一批区间求 Kronrod 规则：全部节点排成一列，按块分给多个线程整列求值
+void evaluateIntervals(const Program& f, const std::vector<std::pair<double, double>>& bounds,
+                       std::vector<Interval>& out, std::vector<double>& xs, std::vector<double>& ys,
+                       unsigned threads)
+{
+    const std::size_t count = bounds.size() * kNodes;
+    xs.resize(count);
+    ys.resize(count);
+    for (std::size_t i = 0; i < bounds.size(); ++i) {
+        kronrodNodes(bounds[i].first, bounds[i].second, xs.data() + i * kNodes);
+    }
+    const std::size_t tasks = std::max<std::size_t>(1, std::min<std::size_t>(threads, count / kNodesPerTask));
+    parallelFor(tasks, static_cast<unsigned>(tasks), [&](std::size_t task, unsigned) {
+        const std::size_t begin = count * task / tasks;
+        const std::size_t end = count * (task + 1) / tasks;
+        evaluateColumn(f, xs.data() + begin, ys.data() + begin, end - begin);
+    });
+    for (std::size_t i = 0; i < bounds.size(); ++i) {
+        out.push_back(kronrodRule(bounds[i].first, bounds[i].second, ys.data() + i * kNodes));
+    }
+}
+
+// ---- Brent 法 ----
+
+// 在 f(a)、f(b) 异号的区间内求根（Brent 1973 的 zeroin）
+SolveResult brent(const Program& f, double a, double fa, double b, double fb, const SolveOptions& options,
+                  int evaluations)
+{
+    SolveResult result;
+    double c = a;
+    double fc = fa;
+    double d = b - a;
+    double e = d;
+    for (int iteration = 0; iteration < options.maxIterations; ++iteration) {
+        if ((fb > 0.0) == (fc > 0.0)) {
+            c = a;
+            fc = fa;
+            d = b - a;
+            e = d;
+        }
+        if (std::fabs(fc) < std::fabs(fb)) {
+            a = b;
+            b = c;
+            c = a;
+            fa = fb;
+            fb = fc;
+            fc = fa;
+        }
+        const double tolerance = 2.0 * kEpsilon * std::fabs(b) + 0.5 * options.tolerance;
+        const double m = 0.5 * (c - b);
+        if (std::fabs(m) <= tolerance || fb == 0.0) {
+            result.converged = true;
+            break;
+        }
+        if (std::fabs(e) >= tolerance && std::fabs(fa) > std::fabs(fb)) {
+            // 割线或反二次插值
+            double p;
+            double q;
+            const double s = fb / fa;
+            if (a == c) {
+                p = 2.0 * m * s;
+                q = 1.0 - s;
+            }
+            else {
+                const double r = fb / fc;
+                const double t = fa / fc;
+                p = s * (2.0 * m * t * (t - r) - (b - a) * (r - 1.0));
+                q = (t - 1.0) * (r - 1.0) * (s - 1.0);
+            }
+            if (p > 0.0) {
+                q = -q;
+            }
+            else {
+                p = -p;
+            }
+            if (2.0 * p < std::min(3.0 * m * q - std::fabs(tolerance * q), std::fabs(e * q))) {
+                e = d;
+                d = p / q;
+            }
+            else {
+                d = m;
+                e = m;
+            }
+        }
+        else {
+            d = m;
+            e = m;
+        }
+        a = b;
+        fa = fb;
+        b += std::fabs(d) > tolerance ? d : (m > 0.0 ? tolerance : -tolerance);
+        fb = f.run(b);
+        ++evaluations;
+    }
+    result.root = b;
+    result.residual = fb;
+    result.iterations = evaluations;
+    return result;
+}
+
+} // namespace
+
+double runWithDerivative(const Program& program, double x, double& derivative)
+{
+    derivative = kNaN;
+    if (!program.isValid()) {
+        return kNaN;
+    }
+
+    // 每个寄存器同时保存值和对 x 的导数
+    constexpr int kInlineRegisters = 64;
+    double inlineValues[kInlineRegisters];
+    double inlineSlopes[kInlineRegisters];
+    std::vector<double> heapRegs;
+    double* v = inlineValues;
+    double* d = inlineSlopes;
+    if (program.registerCount() > kInlineRegisters) {
+        heapRegs.resize(2 * static_cast<std::size_t>(program.registerCount()));
+        v = heapRegs.data();
+        d = v + program.registerCount();
+    }
+
+    const EvalOptions& options = program.evalOptions();
+    for (const ByteCode& ins : program.instructions()) {
+        const double a = v[ins.a];
+        const double da = d[ins.a];
+        const double b = v[ins.b];
+        const double db = d[ins.b];
+        double value;
+        double slope;
+        switch (ins.op) {
+        case ByteOp::LoadK: value = ins.k; slope = 0.0; break;
+        case ByteOp::LoadX: value = x; slope = 1.0; break;
+        case ByteOp::Neg: value = -a; slope = -da; break;
+        case ByteOp::Square: value = a * a; slope = 2.0 * a * da; break;
+        case ByteOp::Unary:
+            value = applyUnary(ins.fn, a, options);
+            slope = da != 0.0 ? unarySlope(ins.fn, a, value, options) * da : 0.0;
+            break;
+        case ByteOp::Add: value = a + b; slope = da + db; break;
+        case ByteOp::Sub: value = a - b; slope = da - db; break;
+        case ByteOp::Mul: value = a * b; slope = da * b + a * db; break;
+        case ByteOp::Div:
+            value = applyBinary(OpCode::Div, a, b);
+            slope = quotientSlope(value, b, da, db);
+            break;
+        case ByteOp::Mod:
+            // fmod(a, b) = a - trunc(a / b)·b，商的整数部分局部不变
+            value = applyBinary(OpCode::Mod, a, b);
+            slope = isZeroDivisor(b) ? kNaN : da - std::trunc(a / b) * db;
+            break;
+        case ByteOp::Pow:
+            value = std::pow(a, b);
+            slope = powerSlope(a, b, value, da, db);
+            break;
+        case ByteOp::AddK: value = a + ins.k; slope = da; break;
+        case ByteOp::SubK: value = a - ins.k; slope = da; break;
+        case ByteOp::MulK: value = a * ins.k; slope = da * ins.k; break;
+        case ByteOp::DivK:
+            value = applyBinary(OpCode::Div, a, ins.k);
+            slope = quotientSlope(value, ins.k, da, 0.0);
+            break;
+        case ByteOp::ModK:
+            value = applyBinary(OpCode::Mod, a, ins.k);
+            slope = isZeroDivisor(ins.k) ? kNaN : da;
+            break;
+        case ByteOp::PowK:
+            value = std::pow(a, ins.k);
+            slope = powerSlope(a, ins.k, value, da, 0.0);
+            break;
+        case ByteOp::KSub: value = ins.k - a; slope = -da; break;
+        case ByteOp::KDiv:
+            value = applyBinary(OpCode::Div, ins.k, a);
+            slope = quotientSlope(value, a, 0.0, da);
+            break;
+        case ByteOp::Ret:
+        default:
+            derivative = d[0];
+            return v[0];
+        }
+        v[ins.dst] = value;
+        d[ins.dst] = slope;
+    }
+    return kNaN;
+}
+
+IntegralResult integrate(const Program& f, double a, double b, const IntegrateOptions& options, JobContext* job)
+{
+    IntegralResult result;
+    if (!f.isValid() || !std::isfinite(a) || !std::isfinite(b)) {
+        result.value = kNaN;
+        return result;
+    }
+    if (a == b) {
+        result.converged = true;
+        return result;
+    }
+    const double sign = a < b ? 1.0 : -1.0;
+    if (a > b) {
+        std::swap(a, b);
+    }
+    const unsigned threads = resolveThreadCount(options.threads);
+    const double length = b - a;
+
+    std::vector<Interval> intervals;
+    std::vector<Interval> children;
+    std::vector<Interval> next;
+    std::vector<std::pair<double, double>> bounds{{a, b}};
+    std::vector<double> xs;
+    std::vector<double> ys;
+    auto fail = [&result]() {
+        result.value = kNaN;
+        result.errorEstimate = kNaN;
+        result.converged = false;
+        return result;
+    };
+    // 整个区间上就遇到 inf/NaN（如 1/x 在 [-1, 1] 上），积分不存在
+    evaluateIntervals(f, bounds, intervals, xs, ys, threads);
+    result.evaluations = kNodes;
+    if (!intervals.front().finite) {
+        return fail();
+    }
+
+    for (;;) {
+        double value = 0.0;
+        double error = 0.0;
+        double roundoff = 0.0;
+        for (const Interval& interval : intervals) {
+            value += interval.value;
+            error += interval.error;
+            roundoff += interval.roundoff;
+        }
+        result.value = sign * value;
+        result.errorEstimate = error;
+        result.intervals = intervals.size();
+        // 容差不低于舍入误差，要求更高的精度只会无休止地细分
+        const double tolerance =
+            std::max({options.absoluteTolerance, options.relativeTolerance * std::fabs(value), roundoff});
+        if (error <= tolerance) {
+            result.converged = true;
+            return result;
+        }
+        if (job && job->isCancelled()) {
+            return fail();
+        }
+
+        // 误差超出按长度分得的份额的子区间都二分，同一轮的新节点一起求值
+        std::vector<std::size_t> selected;
+        for (std::size_t i = 0; i < intervals.size(); ++i) {
+            const Interval& interval = intervals[i];
+            const double mid = 0.5 * (interval.a + interval.b);
+            if (interval.refinable && interval.error > tolerance * ((interval.b - interval.a) / length) &&
+                interval.error > interval.roundoff && mid > interval.a && mid < interval.b) {
+                selected.push_back(i);
+            }
+        }
+        const std::size_t room = options.maxIntervals > intervals.size() ? options.maxIntervals - intervals.size() : 0;
+        if (selected.size() > room) {
+            std::nth_element(selected.begin(), selected.begin() + static_cast<std::ptrdiff_t>(room), selected.end(),
+                             [&](std::size_t x, std::size_t y) { return intervals[x].error > intervals[y].error; });
+            selected.resize(room);
+        }
+        if (selected.empty()) {
+            return result;
+        }
+
+        std::sort(selected.begin(), selected.end());
+        bounds.clear();
+        for (const std::size_t i : selected) {
+            const double mid = 0.5 * (intervals[i].a + intervals[i].b);
+            bounds.emplace_back(intervals[i].a, mid);
+            bounds.emplace_back(mid, intervals[i].b);
+        }
+        children.clear();
+        evaluateIntervals(f, bounds, children, xs, ys, threads);
+        result.evaluations += bounds.size() * kNodes;
+
+        // 按原顺序换上两半；可积的端点奇异（如 1/√x 在 0 处）细分到节点贴近奇点时
+        // 除法会给出 inf，这时保留上一层的结果，误差估计如实计入
+        next.clear();
+        std::size_t k = 0;
+        for (std::size_t i = 0; i < intervals.size(); ++i) {
+            if (k < selected.size() && selected[k] == i) {
+                const Interval& left = children[2 * k];
+                const Interval& right = children[2 * k + 1];
+                if (left.finite && right.finite) {
+                    next.push_back(left);
+                    next.push_back(right);
+                }
+                else {
+                    next.push_back(intervals[i]);
+                    next.back().refinable = false;
+                }
+                ++k;
+            }
+            else {
+                next.push_back(intervals[i]);
+            }
+        }
+        std::swap(intervals, next);
+    }
+}
+
+SolveResult solve(const Program& f, double x0, const SolveOptions& options, JobContext* job)
+{
+    SolveResult result;
+    result.root = x0;
+    result.residual = kNaN;
+    if (!f.isValid() || !std::isfinite(x0)) {
+        return result;
+    }
+
+    int evaluations = 0;
+    // 迭代中遇到的最好的点，以及遇到过的最窄的变号区间
+    double best = x0;
+    double fBest = kNaN;
+    bool bracketed = false;
+    double lo = 0.0;
+    double fLo = 0.0;
+    double hi = 0.0;
+    double fHi = 0.0;
+    auto visit = [&](double x, double fx, double previous, double fPrevious) {
+        if (!std::isfinite(fx)) {
+            return;
+        }
+        if (!(std::fabs(fx) >= std::fabs(fBest))) {
+            best = x;
+            fBest = fx;
+        }
+        if (std::isfinite(fPrevious) && (fx > 0.0) != (fPrevious > 0.0) &&
+            (!bracketed || std::fabs(x - previous) < std::fabs(hi - lo))) {
+            bracketed = true;
+            lo = previous;
+            fLo = fPrevious;
+            hi = x;
+            fHi = fx;
+        }
+    };
+    auto finish = [&](double x, double fx) {
+        result.root = x;
+        result.residual = fx;
+        result.iterations = evaluations;
+        result.converged = true;
+        return result;
+    };
+
+    // 牛顿迭代：步长使 |f| 不降时减半，导数来自前向自动微分
+    double x = x0;
+    double slope = 0.0;
+    double fx = runWithDerivative(f, x, slope);
+    ++evaluations;
+    visit(x, fx, kNaN, kNaN);
+    for (int iteration = 0; iteration < options.maxIterations && std::isfinite(fx); ++iteration) {
+        if (fx == 0.0) {
+            return finish(x, fx);
+        }
+        if (!std::isfinite(slope) || slope == 0.0 || (job && job->isCancelled())) {
+            break;
+        }
+        double step = fx / slope;
+        if (std::fabs(step) <= options.tolerance * std::max(1.0, std::fabs(x))) {
+            return finish(x, fx);
+        }
+        bool accepted = false;
+        double xn = x;
+        double fn = fx;
+        double sn = slope;
+        for (int halving = 0; halving < 32 && !accepted; ++halving, step *= 0.5) {
+            xn = x - step;
+            fn = runWithDerivative(f, xn, sn);
+            ++evaluations;
+            visit(xn, fn, x, fx);
+            accepted = std::isfinite(fn) && std::fabs(fn) < std::fabs(fx);
+        }
+        if (!accepted) {
+            break;
+        }
+        const bool small = std::fabs(xn - x) <= options.tolerance * std::max(1.0, std::fabs(xn));
+        x = xn;
+        fx = fn;
+        slope = sn;
+        if (small || fx == 0.0) {
+            return finish(x, fx);
+        }
+    }
+
+    // 牛顿法停滞：从最好的点向两侧倍增步长寻找变号区间，
+    // 起步很小，牛顿法已经贴近根、只是被舍入卡住时也能立即夹住。
+    // 牛顿法在导数接近 0 处跳得很远时留下的区间太宽，也在附近再找一个更窄的
+    if (std::isfinite(fBest)) {
+        const double center = best;
+        const double fCenter = fBest;
+        double step = 16.0 * kEpsilon * std::max(1.0, std::fabs(center));
+        double left = center;
+        double fLeft = fCenter;
+        double right = center;
+        double fRight = fCenter;
+        for (int k = 0; k < options.maxBracketSteps && (!bracketed || step < std::fabs(hi - lo)); ++k, step *= 2.0) {
+            if (job && job->isCancelled()) {
+                break;
+            }
+            const double xl = center - step;
+            const double fl = f.run(xl);
+            const double xr = center + step;
+            const double fr = f.run(xr);
+            evaluations += 2;
+            if (fl == 0.0) {
+                return finish(xl, fl);
+            }
+            if (fr == 0.0) {
+                return finish(xr, fr);
+            }
+            visit(xl, fl, left, fLeft);
+            if (std::isfinite(fl)) {
+                left = xl;
+                fLeft = fl;
+            }
+            visit(xr, fr, right, fRight);
+            if (std::isfinite(fr)) {
+                right = xr;
+                fRight = fr;
+            }
+        }
+    }
+
+    if (!bracketed) {
+        result.root = best;
+        result.residual = fBest;
+        result.iterations = evaluations;
+        return result;
+    }
+    SolveResult refined = brent(f, lo, fLo, hi, fHi, options, evaluations);
+    // 变号区间里可能是间断点（如 1/x 的 0），残差没有变小就不算根
+    if (refined.converged && !(std::fabs(refined.residual) <= std::max(std::fabs(fLo), std::fabs(fHi)))) {
+        refined.converged = false;
+    }
+    return refined;
+}
+
+} // namespace calc
@@ -0,0 +1,59 @@
+#ifndef CALC_NUMERIC_H
+#define CALC_NUMERIC_H
+
+#include "evalservice.h"
+#include "program.h"
+
+#include <cstddef>
+
+namespace calc {
+
+// 数值积分与方程求根，直接在已编译的字节码上求值，不再解析公式文本
+
+// 以 x 的取值执行程序，同时用前向自动微分求出 df/dx 写入 derivative。
+// 返回值与 Program::run(x) 逐位一致；导数不存在的地方（如 n!、间断点）为 NaN
+double runWithDerivative(const Program& program, double x, double& derivative);
+
+struct IntegrateOptions {
+    double absoluteTolerance = 1e-12;
+    double relativeTolerance = 1e-10;
+    std::size_t maxIntervals = 4096;  // 细分后子区间数的上限
+    unsigned threads = 0;             // 0 表示使用全部硬件线程
+};
+
+struct IntegralResult {
+    double value = 0.0;
+    double errorEstimate = 0.0;  // 各子区间 Kronrod 与 Gauss 结果之差的总和
+    std::size_t evaluations = 0;
+    std::size_t intervals = 0;
+    bool converged = false;      // 误差估计是否达到容差；被积函数出现 inf/NaN 时为 false，value 为 NaN
+};
+
+// 自适应 Gauss-Kronrod（7 点 Gauss、15 点 Kronrod）求 ∫[a, b] f(x) dx。
+// 每一轮把误差超出其长度份额的子区间全部二分，所有新节点放进一列，
+// 分给多个线程用 evaluateColumn 求值。a > b 时结果取负。
+// 只支持有限的积分限；job 被取消时返回 NaN
+IntegralResult integrate(const Program& f, double a, double b, const IntegrateOptions& options = IntegrateOptions(),
+                         JobContext* job = nullptr);
+
+struct SolveOptions {
+    double tolerance = 1e-15;   // 相对于 max(1, |x|) 的步长容差
+    int maxIterations = 100;    // 牛顿迭代和 Brent 迭代各自的上限
+    int maxBracketSteps = 60;   // 从 x0 向两侧倍增寻找变号区间的次数上限
+};
+
+struct SolveResult {
+    double root = 0.0;
+    double residual = 0.0;   // f(root)
+    int iterations = 0;      // 函数求值次数
+    bool converged = false;
+};
+
+// 求 f(x) = 0 在 x0 附近的根。先做带阻尼的牛顿迭代，导数由前向自动微分给出；
+// 导数为 0 或迭代停滞时改用 Brent 法：已经遇到变号就在该区间内求解，
+// 否则从 x0 向两侧倍增步长寻找变号区间
+SolveResult solve(const Program& f, double x0, const SolveOptions& options = SolveOptions(), JobContext* job = nullptr);
+
+} // namespace calc
+
+#endif // CALC_NUMERIC_H
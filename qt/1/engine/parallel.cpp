@@ -0,0 +1,132 @@
+#include "parallel.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace calc {
+
+namespace {
+
+// 常驻的辅助线程，按先后顺序执行投递的任务。进程退出时丢弃未开始的任务并等待线程结束
+class HelperPool
+{
+public:
+    HelperPool()
+    {
+        const unsigned hardware = std::thread::hardware_concurrency();
+        const unsigned threads = hardware > 1 ? hardware - 1 : 1;
+        workers.reserve(threads);
+        for (unsigned i = 0; i < threads; ++i) {
+            workers.emplace_back(&HelperPool::workerLoop, this);
+        }
+    }
+
+    ~HelperPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            queue.clear();
+        }
+        ready.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    std::size_t size() const { return workers.size(); }
+
+    void post(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(std::move(task));
+        }
+        ready.notify_one();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::function<void()>> queue;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+
+    void workerLoop()
+    {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (stopping) {
+                    return;
+                }
+                task = std::move(queue.front());
+                queue.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+HelperPool& helperPool()
+{
+    static HelperPool pool;
+    return pool;
+}
+
+// 一次 runParallel 调用与它的辅助任务共享的状态。辅助任务可能在调用返回之后才开始，
+// 所以单独分配；调用返回前置 closed，之后开始的辅助任务不再访问 work
+struct Rendezvous {
+    std::mutex mutex;
+    std::condition_variable finished;
+    unsigned active = 0;
+    bool closed = false;
+};
+
+} // namespace
+
+std::size_t helperThreadCount()
+{
+    return helperPool().size();
+}
+
+void runParallel(std::size_t helpers, const std::function<void(unsigned)>& work)
+{
+    helpers = std::min(helpers, helperThreadCount());
+    if (helpers == 0) {
+        work(0);
+        return;
+    }
+
+    auto rendezvous = std::make_shared<Rendezvous>();
+    const std::function<void(unsigned)>* shared = &work;
+    for (std::size_t i = 0; i < helpers; ++i) {
+        const unsigned worker = static_cast<unsigned>(i + 1);
+        helperPool().post([rendezvous, shared, worker]() {
+            {
+                std::lock_guard<std::mutex> lock(rendezvous->mutex);
+                if (rendezvous->closed) {
+                    return;
+                }
+                ++rendezvous->active;
+            }
+            (*shared)(worker);
+            std::lock_guard<std::mutex> lock(rendezvous->mutex);
+            if (--rendezvous->active == 0) {
+                rendezvous->finished.notify_one();
+            }
+        });
+    }
+
+    work(0);
+    std::unique_lock<std::mutex> lock(rendezvous->mutex);
+    rendezvous->closed = true;
+    rendezvous->finished.wait(lock, [&] { return rendezvous->active == 0; });
+}
+
+} // namespace calc
@@ -0,0 +1,43 @@
+#ifndef CALC_PARALLEL_H
+#define CALC_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <thread>
+
+namespace calc {
+
+// threads 为 0 时使用全部硬件线程
+inline unsigned resolveThreadCount(unsigned threads)
+{
+    return threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+// 引擎共用的常驻辅助线程数（硬件线程数减一，至少一个），第一次并行时创建，之后一直复用
+std::size_t helperThreadCount();
+
+// 在调用线程（worker 为 0）和至多 helpers 个常驻辅助线程（worker 为 1, 2, ...）上同时执行 work，
+// 全部返回后才返回。辅助线程正忙时不等它们：迟到的辅助线程发现调用已结束就直接放弃，
+// 所以 work 必须能由调用线程独自做完全部工作
+void runParallel(std::size_t helpers, const std::function<void(unsigned)>& work);
+
+// 在调用线程和另外至多 threads - 1 个辅助线程上执行 body(0, worker) ... body(count - 1, worker)，
+// 各线程按原子计数领取下标。worker 为 0 的就是调用线程，只有它可以访问 JobContext。
+// 辅助线程来自 runParallel 的常驻线程，平移图像时每帧重新采样也不会反复创建线程
+template <typename Body>
+void parallelFor(std::size_t count, unsigned threads, Body body)
+{
+    std::atomic<std::size_t> next{0};
+    const std::size_t extra = std::min<std::size_t>(std::max(threads, 1u), std::max<std::size_t>(count, 1)) - 1;
+    runParallel(extra, [&](unsigned worker) {
+        for (std::size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+            body(i, worker);
+        }
+    });
+}
+
+} // namespace calc
+
+#endif // CALC_PARALLEL_H
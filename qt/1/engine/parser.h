@@ -0,0 +1,365 @@
+#ifndef CALC_PARSER_H
+#define CALC_PARSER_H
+
+// 词法分析和调度场算法的单步实现，只在引擎内部使用：
+// Expression::compile 把输出收集成后缀指令，IncrementalEvaluator 把输出直接求值
+
+#include "expression.h"
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+namespace calc {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kE = 2.71828182845904523536;
+constexpr double kPiResidual = 1.2246467991473532e-16;  // π - kPi
+constexpr double kEResidual = 1.4456468917292502e-16;   // e - kE
+
+enum class TokenKind : std::uint8_t {
+    End,
+    Number,
+    Variable,
+    Operator,   // 二元或一元运算符，由语法状态决定
+    Postfix,    // ! 或 ²
+    Function,   // sin( ... ) 等
+    Prefix,     // √
+    LParen,
+    RParen,
+    Invalid
+};
+
+// 函数名到运算的对照表，Lexer 按名字查表，新增函数只需在这里加一行
+struct FunctionName {
+    std::string_view name;
+    OpCode op;
+};
+
+constexpr FunctionName kFunctionNames[] = {
+    { "sin", OpCode::Sin },
+    { "cos", OpCode::Cos },
+    { "tan", OpCode::Tan },
+    { "ln", OpCode::Ln },
+    { "log", OpCode::Log10 },
+    { "sqrt", OpCode::Sqrt },
+};
+
+struct Token {
+    TokenKind kind = TokenKind::End;
+    OpCode op = OpCode::PushConst;
+    double value = 0.0;
+    double residual = 0.0;  // 数字记号：精确值 - value
+    std::size_t pos = 0;
+};
+
+// 十进制字面量 [begin, end) 的精确值与 value 之差，以双双精度计算（约 1e-31 相对误差）。
+// 最多取 30 位有效数字，足以覆盖 double 的舍入误差
+double decimalResidual(const char* begin, const char* end, double value);
+
+// 超出 double 范围的十进制字面量 [begin, end) 是上溢（true）还是下溢（false）：
+// from_chars 对两者报同一个错误，这里按首位有效数字的十进制量级区分
+bool decimalOverflows(const char* begin, const char* end);
+
+// 不分配内存的词法分析器，直接在原始字节上滑动
+class Lexer
+{
+public:
+    explicit Lexer(std::string_view text, std::size_t start = 0) : src(text), cur(start) {}
+
+    // 下一个记号的起始扫描位置
+    std::size_t position() const { return cur; }
+
+    Token next()
+    {
+        while (cur < src.size() && (src[cur] == ' ' || src[cur] == '\t' || src[cur] == '\r' || src[cur] == '\n')) {
+            ++cur;
+        }
+
+        Token tok;
+        tok.pos = cur;
+        if (cur >= src.size()) {
+            return tok;
+        }
+
+        const char c = src[cur];
+        if ((c >= '0' && c <= '9') || c == '.') {
+            return number(tok);
+        }
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+            return identifier(tok);
+        }
+
+        ++cur;
+        switch (c) {
+        case '+': return make(tok, TokenKind::Operator, OpCode::Add);
+        case '-': return make(tok, TokenKind::Operator, OpCode::Sub);
+        case '*': return make(tok, TokenKind::Operator, OpCode::Mul);
+        case '/': return make(tok, TokenKind::Operator, OpCode::Div);
+        case '%': return make(tok, TokenKind::Operator, OpCode::Mod);
+        case '^': return make(tok, TokenKind::Operator, OpCode::Pow);
+        case '!': return make(tok, TokenKind::Postfix, OpCode::Factorial);
+        case '(': return make(tok, TokenKind::LParen, OpCode::PushConst);
+        case ')': return make(tok, TokenKind::RParen, OpCode::PushConst);
+        default:
+            break;
+        }
+
+        // 常见的 UTF-8 数学符号，便于直接粘贴公式
+        --cur;
+        if (match("\xC3\x97")) return make(tok, TokenKind::Operator, OpCode::Mul);      // ×
+        if (match("\xC3\xB7")) return make(tok, TokenKind::Operator, OpCode::Div);      // ÷
+        if (match("\xE2\x88\x92")) return make(tok, TokenKind::Operator, OpCode::Sub);  // −
+        if (match("\xC2\xB2")) return make(tok, TokenKind::Postfix, OpCode::Square);    // ²
+        if (match("\xE2\x88\x9A")) return make(tok, TokenKind::Prefix, OpCode::Sqrt);   // √
+        if (match("\xCF\x80")) {                                                        // π
+            tok.kind = TokenKind::Number;
+            tok.value = kPi;
+            tok.residual = kPiResidual;
+            return tok;
+        }
+
+        tok.kind = TokenKind::Invalid;
+        return tok;
+    }
+
+private:
+    std::string_view src;
+    std::size_t cur = 0;
+
+    Token make(Token tok, TokenKind kind, OpCode op)
+    {
+        tok.kind = kind;
+        tok.op = op;
+        return tok;
+    }
+
+    bool match(std::string_view symbol)
+    {
+        if (src.substr(cur, symbol.size()) == symbol) {
+            cur += symbol.size();
+            return true;
+        }
+        return false;
+    }
+
+    Token number(Token tok)
+    {
+        const char* begin = src.data() + cur;
+        const char* end = src.data() + src.size();
+        double value = 0.0;
+        auto [ptr, ec] = std::from_chars(begin, end, value);
+        if (ec == std::errc::result_out_of_range) {
+            // 上溢为 inf，下溢（如 1e-400）为 0；from_chars 出错时不写 value
+            value = decimalOverflows(begin, ptr) ? std::numeric_limits<double>::infinity() : 0.0;
+        }
+        else if (ec != std::errc()) {
+            tok.kind = TokenKind::Invalid;
+            ++cur;
+            return tok;
+        }
+        cur += static_cast<std::size_t>(ptr - begin);
+        tok.kind = TokenKind::Number;
+        tok.value = value;
+        tok.residual = decimalResidual(begin, ptr, value);
+        return tok;
+    }
+
+    Token identifier(Token tok)
+    {
+        const std::size_t start = cur;
+        while (cur < src.size() && ((src[cur] >= 'a' && src[cur] <= 'z') || (src[cur] >= 'A' && src[cur] <= 'Z'))) {
+            ++cur;
+        }
+        const std::string_view name = src.substr(start, cur - start);
+
+        if (name == "pi" || name == "PI") {
+            tok.kind = TokenKind::Number;
+            tok.value = kPi;
+            tok.residual = kPiResidual;
+            return tok;
+        }
+        if (name == "e") {
+            tok.kind = TokenKind::Number;
+            tok.value = kE;
+            tok.residual = kEResidual;
+            return tok;
+        }
+        if (name == "x" || name == "X") return make(tok, TokenKind::Variable, OpCode::PushVar);
+        for (const FunctionName& function : kFunctionNames) {
+            if (name == function.name) {
+                return make(tok, TokenKind::Function, function.op);
+            }
+        }
+
+        tok.kind = TokenKind::Invalid;
+        return tok;
+    }
+};
+
+// 运算符栈中的元素
+enum class StackKind : std::uint8_t { Operator, Function, Paren };
+
+struct StackEntry {
+    StackKind kind;
+    OpCode op;
+    std::size_t pos;
+};
+
+inline int precedenceOf(OpCode op)
+{
+    switch (op) {
+    case OpCode::Add:
+    case OpCode::Sub:
+        return 1;
+    case OpCode::Mul:
+    case OpCode::Div:
+    case OpCode::Mod:
+        return 2;
+    case OpCode::Neg:
+        return 3;
+    case OpCode::Pow:
+        return 4;
+    case OpCode::Sqrt:  // 前缀 √
+        return 5;
+    default:
+        return 0;
+    }
+}
+
+inline bool isRightAssociative(OpCode op)
+{
+    return op == OpCode::Pow || op == OpCode::Neg || op == OpCode::Sqrt;
+}
+
+// 调度场算法在两个记号之间的全部状态，可以拷贝下来从中途继续
+struct ParserState {
+    std::vector<StackEntry> stack;
+    bool expectOperand = true;
+    bool needParen = false;  // 函数名之后必须紧跟 '('
+};
+
+// 处理一个记号，产生的后缀指令依次交给 emit(OpCode op, double value, double residual)，
+// value 和 residual 只对 PushConst 有意义。出错时返回错误类型，位置为 tok.pos
+template <typename Emit>
+ParseError parseToken(ParserState& state, const Token& tok, std::string_view text, Emit&& emit)
+{
+    std::vector<StackEntry>& stack = state.stack;
+    if (state.needParen && tok.kind != TokenKind::LParen) {
+        return ParseError::UnexpectedToken;
+    }
+
+    switch (tok.kind) {
+    case TokenKind::Number:
+        if (!state.expectOperand) {
+            return ParseError::UnexpectedToken;
+        }
+        emit(OpCode::PushConst, tok.value, tok.residual);
+        state.expectOperand = false;
+        break;
+
+    case TokenKind::Variable:
+        if (!state.expectOperand) {
+            return ParseError::UnexpectedToken;
+        }
+        emit(OpCode::PushVar, 0.0, 0.0);
+        state.expectOperand = false;
+        break;
+
+    case TokenKind::Function:
+        if (!state.expectOperand) {
+            return ParseError::UnexpectedToken;
+        }
+        stack.push_back({ StackKind::Function, tok.op, tok.pos });
+        state.needParen = true;
+        break;
+
+    case TokenKind::Prefix:
+        if (!state.expectOperand) {
+            return ParseError::UnexpectedToken;
+        }
+        stack.push_back({ StackKind::Operator, tok.op, tok.pos });
+        break;
+
+    case TokenKind::Postfix:
+        // 后缀运算符优先级最高，直接作用于刚输出的操作数
+        if (state.expectOperand) {
+            return ParseError::UnexpectedToken;
+        }
+        emit(tok.op, 0.0, 0.0);
+        break;
+
+    case TokenKind::Operator: {
+        if (state.expectOperand) {
+            // 处于期待操作数的位置时 + / - 是一元运算符
+            if (tok.op == OpCode::Sub) {
+                stack.push_back({ StackKind::Operator, OpCode::Neg, tok.pos });
+                break;
+            }
+            if (tok.op == OpCode::Add) {
+                break;
+            }
+            return ParseError::UnexpectedToken;
+        }
+
+        const int prec = precedenceOf(tok.op);
+        const bool rightAssoc = isRightAssociative(tok.op);
+        while (!stack.empty() && stack.back().kind == StackKind::Operator) {
+            const int top = precedenceOf(stack.back().op);
+            if (top > prec || (top == prec && !rightAssoc)) {
+                emit(stack.back().op, 0.0, 0.0);
+                stack.pop_back();
+            }
+            else {
+                break;
+            }
+        }
+        stack.push_back({ StackKind::Operator, tok.op, tok.pos });
+        state.expectOperand = true;
+        break;
+    }
+
+    case TokenKind::LParen:
+        if (!state.expectOperand) {
+            return ParseError::UnexpectedToken;
+        }
+        stack.push_back({ StackKind::Paren, OpCode::PushConst, tok.pos });
+        state.needParen = false;
+        break;
+
+    case TokenKind::RParen:
+        if (state.expectOperand) {
+            return ParseError::UnexpectedToken;
+        }
+        while (!stack.empty() && stack.back().kind == StackKind::Operator) {
+            emit(stack.back().op, 0.0, 0.0);
+            stack.pop_back();
+        }
+        if (stack.empty()) {
+            return ParseError::UnbalancedParentheses;
+        }
+        stack.pop_back();
+        if (!stack.empty() && stack.back().kind == StackKind::Function) {
+            emit(stack.back().op, 0.0, 0.0);
+            stack.pop_back();
+        }
+        break;
+
+    case TokenKind::Invalid:
+        if ((text[tok.pos] >= 'a' && text[tok.pos] <= 'z') || (text[tok.pos] >= 'A' && text[tok.pos] <= 'Z')) {
+            return ParseError::UnknownIdentifier;
+        }
+        return ParseError::UnexpectedToken;
+
+    case TokenKind::End:
+        break;
+    }
+    return ParseError::None;
+}
+
+} // namespace calc
+
+#endif // CALC_PARSER_H
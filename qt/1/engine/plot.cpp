@@ -0,0 +1,388 @@
+#include "plot.h"
+#include "parallel.h"
+#include "vectoreval.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+namespace calc {
+
+namespace {
+
+constexpr std::size_t kChunksPerThread = 4;  // 块比线程多几倍，弯曲集中在少数块时负载也能摊开
+constexpr std::size_t kRangeProbes = 4096;
+constexpr double kRangeTrim = 0.01;
+constexpr double kOutlierRatio = 4.0;  // 完整范围超过截尾范围的这个倍数才算有离群值
+constexpr double kInfiniteScore = std::numeric_limits<double>::infinity();
+
+// 区间 (a, b) 以 m 为中点时需要继续细分的程度，0 表示已经足够平直。
+// 有限与非有限混在一起说明区间里有间断点或定义域边界，总是继续细分
+double bendScore(double ya, double ym, double yb, double scale)
+{
+    const bool finiteA = std::isfinite(ya);
+    const bool finiteM = std::isfinite(ym);
+    const bool finiteB = std::isfinite(yb);
+    if (!finiteA || !finiteM || !finiteB) {
+        return finiteA == finiteM && finiteM == finiteB ? 0.0 : kInfiniteScore;
+    }
+    const double deviation = std::fabs(ym - 0.5 * (ya + yb)) / scale;
+    return deviation > 1.0 ? deviation : 0.0;
+}
+
+// 一个块的点列。depth[i]、score[i] 属于区间 (xs[i], xs[i + 1])，score 为 0 的区间不再细分
+struct Chunk {
+    std::vector<double> xs;
+    std::vector<double> ys;
+    std::vector<int> depth;
+    std::vector<double> score;
+};
+
+// 按层二分块内弯曲的区间：一层的全部中点先收集起来用 evaluateColumn 一次求完，
+// 再根据每个中点判断两个子区间是否还要细分
+void refineChunk(const Program& program, Chunk& chunk, std::size_t budget, int maxDepth, double scale,
+                 const std::atomic<bool>& cancelled)
+{
+    std::vector<std::size_t> pending;
+    std::vector<double> mx;
+    std::vector<double> my;
+    Chunk next;
+    while (budget > 0 && !cancelled.load(std::memory_order_relaxed)) {
+        pending.clear();
+        for (std::size_t i = 0; i < chunk.score.size(); ++i) {
+            if (chunk.score[i] > 0.0 && chunk.depth[i] < maxDepth) {
+                pending.push_back(i);
+            }
+        }
+        if (pending.empty()) {
+            break;
+        }
+        // 预算不够时先细分最弯的区间
+        if (pending.size() > budget) {
+            std::nth_element(pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(budget), pending.end(),
+                             [&](std::size_t a, std::size_t b) { return chunk.score[a] > chunk.score[b]; });
+            pending.resize(budget);
+            std::sort(pending.begin(), pending.end());
+        }
+
+        mx.clear();
+        for (const std::size_t i : pending) {
+            mx.push_back(0.5 * (chunk.xs[i] + chunk.xs[i + 1]));
+        }
+        my.resize(mx.size());
+        evaluateColumn(program, mx.data(), my.data(), mx.size());
+
+        next.xs.clear();
+        next.ys.clear();
+        next.depth.clear();
+        next.score.clear();
+        std::size_t p = 0;
+        for (std::size_t i = 0; i < chunk.score.size(); ++i) {
+            next.xs.push_back(chunk.xs[i]);
+            next.ys.push_back(chunk.ys[i]);
+            if (p < pending.size() && pending[p] == i) {
+                const double x = mx[p];
+                const double y = my[p];
+                ++p;
+                // 区间已经小到中点无法表示，不再插点
+                if (x <= chunk.xs[i] || x >= chunk.xs[i + 1]) {
+                    next.depth.push_back(maxDepth);
+                    next.score.push_back(0.0);
+                    continue;
+                }
+                // 弯曲时两半都继续细分；有限性的交界只落在其中一半，另一半不必再管
+                const double s = bendScore(chunk.ys[i], y, chunk.ys[i + 1], scale);
+                const bool finiteA = std::isfinite(chunk.ys[i]);
+                const bool finiteM = std::isfinite(y);
+                const bool finiteB = std::isfinite(chunk.ys[i + 1]);
+                const bool boundary = finiteA != finiteM || finiteM != finiteB;
+                next.depth.push_back(chunk.depth[i] + 1);
+                next.score.push_back(boundary && finiteA == finiteM ? 0.0 : s);
+                next.xs.push_back(x);
+                next.ys.push_back(y);
+                next.depth.push_back(chunk.depth[i] + 1);
+                next.score.push_back(boundary && finiteM == finiteB ? 0.0 : s);
+                --budget;
+            }
+            else {
+                next.depth.push_back(chunk.depth[i]);
+                // 这一层没轮到的区间保留原分数，下一层再比较
+                next.score.push_back(chunk.score[i]);
+            }
+        }
+        next.xs.push_back(chunk.xs.back());
+        next.ys.push_back(chunk.ys.back());
+        std::swap(chunk, next);
+    }
+}
+
+// 求 ys[begin, end) 中最小值和最大值第一次出现的下标。先只比较数值，
+// 这一遍没有分支，编译器可以向量化；再在列内找回下标。
+// 区间里有 inf 或 NaN 时返回 true，low/high 不可用
+bool columnExtremes(const double* ys, std::size_t begin, std::size_t end, std::size_t& low, std::size_t& high)
+{
+    // 四组累加器错开依赖链
+    double lowest[4] = {ys[begin], ys[begin], ys[begin], ys[begin]};
+    double highest[4] = {ys[begin], ys[begin], ys[begin], ys[begin]};
+    double poison[4] = {0.0, 0.0, 0.0, 0.0};  // y - y 对有限值为 0，对 inf/NaN 为 NaN
+    std::size_t k = begin;
+    for (; k + 4 <= end; k += 4) {
+        for (int lane = 0; lane < 4; ++lane) {
+            const double y = ys[k + lane];
+            lowest[lane] = y < lowest[lane] ? y : lowest[lane];
+            highest[lane] = y > highest[lane] ? y : highest[lane];
+            poison[lane] += y - y;
+        }
+    }
+    for (; k < end; ++k) {
+        const double y = ys[k];
+        lowest[0] = y < lowest[0] ? y : lowest[0];
+        highest[0] = y > highest[0] ? y : highest[0];
+        poison[0] += y - y;
+    }
+    if (poison[0] + poison[1] + poison[2] + poison[3] != 0.0) {
+        return true;
+    }
+    const double minimum = std::min({lowest[0], lowest[1], lowest[2], lowest[3]});
+    const double maximum = std::max({highest[0], highest[1], highest[2], highest[3]});
+    low = begin;
+    while (ys[low] != minimum) {
+        ++low;
+    }
+    high = begin;
+    while (ys[high] != maximum) {
+        ++high;
+    }
+    return false;
+}
+
+} // namespace
+
+PlotSamples samplePlot(const Program& program, double xMin, double xMax, const PlotOptions& options, JobContext* job)
+{
+    PlotSamples samples;
+    if (!program.isValid() || !std::isfinite(xMin) || !std::isfinite(xMax) || !(xMin < xMax)) {
+        return samples;
+    }
+    const std::size_t intervals = std::max<std::size_t>(options.initialSamples, 2);
+    const unsigned threads = resolveThreadCount(options.threads);
+    const std::size_t chunkCount = std::min<std::size_t>(intervals, threads * kChunksPerThread);
+
+    std::atomic<bool> cancelled{false};
+    std::atomic<std::size_t> finished{0};
+    // 只有调用线程检查取消和报告进度，其余线程看 cancelled
+    auto poll = [&](unsigned worker, double total) {
+        if (worker != 0 || !job) {
+            return;
+        }
+        if (job->isCancelled()) {
+            cancelled.store(true, std::memory_order_relaxed);
+        }
+        job->reportProgress(finished.load(std::memory_order_relaxed) / total);
+    };
+    auto chunkBegin = [&](std::size_t chunk) { return intervals * chunk / chunkCount; };
+
+    // 第一遍：均匀网格，最后一个点正好落在 xMax
+    std::vector<double> gridX(intervals + 1);
+    std::vector<double> gridY(intervals + 1);
+    const double width = xMax - xMin;
+    for (std::size_t i = 0; i < intervals; ++i) {
+        gridX[i] = xMin + width * (static_cast<double>(i) / static_cast<double>(intervals));
+    }
+    gridX[intervals] = xMax;
+    parallelFor(chunkCount, threads, [&](std::size_t chunk, unsigned worker) {
+        const std::size_t begin = chunkBegin(chunk);
+        const std::size_t end = chunk + 1 == chunkCount ? intervals + 1 : chunkBegin(chunk + 1);
+        if (!cancelled.load(std::memory_order_relaxed)) {
+            evaluateColumn(program, gridX.data() + begin, gridY.data() + begin, end - begin);
+        }
+        ++finished;
+        poll(worker, 2.0 * chunkCount);
+    });
+    if (cancelled.load()) {
+        return samples;
+    }
+
+    // 弯曲程度相对于曲线的纵向范围来衡量，与函数值的量级无关
+    samples.xs = gridX;
+    samples.ys = gridY;
+    double yMin = 0.0;
+    double yMax = 0.0;
+    double scale = 1.0;
+    if (plotValueRange(samples, xMin, xMax, yMin, yMax)) {
+        scale = (yMax - yMin) * options.tolerance;
+    }
+    if (!(scale > 0.0) || !std::isfinite(scale)) {
+        scale = options.tolerance;
+    }
+
+    // 第二遍：各块独立细分，预算按块内区间数分配
+    const std::size_t budget = options.maxSamples > intervals + 1 ? options.maxSamples - intervals - 1 : 0;
+    std::vector<Chunk> chunks(chunkCount);
+    parallelFor(chunkCount, threads, [&](std::size_t index, unsigned worker) {
+        const std::size_t begin = chunkBegin(index);
+        const std::size_t end = index + 1 == chunkCount ? intervals : chunkBegin(index + 1);
+        Chunk& chunk = chunks[index];
+        chunk.xs.assign(gridX.begin() + static_cast<std::ptrdiff_t>(begin),
+                        gridX.begin() + static_cast<std::ptrdiff_t>(end) + 1);
+        chunk.ys.assign(gridY.begin() + static_cast<std::ptrdiff_t>(begin),
+                        gridY.begin() + static_cast<std::ptrdiff_t>(end) + 1);
+        chunk.depth.assign(end - begin, 0);
+        chunk.score.assign(end - begin, 0.0);
+        // 网格上的弯曲用相邻三点估计，点 i 弯曲时它两侧的区间都要细分
+        for (std::size_t i = std::max<std::size_t>(begin, 1); i <= end && i < intervals; ++i) {
+            const double s = bendScore(gridY[i - 1], gridY[i], gridY[i + 1], scale);
+            if (i > begin) {
+                chunk.score[i - 1 - begin] = std::max(chunk.score[i - 1 - begin], s);
+            }
+            if (i < end) {
+                chunk.score[i - begin] = std::max(chunk.score[i - begin], s);
+            }
+        }
+        refineChunk(program, chunk, budget * (end - begin) / intervals, options.maxDepth, scale, cancelled);
+        ++finished;
+        poll(worker, 2.0 * chunkCount);
+    });
+    if (cancelled.load()) {
+        return PlotSamples();
+    }
+
+    // 相邻块共用端点，拼接时去掉后一块的第一个点
+    std::size_t total = 1;
+    for (const Chunk& chunk : chunks) {
+        total += chunk.xs.size() - 1;
+    }
+    samples.xs.clear();
+    samples.ys.clear();
+    samples.xs.reserve(total);
+    samples.ys.reserve(total);
+    for (std::size_t i = 0; i < chunks.size(); ++i) {
+        const std::ptrdiff_t skip = i == 0 ? 0 : 1;
+        samples.xs.insert(samples.xs.end(), chunks[i].xs.begin() + skip, chunks[i].xs.end());
+        samples.ys.insert(samples.ys.end(), chunks[i].ys.begin() + skip, chunks[i].ys.end());
+    }
+    return samples;
+}
+
+bool plotValueRange(const PlotSamples& samples, double xMin, double xMax, double& yMin, double& yMax)
+{
+    if (samples.empty() || !(xMin <= xMax)) {
+        return false;
+    }
+    // 自适应采样把点集中在陡峭处，直接按点数截尾会偏向渐近线附近的大值，
+    // 因此先按 x 均匀抽取探测点，再在探测点上截尾
+    std::vector<double> values;
+    const double x0 = std::max(xMin, samples.xs.front());
+    const double span = std::min(xMax, samples.xs.back()) - x0;
+    if (!(span >= 0.0)) {
+        return false;
+    }
+    const std::size_t probes = std::min(samples.size(), kRangeProbes);
+    values.reserve(probes);
+    for (std::size_t k = 0; k < probes; ++k) {
+        const double x = probes > 1 ? x0 + span * (static_cast<double>(k) / static_cast<double>(probes - 1)) : x0;
+        const auto it = std::lower_bound(samples.xs.begin(), samples.xs.end(), x);
+        const std::size_t index = std::min<std::size_t>(it - samples.xs.begin(), samples.size() - 1);
+        if (std::isfinite(samples.ys[index])) {
+            values.push_back(samples.ys[index]);
+        }
+    }
+    if (values.empty()) {
+        return false;
+    }
+    const auto [lowest, highest] = std::minmax_element(values.begin(), values.end());
+    yMin = *lowest;
+    yMax = *highest;
+    // 只有两端确实有离群值时才截尾，光滑曲线保留完整的范围
+    if (values.size() >= 100) {
+        const std::size_t trim = static_cast<std::size_t>(values.size() * kRangeTrim);
+        const std::size_t top = values.size() - 1 - trim;
+        std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(trim), values.end());
+        const double trimmedMin = values[trim];
+        std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(top), values.end());
+        const double trimmedMax = values[top];
+        if (yMax - yMin > kOutlierRatio * (trimmedMax - trimmedMin)) {
+            yMin = trimmedMin;
+            yMax = trimmedMax;
+        }
+    }
+    // 常数函数也给出一个非空范围
+    if (yMin == yMax) {
+        const double pad = yMin == 0.0 ? 1.0 : std::fabs(yMin) * 0.5;
+        yMin -= pad;
+        yMax += pad;
+    }
+    return true;
+}
+
+void decimatePlot(const PlotSamples& samples, const PlotViewport& view, std::vector<PlotPoint>& out)
+{
+    out.clear();
+    if (samples.empty() || view.width <= 0 || view.height <= 0 || !(view.xMin < view.xMax) ||
+        !(view.yMin < view.yMax)) {
+        return;
+    }
+    const double sx = view.width / (view.xMax - view.xMin);
+    const double sy = view.height / (view.yMax - view.yMin);
+    // 屏幕外的坐标收在几倍窗口以内，避免 QPainter 处理极大的整数坐标；
+    // 截断只改变窗口外那一段的斜率，可见部分的偏差不到一个像素
+    const double xLow = -view.width;
+    const double xHigh = 2.0 * view.width;
+    const double yLow = -view.height;
+    const double yHigh = 2.0 * view.height;
+    const double breakValue = std::numeric_limits<double>::quiet_NaN();
+
+    // 可见范围两侧各多取一个点，让曲线一直画到窗口边缘
+    const auto& xs = samples.xs;
+    const auto& ys = samples.ys;
+    std::size_t first = std::lower_bound(xs.begin(), xs.end(), view.xMin) - xs.begin();
+    std::size_t last = std::upper_bound(xs.begin(), xs.end(), view.xMax) - xs.begin();
+    first = first > 0 ? first - 1 : 0;
+    last = std::min(last + 1, xs.size());
+
+    auto toScreen = [&](std::size_t i) {
+        return PlotPoint{std::clamp((xs[i] - view.xMin) * sx, xLow, xHigh),
+                         std::clamp((view.yMax - ys[i]) * sy, yLow, yHigh)};
+    };
+
+    std::size_t i = first;
+    while (i < last) {
+        if (!std::isfinite(ys[i])) {
+            if (!out.empty() && !std::isnan(out.back().x)) {
+                out.push_back(PlotPoint{breakValue, breakValue});
+            }
+            ++i;
+            continue;
+        }
+        // 二分找出与 xs[i] 同一像素列的样本，列内只比较 y，循环里没有坐标换算
+        const double columnEnd = view.xMin + (std::floor(toScreen(i).x) + 1.0) / sx;
+        const std::size_t end = std::lower_bound(xs.begin() + static_cast<std::ptrdiff_t>(i) + 1,
+                                                 xs.begin() + static_cast<std::ptrdiff_t>(last), columnEnd) -
+                                xs.begin();
+        std::size_t k = end;
+        std::size_t low = i;
+        std::size_t high = i;
+        if (columnExtremes(ys.data(), i, end, low, high)) {
+            // 列里有非有限值：只处理到它之前，它本身在下一轮断开折线
+            k = i + 1;
+            while (std::isfinite(ys[k])) {
+                ++k;
+            }
+            columnExtremes(ys.data(), i, k, low, high);
+        }
+        // 按下标顺序输出进入、最小、最大、离开四个点，相同的点只输出一次
+        const std::size_t picks[4] = {i, std::min(low, high), std::max(low, high), k - 1};
+        for (std::size_t p = 0; p < 4; ++p) {
+            if (p == 0 || picks[p] != picks[p - 1]) {
+                out.push_back(toScreen(picks[p]));
+            }
+        }
+        i = k;
+    }
+    if (!out.empty() && std::isnan(out.back().x)) {
+        out.pop_back();
+    }
+}
+
+} // namespace calc
@@ -0,0 +1,63 @@
+#ifndef CALC_PLOT_H
+#define CALC_PLOT_H
+
+#include "evalservice.h"
+#include "program.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace calc {
+
+// 函数图像的采样点，xs 严格递增，ys 可以含 inf/NaN（在那里断开曲线）
+struct PlotSamples {
+    std::vector<double> xs;
+    std::vector<double> ys;
+
+    std::size_t size() const { return xs.size(); }
+    bool empty() const { return xs.empty(); }
+};
+
+struct PlotOptions {
+    std::size_t initialSamples = 2048;  // 均匀初始网格的区间数
+    std::size_t maxSamples = 1 << 21;   // 细分后的总点数上限
+    int maxDepth = 12;                  // 每个初始区间最多再二分的层数
+    double tolerance = 1e-3;            // 中点偏离两端连线超过 y 范围的这个比例就继续二分
+    unsigned threads = 0;               // 0 表示使用全部硬件线程
+};
+
+// 在 [xMin, xMax] 上对 program 自适应采样：先取均匀网格，再反复二分弯曲大的区间
+// （中点偏离两端连线较远）和有限/非有限交界的区间（间断点、渐近线、定义域边界）。
+// 区间按块分给多个线程，各块按层细分，每层的全部中点用 evaluateColumn 一次求完。
+// job 被取消时尽快返回空结果
+PlotSamples samplePlot(const Program& program, double xMin, double xMax, const PlotOptions& options = PlotOptions(),
+                       JobContext* job = nullptr);
+
+// [xMin, xMax] 内有限样本值的稳健范围：两端有离群值时各截去 1%，渐近线附近的极大值
+// 不会把曲线压扁。没有有限值时返回 false
+bool plotValueRange(const PlotSamples& samples, double xMin, double xMax, double& yMin, double& yMax);
+
+// 屏幕上的绘图区：[xMin, xMax] 映射到 [0, width) 像素，[yMin, yMax] 映射到 [height, 0)（y 向下）
+struct PlotViewport {
+    double xMin = -10.0;
+    double xMax = 10.0;
+    double yMin = -10.0;
+    double yMax = 10.0;
+    int width = 0;
+    int height = 0;
+};
+
+// 屏幕坐标中的折线顶点，x 为 NaN 的点表示折线在此断开
+struct PlotPoint {
+    double x;
+    double y;
+};
+
+// min/max 抽稀：按像素列把可见样本分组，每列只保留进入、最小、最大、离开四个点，
+// 画出的折线与逐点连线经过相同的像素。输出点数只取决于 width，与样本数无关，
+// 千万个点的曲线也能每帧重新抽稀。out 会被清空后写入，调用方可以反复使用同一块内存
+void decimatePlot(const PlotSamples& samples, const PlotViewport& view, std::vector<PlotPoint>& out);
+
+} // namespace calc
+
+#endif // CALC_PLOT_H
@@ -0,0 +1,468 @@
+#include "precise.h"
+#include "doubledouble.h"
+#include "resultcache.h"
+#include "trig.h"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace calc {
+
+namespace {
+
+constexpr double kUnit = 0x1p-53;         // double 的单位舍入误差
+constexpr double kDDUnit = 0x1p-104;      // 双双精度的单位舍入误差
+constexpr double kLibmError = 2 * kUnit;  // libm 超越函数按 1ulp 估计
+constexpr double kTrigError = 8 * kUnit;  // trig.h 的多项式核按 4ulp 估计（tan 是两个核相除）
+constexpr double kStable = 0x1p-49;       // 相对误差界在几个 ulp 以内即视为稳定
+constexpr double kLiteralPrecision = 1e-29;  // 十进制字面量最多保留 30 位有效数字
+constexpr double kLn10 = 2.302585092994045684;
+constexpr double kInf = std::numeric_limits<double>::infinity();
+constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+
+// π / 180 的双双精度值
+const DoubleDouble kDegree(0.017453292519943295, 2.9486522708701687e-19);
+
+// 值与其绝对误差界
+struct Bounded {
+    double value;
+    double error;
+};
+
+struct PreciseBounded {
+    DoubleDouble value;
+    double error;
+};
+
+bool isStable(double value, double error)
+{
+    return error <= std::fabs(value) * kStable;
+}
+
+bool isInteger(double value)
+{
+    return std::isfinite(value) && value == std::floor(value);
+}
+
+// 三角函数在规约后的角上对弧度的导数，供误差传播使用
+double derivative(OpCode op, const ReducedAngle& angle)
+{
+    switch (op) {
+    case OpCode::Sin:
+        return trigOfReduced(OpCode::Cos, angle);
+    case OpCode::Cos:
+        return -trigOfReduced(OpCode::Sin, angle);
+    case OpCode::Tan: {
+        const double c = trigOfReduced(OpCode::Cos, angle);
+        return 1.0 / (c * c);
+    }
+    default:
+        return 0.0;
+    }
+}
+
+// 在误差范围内 cos 可能为 0 时 tan 无定义
+bool tanUndefined(const ReducedAngle& angle, double angleError)
+{
+    return std::fabs(trigOfReduced(OpCode::Cos, angle)) <= angleError + kTrigError;
+}
+
+// ---- 第一遍：double 求值并累计误差界 ----
+
+Bounded unaryDouble(OpCode op, Bounded a, const EvalOptions& options)
+{
+    const double x = a.value;
+    switch (op) {
+    case OpCode::Neg:
+        return { -x, a.error };
+    case OpCode::Square: {
+        const DoubleDouble p = twoProd(x, x);
+        return { p.hi, 2 * std::fabs(x) * a.error + a.error * a.error + std::fabs(p.lo) };
+    }
+    case OpCode::Sqrt: {
+        if (x < 0) {
+            return { kNaN, kInf };
+        }
+        const double r = std::sqrt(x);
+        if (r == 0) {
+            return { 0.0, std::sqrt(a.error) };
+        }
+        const DoubleDouble p = twoProd(r, r);
+        const double rounding = std::fabs((x - p.hi) - p.lo) / (2 * r);
+        return { r, a.error / (2 * r) + rounding };
+    }
+    case OpCode::Ln:
+    case OpCode::Log10: {
+        if (x <= 0) {
+            return { kNaN, kInf };
+        }
+        if (a.error >= x) {
+            return { applyUnary(op, x, options), kInf };
+        }
+        const double r = applyUnary(op, x, options);
+        const double scale = op == OpCode::Ln ? 1.0 : 1.0 / kLn10;
+        return { r, scale * a.error / (x - a.error) + std::fabs(r) * kLibmError };
+    }
+    case OpCode::Sin:
+    case OpCode::Cos:
+    case OpCode::Tan: {
+        // 规约本身几乎没有误差（角度制完全精确），角的误差只来自操作数
+        const ReducedAngle angle = options.angleInDegrees ? reduceDegrees(x) : reduceRadians(x);
+        const double angleError = options.angleInDegrees ? a.error * kDegree.hi : a.error;
+        if (op == OpCode::Tan && tanUndefined(angle, angleError)) {
+            return { kNaN, kInf };
+        }
+        // 角度制的特殊角与 applyUnary 一样直接取精确值
+        const double r = options.angleInDegrees ? applyUnary(op, x, options) : trigOfReduced(op, angle);
+        return { r, std::fabs(derivative(op, angle)) * angleError + std::fabs(r) * kTrigError };
+    }
+    case OpCode::Factorial: {
+        const double r = applyUnary(op, x, options);
+        return { r, a.error > 0 ? kInf : std::fabs(r) * x * kUnit };
+    }
+    default:
+        return { kNaN, kInf };
+    }
+}
+
+Bounded binaryDouble(OpCode op, Bounded a, Bounded b)
+{
+    const double x = a.value;
+    const double y = b.value;
+    switch (op) {
+    case OpCode::Add:
+    case OpCode::Sub: {
+        const DoubleDouble s = twoSum(x, op == OpCode::Add ? y : -y);
+        return { s.hi, a.error + b.error + std::fabs(s.lo) };
+    }
+    case OpCode::Mul: {
+        const DoubleDouble p = twoProd(x, y);
+        return { p.hi, std::fabs(x) * b.error + std::fabs(y) * a.error + a.error * b.error + std::fabs(p.lo) };
+    }
+    case OpCode::Div: {
+        if (isZeroDivisor(y)) {
+            return { kInf, 0.0 };
+        }
+        const double q = x / y;
+        if (b.error >= std::fabs(y)) {
+            return { q, kInf };
+        }
+        const DoubleDouble p = twoProd(q, y);
+        const double rounding = std::fabs(((x - p.hi) - p.lo) / y);
+        return { q, (a.error + std::fabs(q) * b.error) / (std::fabs(y) - b.error) + rounding };
+    }
+    case OpCode::Mod: {
+        if (isZeroDivisor(y)) {
+            return { kInf, 0.0 };
+        }
+        // fmod 本身是精确的，误差只来自操作数
+        const double r = std::fmod(x, y);
+        const double quotient = std::trunc(x / y);
+        return { r, a.error + std::fabs(quotient) * b.error };
+    }
+    case OpCode::Pow: {
+        const double r = std::pow(x, y);
+        double error = std::fabs(r) * kLibmError;
+        if (a.error > 0) {
+            error += x != 0 ? std::fabs(r * y / x) * a.error : kInf;
+        }
+        if (b.error > 0) {
+            error += x > 0 ? std::fabs(r * std::log(x)) * b.error : kInf;
+        }
+        // 小整数次幂的整数底数结果精确
+        if (a.error == 0 && b.error == 0 && isInteger(x) && isInteger(y) && y >= 0 && std::fabs(r) < 0x1p53) {
+            error = 0;
+        }
+        return { r, error };
+    }
+    default:
+        return { kNaN, kInf };
+    }
+}
+
+// ---- 第二遍：双双精度重算 ----
+
+PreciseBounded unaryPrecise(OpCode op, const PreciseBounded& a, const EvalOptions& options)
+{
+    const DoubleDouble& x = a.value;
+    switch (op) {
+    case OpCode::Neg:
+        return { -x, a.error };
+    case OpCode::Square: {
+        const DoubleDouble r = x * x;
+        return { r, 2 * std::fabs(x.hi) * a.error + a.error * a.error + std::fabs(r.hi) * 8 * kDDUnit };
+    }
+    case OpCode::Sqrt: {
+        if (x.hi < 0) {
+            return { DoubleDouble(kNaN), kInf };
+        }
+        const DoubleDouble r = sqrt(x);
+        if (r.hi == 0) {
+            return { r, std::sqrt(a.error) };
+        }
+        return { r, a.error / (2 * r.hi) + std::fabs(r.hi) * 8 * kDDUnit };
+    }
+    case OpCode::Ln:
+    case OpCode::Log10: {
+        if (x.hi <= 0) {
+            return { DoubleDouble(kNaN), kInf };
+        }
+        const double scale = op == OpCode::Ln ? 1.0 : 1.0 / kLn10;
+        const double r = applyUnary(op, x.hi, options);
+        const DoubleDouble value = quickTwoSum(r, scale * x.lo / x.hi);
+        const double error = a.error >= x.hi ? kInf : scale * a.error / (x.hi - a.error);
+        return { value, error + std::fabs(r) * kLibmError };
+    }
+    case OpCode::Sin:
+    case OpCode::Cos:
+    case OpCode::Tan: {
+        // x 的低位并入规约后的角，多项式核会用到它；精度受限于核本身
+        ReducedAngle angle;
+        double angleError = a.error;
+        if (options.angleInDegrees) {
+            angle = reduceDegrees(x.hi, x.lo);
+            angleError = a.error * kDegree.hi + std::fabs(angle.hi) * 8 * kDDUnit;
+        }
+        else {
+            angle = reduceRadians(x.hi, x.lo);
+        }
+        if (op == OpCode::Tan && tanUndefined(angle, angleError)) {
+            return { DoubleDouble(kNaN), kInf };
+        }
+        const double r = options.angleInDegrees && x.lo == 0 ? applyUnary(op, x.hi, options) : trigOfReduced(op, angle);
+        return { DoubleDouble(r), std::fabs(derivative(op, angle)) * angleError + std::fabs(r) * kTrigError };
+    }
+    case OpCode::Factorial: {
+        const double r = applyUnary(op, x.toDouble(), options);
+        return { DoubleDouble(r), a.error > 0 ? kInf : std::fabs(r) * x.hi * kUnit };
+    }
+    default:
+        return { DoubleDouble(kNaN), kInf };
+    }
+}
+
+PreciseBounded binaryPrecise(OpCode op, const PreciseBounded& a, const PreciseBounded& b)
+{
+    const DoubleDouble& x = a.value;
+    const DoubleDouble& y = b.value;
+    switch (op) {
+    case OpCode::Add:
+    case OpCode::Sub: {
+        const DoubleDouble r = op == OpCode::Add ? x + y : x - y;
+        return { r, a.error + b.error + std::fabs(r.hi) * 4 * kDDUnit };
+    }
+    case OpCode::Mul: {
+        const DoubleDouble r = x * y;
+        return { r, std::fabs(x.hi) * b.error + std::fabs(y.hi) * a.error + a.error * b.error
+                        + std::fabs(r.hi) * 8 * kDDUnit };
+    }
+    case OpCode::Div: {
+        if (isZeroDivisor(y.hi) || b.error >= std::fabs(y.hi)) {
+            return { DoubleDouble(kInf), kInf };
+        }
+        const DoubleDouble r = x / y;
+        return { r, (a.error + std::fabs(r.hi) * b.error) / (std::fabs(y.hi) - b.error)
+                        + std::fabs(r.hi) * 8 * kDDUnit };
+    }
+    case OpCode::Mod: {
+        if (isZeroDivisor(y.hi)) {
+            return { DoubleDouble(kInf), kInf };
+        }
+        // a - b·trunc(a / b)，商的截断要看低位
+        const DoubleDouble q = x / y;
+        double n = std::trunc(q.hi);
+        if (n == q.hi) {
+            if (n > 0 && q.lo < 0) {
+                n -= 1;
+            }
+            else if (n < 0 && q.lo > 0) {
+                n += 1;
+            }
+        }
+        const DoubleDouble r = x - DoubleDouble(n) * y;
+        return { r, a.error + std::fabs(n) * b.error + std::fabs(x.hi) * 8 * kDDUnit };
+    }
+    case OpCode::Pow: {
+        // 整数次幂用双双精度的二进制幂，其余用一阶修正
+        if (b.error == 0 && y.lo == 0 && isInteger(y.hi) && std::fabs(y.hi) <= 1024) {
+            long n = static_cast<long>(std::fabs(y.hi));
+            DoubleDouble base = x;
+            DoubleDouble r(1.0);
+            for (; n > 0; n >>= 1) {
+                if (n & 1) {
+                    r = r * base;
+                }
+                base = base * base;
+            }
+            if (y.hi < 0) {
+                r = DoubleDouble(1.0) / r;
+            }
+            const double relative = x.hi != 0 ? std::fabs(y.hi) * a.error / std::fabs(x.hi) : (a.error > 0 ? kInf : 0);
+            return { r, std::fabs(r.hi) * (relative + std::fabs(y.hi) * 8 * kDDUnit) };
+        }
+        const double r = std::pow(x.hi, y.hi);
+        double correction = 0;
+        double error = std::fabs(r) * kLibmError;
+        if (x.hi != 0) {
+            correction += y.hi * x.lo / x.hi;
+            error += std::fabs(r * y.hi / x.hi) * a.error;
+        }
+        if (x.hi > 0) {
+            correction += std::log(x.hi) * y.lo;
+            error += std::fabs(r * std::log(x.hi)) * b.error;
+        }
+        else if (b.error > 0) {
+            error = kInf;
+        }
+        return { quickTwoSum(r, r * correction), error };
+    }
+    default:
+        return { DoubleDouble(kNaN), kInf };
+    }
+}
+
+} // namespace
+
+PreciseResult evaluatePrecise(const Expression& expression, const EvalOptions& options, ResultCache* cache)
+{
+    PreciseResult result;
+    if (!expression.isValid()) {
+        result.value = kNaN;
+        result.errorBound = kInf;
+        return result;
+    }
+
+    const std::vector<Instruction>& code = expression.code();
+    const std::size_t count = code.size();
+
+    // 每条指令的 double 结果都要留给第二遍复用；常见的短表达式不走堆分配
+    constexpr std::size_t kInlineNodes = 64;
+    Bounded inlineNodes[kInlineNodes];
+    std::size_t inlineStack[kInlineNodes];
+    std::vector<Bounded> heapNodes;
+    std::vector<std::size_t> heapStack;
+    Bounded* nodes = inlineNodes;
+    std::size_t* stack = inlineStack;
+    if (count > kInlineNodes) {
+        heapNodes.resize(count);
+        heapStack.resize(count);
+        nodes = heapNodes.data();
+        stack = heapStack.data();
+    }
+
+    thread_local SubexpressionKeys keys;  // 每个线程复用同一组缓冲区
+    CachedResult cached;
+    if (cache) {
+        keys.build(expression, options);
+        if (cache->find(keys.rootKey(), CacheDomain::PreciseResult, cached)) {
+            result.value = cached.value;
+            result.errorBound = cached.error;
+            return result;
+        }
+    }
+
+    std::size_t top = 0;  // 栈中元素个数
+    for (std::size_t i = 0; i < count; ++i) {
+        if (cache) {
+            // 从这里开始的子式由外向内查缓存，命中的子树整段跳过；
+            // 跳过的内部节点误差界记为无穷，需要第二遍时照常重算
+            std::size_t hit = SubexpressionKeys::kNone;
+            for (std::size_t j = keys.outermostAt(i); j != SubexpressionKeys::kNone; j = keys.nextInner(j)) {
+                if (j != count - 1 && keys.isCacheable(j)
+                    && cache->find(keys.key(j), CacheDomain::PreciseNode, cached)) {
+                    hit = j;
+                    break;
+                }
+            }
+            if (hit != SubexpressionKeys::kNone) {
+                for (; i < hit; ++i) {
+                    nodes[i] = { kNaN, kInf };
+                }
+                nodes[hit] = { cached.value, cached.error };
+                stack[top++] = hit;
+                continue;
+            }
+        }
+
+        const Instruction& ins = code[i];
+        if (ins.op == OpCode::PushConst) {
+            nodes[i] = { ins.value, std::fabs(expression.literalResidual(i)) };
+            stack[top++] = i;
+        }
+        else if (ins.op == OpCode::PushVar) {
+            nodes[i] = { options.x, 0.0 };
+            stack[top++] = i;
+        }
+        else if (isBinary(ins.op)) {
+            const std::size_t rhs = stack[--top];
+            nodes[i] = binaryDouble(ins.op, nodes[stack[top - 1]], nodes[rhs]);
+            stack[top - 1] = i;
+        }
+        else {
+            nodes[i] = unaryDouble(ins.op, nodes[stack[top - 1]], options);
+            stack[top - 1] = i;
+        }
+        if (cache && keys.isCacheable(i)) {
+            cache->insert(keys.key(i), CacheDomain::PreciseNode, { nodes[i].value, nodes[i].error });
+        }
+    }
+
+    const Bounded& root = nodes[count - 1];
+    result.value = root.value;
+    result.errorBound = root.error;
+    // 溢出、除零和定义域错误不需要更高精度
+    if (!std::isfinite(root.value) || isStable(root.value, root.error)) {
+        if (cache) {
+            cache->insert(keys.rootKey(), CacheDomain::PreciseResult, { result.value, result.errorBound });
+        }
+        return result;
+    }
+
+    // 误差界超过显示精度：误差非零的节点用双双精度重算，精确子式直接复用
+    std::vector<PreciseBounded> precise(count);
+    top = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        const Instruction& ins = code[i];
+        if (ins.op == OpCode::PushConst) {
+            const double residual = expression.literalResidual(i);
+            precise[i] = { DoubleDouble(ins.value, residual),
+                           residual != 0 ? std::fabs(ins.value) * kLiteralPrecision : 0.0 };
+            stack[top++] = i;
+            continue;
+        }
+        if (ins.op == OpCode::PushVar) {
+            precise[i] = { DoubleDouble(options.x), 0.0 };
+            stack[top++] = i;
+            continue;
+        }
+
+        const std::size_t rhs = isBinary(ins.op) ? stack[--top] : 0;
+        const std::size_t lhs = stack[top - 1];
+        if (nodes[i].error == 0) {
+            precise[i] = { DoubleDouble(nodes[i].value), 0.0 };
+        }
+        else if (isBinary(ins.op)) {
+            precise[i] = binaryPrecise(ins.op, precise[lhs], precise[rhs]);
+        }
+        else {
+            precise[i] = unaryPrecise(ins.op, precise[lhs], options);
+        }
+        stack[top - 1] = i;
+    }
+
+    const PreciseBounded& refined = precise[count - 1];
+    result.value = refined.value.toDouble();
+    result.errorBound = refined.error;
+    result.refined = true;
+    // 误差界覆盖了 0 时结果与 0 无法区分，按精确的 0 显示
+    if (std::fabs(result.value) <= result.errorBound && std::isfinite(result.errorBound)) {
+        result.value = 0.0;
+    }
+    if (cache) {
+        cache->insert(keys.rootKey(), CacheDomain::PreciseResult, { result.value, result.errorBound });
+    }
+    return result;
+}
+
+} // namespace calc
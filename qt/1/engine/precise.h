@@ -0,0 +1,31 @@
+#ifndef CALC_PRECISE_H
+#define CALC_PRECISE_H
+
+#include "expression.h"
+
+namespace calc {
+
+class ResultCache;
+
+// 自适应精度求值的结果
+struct PreciseResult {
+    double value = 0.0;       // 结果；误差界覆盖了 0 时置为精确的 0
+    double errorBound = 0.0;  // |value - 真值| 的上界（超越函数按 libm 约 1ulp 估计）
+    bool refined = false;     // 是否动用了双双精度重算；命中缓存时为 false
+};
+
+// 先用 double 求值并同时累计误差界：加减乘除和开方的舍入误差用无误差变换精确求出，
+// 整数运算等精确子式的误差界为 0。误差界超过显示精度时，用双双精度重算误差非零的
+// 节点，精确子式直接复用 double 结果。
+//
+// 除法和取模与 Expression::evaluate 一样把 isZeroDivisor 的除数当作 0 返回 inf，
+// 此外除数在误差范围内可能为 0 时也返回 inf
+//
+// 给出 cache 时先按整式查最终结果，未命中再在第一遍中按子式查 (值, 误差界)，
+// 命中的子树整段跳过
+PreciseResult evaluatePrecise(const Expression& expression, const EvalOptions& options = EvalOptions(),
+                              ResultCache* cache = nullptr);
+
+} // namespace calc
+
+#endif // CALC_PRECISE_H
@@ -0,0 +1,203 @@
+#include "program.h"
+
+#include <cmath>
+#include <limits>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CALC_COMPUTED_GOTO 1
+#endif
+
+namespace calc {
+
+namespace {
+
+// 降级过程中的模拟栈元素：常量尚未落到寄存器，只记录数值
+struct Slot {
+    bool isConst;
+    double value;
+};
+
+ByteOp registerOp(OpCode op)
+{
+    switch (op) {
+    case OpCode::Add: return ByteOp::Add;
+    case OpCode::Sub: return ByteOp::Sub;
+    case OpCode::Mul: return ByteOp::Mul;
+    case OpCode::Div: return ByteOp::Div;
+    case OpCode::Mod: return ByteOp::Mod;
+    default: return ByteOp::Pow;
+    }
+}
+
+ByteOp immediateOp(OpCode op)
+{
+    switch (op) {
+    case OpCode::Add: return ByteOp::AddK;
+    case OpCode::Sub: return ByteOp::SubK;
+    case OpCode::Mul: return ByteOp::MulK;
+    case OpCode::Div: return ByteOp::DivK;
+    case OpCode::Mod: return ByteOp::ModK;
+    default: return ByteOp::PowK;
+    }
+}
+
+} // namespace
+
+Program Program::compile(const Expression& expr, const EvalOptions& options)
+{
+    Program program;
+    program.options = options;
+    if (!expr.isValid()) {
+        return program;
+    }
+
+    std::vector<Slot> stack;
+    stack.reserve(static_cast<std::size_t>(expr.maxStackDepth()));
+    std::vector<ByteCode>& code = program.code;
+
+    auto emit = [&](ByteOp op, std::size_t dst, std::size_t a, std::size_t b = 0, double k = 0.0, OpCode fn = OpCode::PushConst) {
+        code.push_back({ op, fn, static_cast<std::uint32_t>(dst), static_cast<std::uint32_t>(a), static_cast<std::uint32_t>(b), k });
+        if (static_cast<int>(dst) + 1 > program.registers) {
+            program.registers = static_cast<int>(dst) + 1;
+        }
+    };
+
+    // 寄存器编号即栈槽位，常量在需要时才落到寄存器
+    auto materialize = [&](std::size_t slot) {
+        if (stack[slot].isConst) {
+            emit(ByteOp::LoadK, slot, slot, 0, stack[slot].value);
+            stack[slot].isConst = false;
+        }
+    };
+
+    for (const Instruction& ins : expr.code()) {
+        if (ins.op == OpCode::PushConst) {
+            stack.push_back({ true, ins.value });
+            continue;
+        }
+        if (ins.op == OpCode::PushVar) {
+            stack.push_back({ false, 0.0 });
+            emit(ByteOp::LoadX, stack.size() - 1, 0);
+            continue;
+        }
+
+        if (!isBinary(ins.op)) {
+            const std::size_t top = stack.size() - 1;
+            if (stack[top].isConst) {
+                stack[top].value = applyUnary(ins.op, stack[top].value, options);
+            }
+            else if (ins.op == OpCode::Neg) {
+                emit(ByteOp::Neg, top, top);
+            }
+            else if (ins.op == OpCode::Square) {
+                emit(ByteOp::Square, top, top);
+            }
+            else {
+                emit(ByteOp::Unary, top, top, 0, 0.0, ins.op);
+            }
+            continue;
+        }
+
+        const std::size_t rhs = stack.size() - 1;
+        const std::size_t lhs = rhs - 1;
+        const Slot r = stack[rhs];
+        Slot& l = stack[lhs];
+        stack.pop_back();
+
+        if (l.isConst && r.isConst) {
+            l.value = applyBinary(ins.op, l.value, r.value);
+        }
+        else if (r.isConst) {
+            emit(immediateOp(ins.op), lhs, lhs, 0, r.value);
+        }
+        else if (l.isConst && (ins.op == OpCode::Add || ins.op == OpCode::Mul)) {
+            // 可交换运算：常量直接作为立即数
+            emit(immediateOp(ins.op), lhs, rhs, 0, l.value);
+            l.isConst = false;
+        }
+        else if (l.isConst && ins.op == OpCode::Sub) {
+            emit(ByteOp::KSub, lhs, rhs, 0, l.value);
+            l.isConst = false;
+        }
+        else if (l.isConst && ins.op == OpCode::Div) {
+            emit(ByteOp::KDiv, lhs, rhs, 0, l.value);
+            l.isConst = false;
+        }
+        else {
+            materialize(lhs);
+            emit(registerOp(ins.op), lhs, lhs, rhs);
+        }
+    }
+
+    program.constant = stack.front().isConst;
+    materialize(0);
+    code.push_back({ ByteOp::Ret, OpCode::PushConst, 0, 0, 0, 0.0 });
+    program.valid = true;
+    return program;
+}
+
+double Program::run(double x) const
+{
+    if (!valid) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+
+    constexpr int kInlineRegisters = 64;
+    double inlineRegs[kInlineRegisters];
+    std::vector<double> heapRegs;
+    double* r = inlineRegs;
+    if (registers > kInlineRegisters) {
+        heapRegs.resize(static_cast<std::size_t>(registers));
+        r = heapRegs.data();
+    }
+
+    const ByteCode* pc = code.data();
+
+#ifdef CALC_COMPUTED_GOTO
+    // 标签顺序必须与 ByteOp 一致
+    static void* const labels[] = {
+        &&op_LoadK, &&op_LoadX, &&op_Neg, &&op_Square, &&op_Unary,
+        &&op_Add, &&op_Sub, &&op_Mul, &&op_Div, &&op_Mod, &&op_Pow,
+        &&op_AddK, &&op_SubK, &&op_MulK, &&op_DivK, &&op_ModK, &&op_PowK,
+        &&op_KSub, &&op_KDiv, &&op_Ret
+    };
+#define CALC_OP(name) op_##name:
+#define CALC_NEXT() goto *labels[static_cast<int>((++pc)->op)]
+    goto *labels[static_cast<int>(pc->op)];
+#else
+#define CALC_OP(name) case ByteOp::name:
+#define CALC_NEXT() ++pc; continue
+    for (;;) {
+        switch (pc->op) {
+#endif
+
+    CALC_OP(LoadK) r[pc->dst] = pc->k; CALC_NEXT();
+    CALC_OP(LoadX) r[pc->dst] = x; CALC_NEXT();
+    CALC_OP(Neg) r[pc->dst] = -r[pc->a]; CALC_NEXT();
+    CALC_OP(Square) r[pc->dst] = r[pc->a] * r[pc->a]; CALC_NEXT();
+    CALC_OP(Unary) r[pc->dst] = applyUnary(pc->fn, r[pc->a], options); CALC_NEXT();
+    CALC_OP(Add) r[pc->dst] = r[pc->a] + r[pc->b]; CALC_NEXT();
+    CALC_OP(Sub) r[pc->dst] = r[pc->a] - r[pc->b]; CALC_NEXT();
+    CALC_OP(Mul) r[pc->dst] = r[pc->a] * r[pc->b]; CALC_NEXT();
+    CALC_OP(Div) r[pc->dst] = applyBinary(OpCode::Div, r[pc->a], r[pc->b]); CALC_NEXT();
+    CALC_OP(Mod) r[pc->dst] = applyBinary(OpCode::Mod, r[pc->a], r[pc->b]); CALC_NEXT();
+    CALC_OP(Pow) r[pc->dst] = std::pow(r[pc->a], r[pc->b]); CALC_NEXT();
+    CALC_OP(AddK) r[pc->dst] = r[pc->a] + pc->k; CALC_NEXT();
+    CALC_OP(SubK) r[pc->dst] = r[pc->a] - pc->k; CALC_NEXT();
+    CALC_OP(MulK) r[pc->dst] = r[pc->a] * pc->k; CALC_NEXT();
+    CALC_OP(DivK) r[pc->dst] = applyBinary(OpCode::Div, r[pc->a], pc->k); CALC_NEXT();
+    CALC_OP(ModK) r[pc->dst] = applyBinary(OpCode::Mod, r[pc->a], pc->k); CALC_NEXT();
+    CALC_OP(PowK) r[pc->dst] = std::pow(r[pc->a], pc->k); CALC_NEXT();
+    CALC_OP(KSub) r[pc->dst] = pc->k - r[pc->a]; CALC_NEXT();
+    CALC_OP(KDiv) r[pc->dst] = applyBinary(OpCode::Div, pc->k, r[pc->a]); CALC_NEXT();
+    CALC_OP(Ret) return r[0];
+
+#ifndef CALC_COMPUTED_GOTO
+        }
+    }
+#endif
+#undef CALC_OP
+#undef CALC_NEXT
+}
+
+} // namespace calc
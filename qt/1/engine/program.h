@@ -0,0 +1,73 @@
+#ifndef CALC_PROGRAM_H
+#define CALC_PROGRAM_H
+
+#include "expression.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace calc {
+
+// 寄存器字节码操作码，K 结尾表示右操作数为立即数，K 开头表示左操作数为立即数
+enum class ByteOp : std::uint8_t {
+    LoadK,
+    LoadX,
+    Neg,
+    Square,
+    Unary,   // 其余一元函数（三角、对数、阶乘等），具体函数见 fn
+    Add,
+    Sub,
+    Mul,
+    Div,
+    Mod,
+    Pow,
+    AddK,
+    SubK,
+    MulK,
+    DivK,
+    ModK,
+    PowK,
+    KSub,
+    KDiv,
+    Ret
+};
+
+// 三地址指令：dst = a op b / dst = a op k
+struct ByteCode {
+    ByteOp op;
+    OpCode fn;       // ByteOp::Unary 时对应的函数
+    std::uint32_t dst;
+    std::uint32_t a;
+    std::uint32_t b;
+    double k;
+};
+
+// 由 Expression 降级得到的扁平字节码程序。
+// 编译时折叠所有常量子树，运行时只处理依赖变量 x 的部分；
+// run() 不修改对象状态，可在多线程中共享同一个 Program 反复求值。
+class Program
+{
+public:
+    static Program compile(const Expression& expr, const EvalOptions& options = EvalOptions());
+
+    bool isValid() const { return valid; }
+    bool isConstant() const { return constant; }
+    std::size_t size() const { return code.size(); }
+    int registerCount() const { return registers; }
+    const std::vector<ByteCode>& instructions() const { return code; }
+    const EvalOptions& evalOptions() const { return options; }
+
+    // 以 x 的取值执行程序，非法程序返回 NaN
+    double run(double x = 0.0) const;
+
+private:
+    std::vector<ByteCode> code;
+    EvalOptions options;
+    int registers = 0;
+    bool valid = false;
+    bool constant = false;
+};
+
+} // namespace calc
+
+#endif // CALC_PROGRAM_H
@@ -0,0 +1,300 @@
+#include "resultcache.h"
+#include "trig.h"
+
+#include <cstring>
+
+namespace calc {
+
+namespace {
+
+constexpr std::uint64_t kSeedHi = 0x9e3779b97f4a7c15ULL;
+constexpr std::uint64_t kSeedLo = 0xc2b2ae3d27d4eb4fULL;
+
+// MurmurHash3 的 64 位收尾函数
+std::uint64_t fmix(std::uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+std::uint64_t combine(std::uint64_t h, std::uint64_t value)
+{
+    return fmix(h ^ (value + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2)));
+}
+
+std::uint64_t bitsOf(double value)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+CacheKey combine(const CacheKey& key, std::uint64_t value)
+{
+    return { combine(key.hi, value), combine(key.lo, value) };
+}
+
+CacheKey combine(const CacheKey& key, const CacheKey& child)
+{
+    return { combine(key.hi, child.hi), combine(key.lo, child.lo) };
+}
+
+CacheKey opKey(OpCode op)
+{
+    const std::uint64_t code = static_cast<std::uint64_t>(op) + 1;
+    return { combine(kSeedHi, code), combine(kSeedLo, code) };
+}
+
+bool keyLess(const CacheKey& a, const CacheKey& b)
+{
+    return a.hi != b.hi ? a.hi < b.hi : a.lo < b.lo;
+}
+
+bool isCommutative(OpCode op)
+{
+    return op == OpCode::Add || op == OpCode::Mul;
+}
+
+bool isCostly(OpCode op)
+{
+    switch (op) {
+    case OpCode::Pow:
+    case OpCode::Factorial:
+    case OpCode::Sin:
+    case OpCode::Cos:
+    case OpCode::Tan:
+    case OpCode::Ln:
+    case OpCode::Log10:
+    case OpCode::Sqrt:
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+CacheKey tagged(const CacheKey& key, CacheDomain domain)
+{
+    return combine(key, static_cast<std::uint64_t>(domain) + 1);
+}
+
+// ---- ResultCache ----
+
+ResultCache::ResultCache(std::size_t capacity)
+    : slots(capacity > 0 ? capacity : 1)
+{
+    std::size_t tableSize = 16;
+    while (tableSize < slots.size() * 2) {
+        tableSize *= 2;
+    }
+    table.assign(tableSize, kNil);
+    mask = tableSize - 1;
+}
+
+std::size_t ResultCache::probe(const CacheKey& key) const
+{
+    std::size_t position = key.lo & mask;
+    while (table[position] != kNil && !(slots[table[position]].key == key)) {
+        position = (position + 1) & mask;
+    }
+    return position;
+}
+
+void ResultCache::unlink(std::uint32_t slot)
+{
+    Slot& s = slots[slot];
+    if (s.prev != kNil) {
+        slots[s.prev].next = s.next;
+    }
+    else {
+        head = s.next;
+    }
+    if (s.next != kNil) {
+        slots[s.next].prev = s.prev;
+    }
+    else {
+        tail = s.prev;
+    }
+    s.prev = s.next = kNil;
+}
+
+void ResultCache::pushFront(std::uint32_t slot)
+{
+    Slot& s = slots[slot];
+    s.prev = kNil;
+    s.next = head;
+    if (head != kNil) {
+        slots[head].prev = slot;
+    }
+    head = slot;
+    if (tail == kNil) {
+        tail = slot;
+    }
+}
+
+void ResultCache::eraseFromTable(std::size_t position)
+{
+    // 线性探测的删除：把后面探测链上的条目前移填洞，不留墓碑
+    table[position] = kNil;
+    std::size_t hole = position;
+    for (std::size_t i = (position + 1) & mask; table[i] != kNil; i = (i + 1) & mask) {
+        const std::size_t home = slots[table[i]].key.lo & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            table[hole] = table[i];
+            table[i] = kNil;
+            hole = i;
+        }
+    }
+}
+
+bool ResultCache::find(const CacheKey& untagged, CacheDomain domain, CachedResult& result)
+{
+    const CacheKey key = tagged(untagged, domain);
+    const bool subexpression = domain == CacheDomain::PreciseNode;
+    std::lock_guard<std::mutex> lock(mutex);
+    const std::uint32_t slot = table[probe(key)];
+    if (slot == kNil) {
+        ++(subexpression ? counters.subexpressionMisses : counters.misses);
+        return false;
+    }
+    ++(subexpression ? counters.subexpressionHits : counters.hits);
+    if (slot != head) {
+        unlink(slot);
+        pushFront(slot);
+    }
+    result = slots[slot].result;
+    return true;
+}
+
+void ResultCache::insert(const CacheKey& untagged, CacheDomain domain, const CachedResult& result)
+{
+    const CacheKey key = tagged(untagged, domain);
+    std::lock_guard<std::mutex> lock(mutex);
+    std::size_t position = probe(key);
+    std::uint32_t slot = table[position];
+    if (slot == kNil) {
+        if (used < slots.size()) {
+            slot = static_cast<std::uint32_t>(used++);
+        }
+        else {
+            slot = tail;
+            eraseFromTable(probe(slots[slot].key));
+            unlink(slot);
+            ++counters.evictions;
+            position = probe(key);  // 删除时条目可能前移，重新定位空位
+        }
+        table[position] = slot;
+        slots[slot].key = key;
+        pushFront(slot);
+        ++counters.insertions;
+    }
+    else if (slot != head) {
+        unlink(slot);
+        pushFront(slot);
+    }
+    slots[slot].result = result;
+}
+
+void ResultCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    table.assign(table.size(), kNil);
+    used = 0;
+    head = tail = kNil;
+}
+
+std::size_t ResultCache::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return used;
+}
+
+CacheStats ResultCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void ResultCache::resetStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    counters = CacheStats();
+}
+
+// ---- SubexpressionKeys ----
+
+void SubexpressionKeys::build(const Expression& expression, const EvalOptions& options)
+{
+    const std::vector<Instruction>& code = expression.code();
+    const std::size_t count = code.size();
+    keys.resize(count);
+    starts.resize(count);
+    firstAt.assign(count, kNone);
+    nextAt.assign(count, kNone);
+    costly.assign(count, false);
+    stack.clear();
+
+    for (std::size_t i = 0; i < count; ++i) {
+        const Instruction& ins = code[i];
+        CacheKey key = opKey(ins.op);
+        if (ins.op == OpCode::PushConst) {
+            key = combine(combine(key, bitsOf(ins.value)), bitsOf(expression.literalResidual(i)));
+            starts[i] = i;
+            stack.push_back(i);
+        }
+        else if (ins.op == OpCode::PushVar) {
+            key = combine(key, bitsOf(options.x));
+            starts[i] = i;
+            stack.push_back(i);
+        }
+        else if (isBinary(ins.op)) {
+            const std::size_t rhs = stack.back();
+            stack.pop_back();
+            const std::size_t lhs = stack.back();
+            const bool swap = isCommutative(ins.op) && keyLess(keys[rhs], keys[lhs]);
+            key = combine(combine(key, keys[swap ? rhs : lhs]), keys[swap ? lhs : rhs]);
+            starts[i] = starts[lhs];
+            costly[i] = costly[lhs] || costly[rhs] || isCostly(ins.op);
+            stack.back() = i;
+        }
+        else {
+            const std::size_t operand = stack.back();
+            key = combine(key, keys[operand]);
+            if (isTrig(ins.op)) {
+                key = combine(key, options.angleInDegrees ? 1 : 2);
+            }
+            starts[i] = starts[operand];
+            costly[i] = costly[operand] || isCostly(ins.op);
+            stack.back() = i;
+        }
+        keys[i] = key;
+        // 同一起点的子式按结尾倒序串起来，外层在前
+        nextAt[i] = firstAt[starts[i]];
+        firstAt[starts[i]] = i;
+    }
+}
+
+double evaluateCached(const Expression& expression, const EvalOptions& options, ResultCache& cache)
+{
+    if (!expression.isValid()) {
+        return expression.evaluate(options);
+    }
+
+    // 每个线程复用同一组缓冲区，建键不再分配内存
+    thread_local SubexpressionKeys keys;
+    keys.build(expression, options);
+    CachedResult cached;
+    if (cache.find(keys.rootKey(), CacheDomain::Plain, cached)) {
+        return cached.value;
+    }
+    cached.value = expression.evaluate(options);
+    cache.insert(keys.rootKey(), CacheDomain::Plain, cached);
+    return cached.value;
+}
+
+} // namespace calc
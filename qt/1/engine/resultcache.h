@@ -0,0 +1,133 @@
+#ifndef CALC_RESULTCACHE_H
+#define CALC_RESULTCACHE_H
+
+#include "expression.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+namespace calc {
+
+// 规范化后缀式的 128 位哈希。两路哈希独立计算，缓存不再保存原式做比对
+struct CacheKey {
+    std::uint64_t hi = 0;
+    std::uint64_t lo = 0;
+
+    bool operator==(const CacheKey& other) const { return hi == other.hi && lo == other.lo; }
+};
+
+// 同一子式在不同求值路径下缓存的内容不同，用域区分
+enum class CacheDomain : std::uint8_t {
+    Plain,         // Expression::evaluate 的整式结果
+    PreciseNode,   // 自适应精度第一遍的 (值, 误差界)
+    PreciseResult  // 自适应精度的最终结果
+};
+
+CacheKey tagged(const CacheKey& key, CacheDomain domain);
+
+struct CachedResult {
+    double value = 0.0;
+    double error = 0.0;
+};
+
+// hits/misses 只统计整式查找（Plain、PreciseResult），反映整式缓存的效果；
+// 自适应精度第一遍对每个子式的查找另记，一条新公式会有几十次子式未命中
+struct CacheStats {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t subexpressionHits = 0;
+    std::uint64_t subexpressionMisses = 0;
+    std::uint64_t insertions = 0;
+    std::uint64_t evictions = 0;
+};
+
+// 定长 LRU 结果缓存：槽位数组上的双向链表维护新旧顺序，开放定址表按键查槽位，
+// 建好之后查找和插入都不再分配内存。内部加锁，可被多个求值线程共享
+class ResultCache
+{
+public:
+    static constexpr std::size_t kDefaultCapacity = 4096;
+
+    explicit ResultCache(std::size_t capacity = kDefaultCapacity);
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    // 按 domain 区分的键查找，命中时写入 result 并把条目移到最新；同时按域累计命中/未命中次数
+    bool find(const CacheKey& key, CacheDomain domain, CachedResult& result);
+    // 已存在则覆盖，满了淘汰最久未用的条目
+    void insert(const CacheKey& key, CacheDomain domain, const CachedResult& result);
+
+    void clear();
+    std::size_t size() const;
+    std::size_t capacity() const { return slots.size(); }
+
+    CacheStats stats() const;
+    void resetStats();
+
+private:
+    static constexpr std::uint32_t kNil = std::numeric_limits<std::uint32_t>::max();
+
+    struct Slot {
+        CacheKey key;
+        CachedResult result;
+        std::uint32_t prev = kNil;
+        std::uint32_t next = kNil;
+    };
+
+    std::size_t probe(const CacheKey& key) const;
+    void unlink(std::uint32_t slot);
+    void pushFront(std::uint32_t slot);
+    void eraseFromTable(std::size_t position);
+
+    mutable std::mutex mutex;
+    std::vector<Slot> slots;
+    std::vector<std::uint32_t> table;  // 槽位下标，kNil 表示空，容量为 2 的幂且至少是槽位数的 2 倍
+    std::size_t mask = 0;
+    std::size_t used = 0;
+    std::uint32_t head = kNil;  // 最近使用
+    std::uint32_t tail = kNil;  // 最久未用
+    CacheStats counters;
+};
+
+// 表达式每个子式（后缀指令中以第 i 条结尾的子树）的规范化键。
+// 后缀式本身已经消去了空白和多余括号；加法和乘法的两个操作数按哈希排序，
+// 因此 "sin(30)+2" 与 "2 + sin(30)" 得到相同的键。子式用到 x 时键包含 x 的取值，
+// 用到三角函数时包含角度单位
+class SubexpressionKeys
+{
+public:
+    static constexpr std::size_t kNone = std::numeric_limits<std::size_t>::max();
+
+    void build(const Expression& expression, const EvalOptions& options);
+
+    std::size_t size() const { return keys.size(); }
+    const CacheKey& key(std::size_t node) const { return keys[node]; }
+    const CacheKey& rootKey() const { return keys.back(); }
+    std::size_t start(std::size_t node) const { return starts[node]; }
+
+    // 只缓存含有超越函数、乘方、开方或阶乘的子式，纯四则运算重算比查表还快
+    bool isCacheable(std::size_t node) const { return costly[node] && node != starts[node]; }
+
+    // 从 position 开始的子式，先返回最外层，再依次向内；没有时为 kNone
+    std::size_t outermostAt(std::size_t position) const { return firstAt[position]; }
+    std::size_t nextInner(std::size_t node) const { return nextAt[node]; }
+
+private:
+    std::vector<CacheKey> keys;
+    std::vector<std::size_t> starts;
+    std::vector<std::size_t> firstAt;
+    std::vector<std::size_t> nextAt;
+    std::vector<bool> costly;
+    std::vector<std::size_t> stack;  // 建键时的操作数栈，重复使用时不再分配
+};
+
+// 整式缓存在前的 Expression::evaluate
+double evaluateCached(const Expression& expression, const EvalOptions& options, ResultCache& cache);
+
+} // namespace calc
+
+#endif // CALC_RESULTCACHE_H
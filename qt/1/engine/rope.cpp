@@ -0,0 +1,318 @@
+#include "rope.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace calc {
+
+namespace {
+
+// treap 的随机优先级，只要求分布均匀，不需要密码学强度
+std::uint32_t nextPriority()
+{
+    thread_local std::uint64_t state = 0x9e3779b97f4a7c15ULL;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return static_cast<std::uint32_t>(state >> 32);
+}
+
+} // namespace
+
+Rope::Node::Node(std::string text, NodePtr l, NodePtr r, std::uint32_t p)
+    : chunk(std::move(text))
+    , left(std::move(l))
+    , right(std::move(r))
+    , size(sizeOf(left) + chunk.size() + sizeOf(right))
+    , priority(p)
+{
+}
+
+Rope::Rope(std::string_view text)
+{
+    if (text.size() <= kTailCapacity) {
+        std::memcpy(tail, text.data(), text.size());
+        tailSize = text.size();
+    }
+    else {
+        root = build(text);
+    }
+}
+
+Rope::NodePtr Rope::make(std::string chunk, NodePtr left, NodePtr right, std::uint32_t priority)
+{
+    return std::make_shared<const Node>(std::move(chunk), std::move(left), std::move(right), priority);
+}
+
+Rope::NodePtr Rope::build(std::string_view text)
+{
+    NodePtr result;
+    for (std::size_t pos = 0; pos < text.size(); pos += kMaxChunk) {
+        result = merge(result, make(std::string(text.substr(pos, kMaxChunk)), nullptr, nullptr, nextPriority()));
+    }
+    return result;
+}
+
+Rope::NodePtr Rope::merge(const NodePtr& a, const NodePtr& b)
+{
+    if (!a) {
+        return b;
+    }
+    if (!b) {
+        return a;
+    }
+    if (a->priority >= b->priority) {
+        return make(a->chunk, a->left, merge(a->right, b), a->priority);
+    }
+    return make(b->chunk, merge(a, b->left), b->right, b->priority);
+}
+
+void Rope::split(const NodePtr& node, std::size_t pos, NodePtr& left, NodePtr& right)
+{
+    if (!node) {
+        left.reset();
+        right.reset();
+        return;
+    }
+    const std::size_t leftSize = sizeOf(node->left);
+    const std::size_t chunkEnd = leftSize + node->chunk.size();
+    if (pos <= leftSize) {
+        NodePtr inner;
+        split(node->left, pos, left, inner);
+        right = make(node->chunk, inner, node->right, node->priority);
+    }
+    else if (pos >= chunkEnd) {
+        NodePtr inner;
+        split(node->right, pos - chunkEnd, inner, right);
+        left = make(node->chunk, node->left, inner, node->priority);
+    }
+    else {
+        // 切点落在本节点的文本中间：左半沿用原优先级，右半取新的优先级重新并入，
+        // 否则反复切分会产生一串同优先级的节点，树高退化成线性
+        const std::size_t offset = pos - leftSize;
+        left = make(node->chunk.substr(0, offset), node->left, nullptr, node->priority);
+        right = merge(make(node->chunk.substr(offset), nullptr, nullptr, nextPriority()), node->right);
+    }
+}
+
+Rope::NodePtr Rope::splice(const NodePtr& node, std::size_t pos, std::size_t erase, std::string_view text)
+{
+    // 改动落在单个节点之内且改完不超过 kMaxChunk 时只复制一条路径，逐字输入都走这里
+    if (!node) {
+        return nullptr;
+    }
+    const std::size_t leftSize = sizeOf(node->left);
+    const std::size_t chunkSize = node->chunk.size();
+    if (pos < leftSize) {
+        if (pos + erase > leftSize) {
+            return nullptr;
+        }
+        NodePtr left = splice(node->left, pos, erase, text);
+        return left ? make(node->chunk, std::move(left), node->right, node->priority) : nullptr;
+    }
+
+    const std::size_t offset = pos - leftSize;
+    if (offset + erase <= chunkSize) {
+        const std::size_t newSize = chunkSize - erase + text.size();
+        if (newSize > 0 && newSize <= kMaxChunk) {
+            std::string chunk;
+            chunk.reserve(newSize);
+            chunk.append(node->chunk, 0, offset);
+            chunk.append(text);
+            chunk.append(node->chunk, offset + erase, std::string::npos);
+            return make(std::move(chunk), node->left, node->right, node->priority);
+        }
+    }
+    if (offset < chunkSize) {
+        return nullptr;
+    }
+
+    // 改动从本节点末尾之后开始（包括插入点正好在末尾而本节点已满），交给右子树
+    NodePtr right = splice(node->right, offset - chunkSize, erase, text);
+    return right ? make(node->chunk, node->left, std::move(right), node->priority) : nullptr;
+}
+
+Rope::NodePtr Rope::insertTree(const NodePtr& node, std::size_t pos, std::string_view text)
+{
+    if (NodePtr result = splice(node, pos, 0, text)) {
+        return result;
+    }
+    NodePtr left;
+    NodePtr right;
+    split(node, pos, left, right);
+    return merge(merge(left, build(text)), right);
+}
+
+Rope::NodePtr Rope::eraseTree(const NodePtr& node, std::size_t pos, std::size_t count)
+{
+    if (NodePtr result = splice(node, pos, count, std::string_view())) {
+        return result;
+    }
+    NodePtr left;
+    NodePtr middle;
+    NodePtr rest;
+    NodePtr right;
+    split(node, pos, left, rest);
+    split(rest, count, middle, right);
+    return merge(left, right);
+}
+
+Rope Rope::spliceTail(std::size_t pos, std::size_t erase, std::string_view text) const
+{
+    const std::size_t treeSize = sizeOf(root);
+    const std::size_t offset = pos - treeSize;
+    const std::size_t keep = tailSize - offset - erase;
+    const std::size_t newSize = tailSize - erase + text.size();
+    if (newSize <= kTailCapacity) {
+        Rope result(*this);
+        std::memmove(result.tail + offset + text.size(), tail + offset + erase, keep);
+        if (!text.empty()) {
+            std::memcpy(result.tail + offset, text.data(), text.size());
+        }
+        result.tailSize = newSize;
+        return result;
+    }
+
+    std::string merged;
+    merged.reserve(newSize);
+    merged.append(tail, offset);
+    merged.append(text);
+    merged.append(tail + offset + erase, keep);
+    return Rope(insertTree(root, treeSize, merged));
+}
+
+char Rope::at(std::size_t pos) const
+{
+    const std::size_t treeSize = sizeOf(root);
+    if (pos >= treeSize) {
+        pos -= treeSize;
+        return pos < tailSize ? tail[pos] : '\0';
+    }
+    const Node* node = root.get();
+    while (node) {
+        const std::size_t leftSize = sizeOf(node->left);
+        if (pos < leftSize) {
+            node = node->left.get();
+            continue;
+        }
+        pos -= leftSize;
+        if (pos < node->chunk.size()) {
+            return node->chunk[pos];
+        }
+        pos -= node->chunk.size();
+        node = node->right.get();
+    }
+    return '\0';
+}
+
+Rope Rope::insert(std::size_t pos, std::string_view text) const
+{
+    if (text.empty()) {
+        return *this;
+    }
+    pos = std::min(pos, size());
+    if (pos >= sizeOf(root)) {
+        return spliceTail(pos, 0, text);
+    }
+    Rope result(*this);
+    result.root = insertTree(root, pos, text);
+    return result;
+}
+
+Rope Rope::append(std::string_view text) const
+{
+    Rope result(*this);
+    result += text;
+    return result;
+}
+
+Rope& Rope::operator+=(std::string_view text)
+{
+    if (text.empty()) {
+        return *this;
+    }
+    if (tailSize + text.size() <= kTailCapacity) {
+        std::memcpy(tail + tailSize, text.data(), text.size());
+        tailSize += text.size();
+        return *this;
+    }
+    return *this = spliceTail(size(), 0, text);
+}
+
+void Rope::clear()
+{
+    root.reset();
+    tailSize = 0;
+}
+
+Rope Rope::erase(std::size_t pos, std::size_t count) const
+{
+    const std::size_t length = size();
+    if (pos >= length) {
+        return *this;
+    }
+    count = std::min(count, length - pos);
+    if (count == 0) {
+        return *this;
+    }
+    const std::size_t treeSize = sizeOf(root);
+    if (pos >= treeSize) {
+        return spliceTail(pos, count, std::string_view());
+    }
+
+    Rope result(*this);
+    const std::size_t treeCount = std::min(count, treeSize - pos);
+    result.root = eraseTree(root, pos, treeCount);
+    if (count > treeCount) {
+        // 删除范围延伸进暂存区
+        const std::size_t tailCount = count - treeCount;
+        result.tailSize -= tailCount;
+        std::memmove(result.tail, tail + tailCount, result.tailSize);
+    }
+    return result;
+}
+
+bool Rope::endsWith(std::string_view suffix) const
+{
+    const std::size_t length = size();
+    if (suffix.size() > length) {
+        return false;
+    }
+    if (suffix.size() <= tailSize) {
+        return tailView().substr(tailSize - suffix.size()) == suffix;
+    }
+    return substr(length - suffix.size()) == suffix;
+}
+
+std::size_t Rope::copy(char* out, std::size_t pos, std::size_t count) const
+{
+    std::size_t copied = 0;
+    forEachChunk(pos, [&](std::string_view piece) {
+        const std::size_t n = std::min(piece.size(), count - copied);
+        std::memcpy(out + copied, piece.data(), n);
+        copied += n;
+        return copied < count;
+    });
+    return copied;
+}
+
+std::string Rope::substr(std::size_t pos, std::size_t count) const
+{
+    const std::size_t length = size();
+    if (pos >= length) {
+        return std::string();
+    }
+    std::string result(std::min(count, length - pos), '\0');
+    copy(&result[0], pos, result.size());
+    return result;
+}
+
+bool operator==(const Rope& a, const Rope& b)
+{
+    if (a.root == b.root && a.tailView() == b.tailView()) {
+        return true;
+    }
+    return a.size() == b.size() && a.toString() == b.toString();
+}
+
+} // namespace calc
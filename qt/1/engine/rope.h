@@ -0,0 +1,126 @@
+#ifndef CALC_ROPE_H
+#define CALC_ROPE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace calc {
+
+// 不可变的字节串，用于很长的表达式。
+//
+// 内部是按位置排序的 treap，每个节点存一段不超过 kMaxChunk 字节的文本。
+// 修改只复制从根到改动处的 O(log n) 个节点，其余子树与旧值共享，
+// 因此拷贝是 O(1)，插入、删除和在末尾追加都是 O(log n)，旧版本可以直接留作撤销记录。
+// 末尾最多 kTailCapacity 字节暂存在对象内部，逐键追加和删除末尾字符不分配内存，
+// 攒满之后才作为一段并入树中
+class Rope
+{
+public:
+    static constexpr std::size_t kMaxChunk = 512;
+    static constexpr std::size_t kTailCapacity = 192;
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    Rope() = default;
+    explicit Rope(std::string_view text);
+
+    std::size_t size() const { return sizeOf(root) + tailSize; }
+    bool empty() const { return !root && tailSize == 0; }
+    char at(std::size_t pos) const;
+
+    Rope insert(std::size_t pos, std::string_view text) const;
+    Rope erase(std::size_t pos, std::size_t count = npos) const;
+    Rope append(std::string_view text) const;
+
+    Rope& operator+=(std::string_view text);
+    Rope& operator+=(char c) { return *this += std::string_view(&c, 1); }
+    void clear();
+
+    bool endsWith(std::string_view suffix) const;
+
+    // 复制 [pos, pos + count) 到 out，返回复制的字节数
+    std::size_t copy(char* out, std::size_t pos, std::size_t count = npos) const;
+    std::string substr(std::size_t pos, std::size_t count = npos) const;
+    std::string toString() const { return substr(0); }
+
+    // 从 pos 开始按顺序把各段文本交给 fn(std::string_view)，fn 返回 false 时停止
+    template <typename Fn>
+    void forEachChunk(std::size_t pos, Fn&& fn) const;
+
+    friend bool operator==(const Rope& a, const Rope& b);
+    friend bool operator!=(const Rope& a, const Rope& b) { return !(a == b); }
+
+private:
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+
+    struct Node {
+        std::string chunk;
+        NodePtr left;
+        NodePtr right;
+        std::size_t size;        // 整棵子树的字节数
+        std::uint32_t priority;  // 堆序，父节点不小于子节点
+
+        Node(std::string text, NodePtr l, NodePtr r, std::uint32_t p);
+    };
+
+    explicit Rope(NodePtr node) : root(std::move(node)) {}
+
+    std::string_view tailView() const { return std::string_view(tail, tailSize); }
+    // 在整体位置 pos（不小于树的长度）处替换暂存区的文本，放不下时连同暂存区一起并入树
+    Rope spliceTail(std::size_t pos, std::size_t erase, std::string_view text) const;
+
+    static std::size_t sizeOf(const NodePtr& node) { return node ? node->size : 0; }
+    static NodePtr make(std::string chunk, NodePtr left, NodePtr right, std::uint32_t priority);
+    static NodePtr build(std::string_view text);
+    static NodePtr merge(const NodePtr& a, const NodePtr& b);
+    static void split(const NodePtr& node, std::size_t pos, NodePtr& left, NodePtr& right);
+    static NodePtr splice(const NodePtr& node, std::size_t pos, std::size_t erase, std::string_view text);
+    static NodePtr insertTree(const NodePtr& node, std::size_t pos, std::string_view text);
+    static NodePtr eraseTree(const NodePtr& node, std::size_t pos, std::size_t count);
+
+    template <typename Fn>
+    static bool visit(const Node* node, std::size_t pos, Fn& fn);
+
+    NodePtr root;
+    std::size_t tailSize = 0;
+    char tail[kTailCapacity] = {};  // 只有前 tailSize 字节有意义，紧接在树的文本之后
+};
+
+template <typename Fn>
+bool Rope::visit(const Node* node, std::size_t pos, Fn& fn)
+{
+    // 递归深度是树高，期望 O(log n)
+    if (!node || pos >= node->size) {
+        return true;
+    }
+    const std::size_t leftSize = sizeOf(node->left);
+    if (pos < leftSize && !visit(node->left.get(), pos, fn)) {
+        return false;
+    }
+    const std::size_t offset = pos > leftSize ? pos - leftSize : 0;
+    if (offset < node->chunk.size() && !fn(std::string_view(node->chunk).substr(offset))) {
+        return false;
+    }
+    const std::size_t rightStart = leftSize + node->chunk.size();
+    return visit(node->right.get(), pos > rightStart ? pos - rightStart : 0, fn);
+}
+
+template <typename Fn>
+void Rope::forEachChunk(std::size_t pos, Fn&& fn) const
+{
+    const std::size_t treeSize = sizeOf(root);
+    if (pos < treeSize && !visit(root.get(), pos, fn)) {
+        return;
+    }
+    const std::size_t offset = pos > treeSize ? pos - treeSize : 0;
+    if (offset < tailSize) {
+        fn(tailView().substr(offset));
+    }
+}
+
+} // namespace calc
+
+#endif // CALC_ROPE_H
@@ -0,0 +1,47 @@
+#include "samplestats.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace calc {
+
+double percentile(const std::vector<double>& sorted, double q)
+{
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    const double rank = std::ceil(q * static_cast<double>(sorted.size()));
+    const std::size_t index = rank < 1.0 ? 0 : static_cast<std::size_t>(rank) - 1;
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+SampleStats summarizeSamples(std::vector<double>& samples)
+{
+    SampleStats stats;
+    stats.count = samples.size();
+    if (samples.empty()) {
+        return stats;
+    }
+    std::sort(samples.begin(), samples.end());
+
+    double sum = 0.0;
+    for (const double value : samples) {
+        sum += value;
+    }
+    stats.mean = sum / static_cast<double>(samples.size());
+    double squares = 0.0;
+    for (const double value : samples) {
+        squares += (value - stats.mean) * (value - stats.mean);
+    }
+    stats.stddev = samples.size() > 1 ? std::sqrt(squares / static_cast<double>(samples.size() - 1)) : 0.0;
+
+    stats.min = samples.front();
+    stats.max = samples.back();
+    stats.p50 = percentile(samples, 0.50);
+    stats.p90 = percentile(samples, 0.90);
+    stats.p99 = percentile(samples, 0.99);
+    stats.p999 = percentile(samples, 0.999);
+    return stats;
+}
+
+} // namespace calc
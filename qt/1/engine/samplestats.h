@@ -0,0 +1,30 @@
+#ifndef CALC_SAMPLESTATS_H
+#define CALC_SAMPLESTATS_H
+
+#include <cstddef>
+#include <vector>
+
+namespace calc {
+
+// 一组测量值（如每次按键的耗时）的统计摘要，单位与输入相同
+struct SampleStats {
+    std::size_t count = 0;
+    double mean = 0.0;
+    double stddev = 0.0;  // 样本标准差
+    double min = 0.0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double p999 = 0.0;
+    double max = 0.0;
+};
+
+// samples 会被原地排序；分位数取最近秩，不做插值
+SampleStats summarizeSamples(std::vector<double>& samples);
+
+// 已排序样本的 q 分位数（0 <= q <= 1）
+double percentile(const std::vector<double>& sorted, double q);
+
+} // namespace calc
+
+#endif // CALC_SAMPLESTATS_H
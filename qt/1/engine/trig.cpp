@@ -0,0 +1,577 @@
+#include "trig.h"
+#include "doubledouble.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define CALC_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CALC_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CALC_TARGET_AVX2
+#endif
+
+namespace calc {
+
+namespace {
+
+constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+constexpr std::size_t kChunk = 256;       // 批量求值时每次规约的元素数
+constexpr double kRoundingShift = 0x1.8p52;  // |x| < 2^51 时 (x + 它) - 它 就是按当前舍入方式取整
+
+// π/2 与 π/180 的双双精度值
+const DoubleDouble kHalfPi(1.5707963267948966, 6.123233995736766e-17);
+const DoubleDouble kRadiansPerDegree(0.017453292519943295, 2.9486522708701687e-19);
+constexpr double kDegreeHigh = 0.01745329238474369;    // kRadiansPerDegree.hi 的高 26 位
+constexpr double kDegreeLow = 1.3519960498364902e-10;  // kRadiansPerDegree.hi - kDegreeHigh
+
+// ---- 弧度规约 ----
+
+// Cody-Waite：π/2 拆成三段，每段只有 33 位有效位，n < 2^20 时 n 乘每段都是精确的
+constexpr double kInvHalfPi = 6.36619772367581382433e-01;
+constexpr double kHalfPi1 = 1.57079632673412561417e+00;
+constexpr double kHalfPi1Tail = 6.07710050650619224932e-11;
+constexpr double kHalfPi2 = 6.07710050630396597660e-11;
+constexpr double kHalfPi2Tail = 2.02226624879595063154e-21;
+constexpr double kHalfPi3 = 2.02226624871116645580e-21;
+constexpr double kHalfPi3Tail = 8.47842766036889956997e-32;
+constexpr double kCodyWaiteLimit = 0x1p20 * 1.5707963267948966;
+
+// 2/π 的前 1280 位，足够覆盖 double 的全部指数范围（最多用到第 971 + 190 位）
+const std::uint64_t kTwoOverPi[] = {
+    0xa2f9836e4e441529ULL, 0xfc2757d1f534ddc0ULL, 0xdb6295993c439041ULL,
+    0xfe5163abdebbc561ULL, 0xb7246e3a424dd2e0ULL, 0x06492eea09d1921cULL,
+    0xfe1deb1cb129a73eULL, 0xe88235f52ebb4484ULL, 0xe99c7026b45f7e41ULL,
+    0x3991d639835339f4ULL, 0x9c845f8bbdf9283bULL, 0x1ff897ffde05980fULL,
+    0xef2f118b5a0a6d1fULL, 0x6d367ecf27cb09b7ULL, 0x4f463f669e5fea2dULL,
+    0x7527bac7ebe5f17bULL, 0x3d0739f78a5292eaULL, 0x6bfb5fb11f8d5d08ULL,
+    0x56033046fc7b6babULL, 0xf0cfbc209af4361dULL,
+};
+constexpr int kTwoOverPiWords = sizeof(kTwoOverPi) / sizeof(kTwoOverPi[0]);
+
+ReducedAngle reduceCodyWaite(double x)
+{
+    const double n = (x * kInvHalfPi + kRoundingShift) - kRoundingShift;
+    double r = x - n * kHalfPi1;
+    double w = n * kHalfPi1Tail;
+    double hi = r - w;
+    // x 接近 π/2 的倍数时抵消掉很多位，再用后两段逐步修正
+    if (std::fabs(hi) < std::fabs(x) * 0x1p-16) {
+        double t = r;
+        w = n * kHalfPi2;
+        r = t - w;
+        w = n * kHalfPi2Tail - ((t - r) - w);
+        hi = r - w;
+        if (std::fabs(hi) < std::fabs(x) * 0x1p-49) {
+            t = r;
+            w = n * kHalfPi3;
+            r = t - w;
+            w = n * kHalfPi3Tail - ((t - r) - w);
+            hi = r - w;
+        }
+    }
+
+    ReducedAngle angle;
+    angle.quadrant = static_cast<unsigned>(static_cast<std::int64_t>(n)) & 3;
+    angle.hi = hi;
+    angle.lo = (r - hi) - w;
+    return angle;
+}
+
+// 2/π 小数部分第 start 位起的 64 位（第 1 位是 2^-1 的系数），越界的位为 0
+std::uint64_t twoOverPiBits(int start)
+{
+    const auto word = [](int k) { return k >= 0 && k < kTwoOverPiWords ? kTwoOverPi[k] : 0; };
+    const int index = start - 1;
+    const int k = index >= 0 ? index / 64 : -((63 - index) / 64);
+    const int shift = index - 64 * k;
+    if (shift == 0) {
+        return word(k);
+    }
+    return (word(k) << shift) | (word(k + 1) >> (64 - shift));
+}
+
+// 64 × 64 → 128 位乘法
+void multiply(std::uint64_t a, std::uint64_t b, std::uint64_t& high, std::uint64_t& low)
+{
+    const std::uint64_t a0 = a & 0xffffffffULL;
+    const std::uint64_t a1 = a >> 32;
+    const std::uint64_t b0 = b & 0xffffffffULL;
+    const std::uint64_t b1 = b >> 32;
+    const std::uint64_t p00 = a0 * b0;
+    const std::uint64_t p01 = a0 * b1;
+    const std::uint64_t p10 = a1 * b0;
+    const std::uint64_t middle = (p00 >> 32) + (p01 & 0xffffffffULL) + (p10 & 0xffffffffULL);
+    low = (middle << 32) | (p00 & 0xffffffffULL);
+    high = a1 * b1 + (p01 >> 32) + (p10 >> 32) + (middle >> 32);
+}
+
+// Payne-Hanek：x = m·2^e，只取 2/π 中对 x·2/π mod 4 有贡献的 192 位与 m 相乘，
+// 乘积的第 190、191 位是象限，其下是小数部分，精度远超 double 与 π/2 倍数的最近距离（约 2^-61）
+ReducedAngle reducePayneHanek(double x)
+{
+    int exponent = 0;
+    const double mantissa = std::frexp(x, &exponent);
+    const std::uint64_t m = static_cast<std::uint64_t>(std::ldexp(mantissa, 53));
+    const int e = exponent - 53;
+
+    // 第 i 位贡献 m·2^(e-i)，e - i >= 2 时是 4 的倍数，可以跳过
+    const int first = e - 1;
+    const std::uint64_t w0 = twoOverPiBits(first);
+    const std::uint64_t w1 = twoOverPiBits(first + 64);
+    const std::uint64_t w2 = twoOverPiBits(first + 128);
+
+    std::uint64_t h0, l0, h1, l1, h2, l2;
+    multiply(m, w0, h0, l0);
+    multiply(m, w1, h1, l1);
+    multiply(m, w2, h2, l2);
+    const std::uint64_t p3 = l2;
+    const std::uint64_t p2 = h2 + l1;
+    const std::uint64_t p1 = h1 + l0 + (p2 < h2 ? 1 : 0);
+
+    unsigned quadrant = static_cast<unsigned>(p1 >> 62);
+    std::uint64_t f0 = (p1 << 2) | (p2 >> 62);
+    std::uint64_t f1 = (p2 << 2) | (p3 >> 62);
+    // 小数部分不小于 1/2 时进到下一象限，余下的角为负
+    bool negative = false;
+    if (f0 >> 63) {
+        ++quadrant;
+        negative = true;
+        f1 = ~f1 + 1;
+        f0 = ~f0 + (f1 == 0 ? 1 : 0);
+    }
+    int scale = 0;
+    if (f0 == 0) {
+        f0 = f1;
+        f1 = 0;
+        scale = -64;
+    }
+    while (!(f0 >> 63)) {
+        f0 = (f0 << 1) | (f1 >> 63);
+        f1 <<= 1;
+        --scale;
+    }
+    const double hi = std::ldexp(static_cast<double>(f0 >> 11), scale - 53);
+    const double lo = std::ldexp(static_cast<double>(f0 & 0x7ff), scale - 64)
+                      + std::ldexp(static_cast<double>(f1), scale - 128);
+    const DoubleDouble radians = quickTwoSum(hi, lo) * kHalfPi;
+
+    ReducedAngle angle;
+    angle.quadrant = quadrant & 3;
+    angle.hi = negative ? -radians.hi : radians.hi;
+    angle.lo = negative ? -radians.lo : radians.lo;
+    return angle;
+}
+
+// ---- 象限选择与精确值 ----
+
+// sin(q, r)：q = 0..3 依次为 sin r, cos r, -sin r, -cos r；cos(q, r) 为 cos r, -sin r, -cos r, sin r；
+// tan(q, r)：q 为偶数时 sin r / cos r，为奇数时 -cos r / sin r
+void quadrantSelection(OpCode op, unsigned quadrant, double& pick, double& sign)
+{
+    const bool odd = (quadrant & 1) != 0;
+    switch (op) {
+    case OpCode::Sin:
+        pick = odd ? 1.0 : 0.0;
+        sign = quadrant >= 2 ? -1.0 : 1.0;
+        break;
+    case OpCode::Cos:
+        pick = odd ? 0.0 : 1.0;
+        sign = quadrant == 1 || quadrant == 2 ? -1.0 : 1.0;
+        break;
+    default:
+        pick = odd ? 1.0 : 0.0;
+        sign = odd ? -1.0 : 1.0;
+        break;
+    }
+}
+
+// 度数余量为 0、±30、±45 时的精确值（正确舍入），其他余量返回 false
+bool exactDegrees(OpCode op, unsigned quadrant, double remainder, double& value)
+{
+    const double magnitude = std::fabs(remainder);
+    double s, c, t, cot;
+    if (magnitude == 0) {
+        s = 0.0;
+        c = 1.0;
+        t = 0.0;
+        cot = kNaN;
+    }
+    else if (magnitude == 30) {
+        s = 0.5;
+        c = 0.8660254037844386;   // √3/2
+        t = 0.5773502691896257;   // 1/√3
+        cot = 1.7320508075688772; // √3
+    }
+    else if (magnitude == 45) {
+        s = c = 0.7071067811865476;  // √2/2
+        t = cot = 1.0;
+    }
+    else {
+        return false;
+    }
+    if (remainder < 0) {
+        s = -s;
+        t = -t;
+        cot = -cot;
+    }
+    const bool odd = (quadrant & 1) != 0;
+    switch (op) {
+    case OpCode::Sin:
+        value = odd ? c : s;
+        value = quadrant >= 2 ? -value : value;
+        break;
+    case OpCode::Cos:
+        value = odd ? s : c;
+        value = quadrant == 1 || quadrant == 2 ? -value : value;
+        break;
+    default:
+        value = odd ? -cot : t;
+        break;
+    }
+    value += 0.0;  // 不产生 -0
+    return true;
+}
+
+// ---- 多项式核 ----
+#define CALC_TRIG_NAME trigScalar
+#define CALC_LANE_NAME trigLaneScalar
+#define CALC_KERNEL_TARGET
+#define CALC_V double
+#define CALC_W 1
+#define CALC_LOAD(p) (*(p))
+#define CALC_STORE(p, v) (*(p) = (v))
+#define CALC_SET1(v) (v)
+#define CALC_ADD(a, b) ((a) + (b))
+#define CALC_SUB(a, b) ((a) - (b))
+#define CALC_MUL(a, b) ((a) * (b))
+#define CALC_DIV(a, b) ((a) / (b))
+#define CALC_PICK(flag, a, b) ((flag) != 0 ? (a) : (b))
+#define CALC_NAN_IF_TINY(d, v) (isZeroDivisor(d) ? kNaN : (v))
+#include "trigkernel.inc"
+#undef CALC_TRIG_NAME
+#undef CALC_LANE_NAME
+#undef CALC_KERNEL_TARGET
+#undef CALC_V
+#undef CALC_W
+#undef CALC_LOAD
+#undef CALC_STORE
+#undef CALC_SET1
+#undef CALC_ADD
+#undef CALC_SUB
+#undef CALC_MUL
+#undef CALC_DIV
+#undef CALC_PICK
+#undef CALC_NAN_IF_TINY
+
+#ifdef CALC_HAVE_X86
+
+inline __m128d pickSse2(__m128d flag, __m128d a, __m128d b)
+{
+    const __m128d mask = _mm_cmpneq_pd(flag, _mm_setzero_pd());
+    return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+
+inline __m128d nanIfTinySse2(__m128d d, __m128d v)
+{
+    const __m128d absMask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+    const __m128d tiny = _mm_cmplt_pd(_mm_and_pd(d, absMask), _mm_set1_pd(kZeroDivisorThreshold));
+    return _mm_or_pd(_mm_and_pd(tiny, _mm_set1_pd(kNaN)), _mm_andnot_pd(tiny, v));
+}
+
+#define CALC_TRIG_NAME trigSse2
+#define CALC_LANE_NAME trigLaneSse2
+#define CALC_KERNEL_TARGET
+#define CALC_V __m128d
+#define CALC_W 2
+#define CALC_LOAD(p) _mm_loadu_pd(p)
+#define CALC_STORE(p, v) _mm_storeu_pd((p), (v))
+#define CALC_SET1(v) _mm_set1_pd(v)
+#define CALC_ADD(a, b) _mm_add_pd((a), (b))
+#define CALC_SUB(a, b) _mm_sub_pd((a), (b))
+#define CALC_MUL(a, b) _mm_mul_pd((a), (b))
+#define CALC_DIV(a, b) _mm_div_pd((a), (b))
+#define CALC_PICK(flag, a, b) pickSse2((flag), (a), (b))
+#define CALC_NAN_IF_TINY(d, v) nanIfTinySse2((d), (v))
+#include "trigkernel.inc"
+#undef CALC_TRIG_NAME
+#undef CALC_LANE_NAME
+#undef CALC_KERNEL_TARGET
+#undef CALC_V
+#undef CALC_W
+#undef CALC_LOAD
+#undef CALC_STORE
+#undef CALC_SET1
+#undef CALC_ADD
+#undef CALC_SUB
+#undef CALC_MUL
+#undef CALC_DIV
+#undef CALC_PICK
+#undef CALC_NAN_IF_TINY
+
+CALC_TARGET_AVX2
+inline __m256d pickAvx2(__m256d flag, __m256d a, __m256d b)
+{
+    return _mm256_blendv_pd(b, a, _mm256_cmp_pd(flag, _mm256_setzero_pd(), _CMP_NEQ_UQ));
+}
+
+CALC_TARGET_AVX2
+inline __m256d nanIfTinyAvx2(__m256d d, __m256d v)
+{
+    const __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+    const __m256d tiny = _mm256_cmp_pd(_mm256_and_pd(d, absMask), _mm256_set1_pd(kZeroDivisorThreshold), _CMP_LT_OQ);
+    return _mm256_blendv_pd(v, _mm256_set1_pd(kNaN), tiny);
+}
+
+#define CALC_TRIG_NAME trigAvx2
+#define CALC_LANE_NAME trigLaneAvx2
+#define CALC_KERNEL_TARGET CALC_TARGET_AVX2
+#define CALC_V __m256d
+#define CALC_W 4
+#define CALC_LOAD(p) _mm256_loadu_pd(p)
+#define CALC_STORE(p, v) _mm256_storeu_pd((p), (v))
+#define CALC_SET1(v) _mm256_set1_pd(v)
+#define CALC_ADD(a, b) _mm256_add_pd((a), (b))
+#define CALC_SUB(a, b) _mm256_sub_pd((a), (b))
+#define CALC_MUL(a, b) _mm256_mul_pd((a), (b))
+#define CALC_DIV(a, b) _mm256_div_pd((a), (b))
+#define CALC_PICK(flag, a, b) pickAvx2((flag), (a), (b))
+#define CALC_NAN_IF_TINY(d, v) nanIfTinyAvx2((d), (v))
+#include "trigkernel.inc"
+#undef CALC_TRIG_NAME
+#undef CALC_LANE_NAME
+#undef CALC_KERNEL_TARGET
+#undef CALC_V
+#undef CALC_W
+#undef CALC_LOAD
+#undef CALC_STORE
+#undef CALC_SET1
+#undef CALC_ADD
+#undef CALC_SUB
+#undef CALC_MUL
+#undef CALC_DIV
+#undef CALC_PICK
+#undef CALC_NAN_IF_TINY
+
+#endif // CALC_HAVE_X86
+
+double evaluateScalar(OpCode op, const ReducedAngle& angle, bool guardTangent)
+{
+    double pick = 0.0;
+    double sign = 1.0;
+    quadrantSelection(op, angle.quadrant, pick, sign);
+    return trigLaneScalar(angle.hi, angle.lo, pick, sign, op == OpCode::Tan, guardTangent);
+}
+
+double degreesFunction(OpCode op, double x)
+{
+    double remainder = 0.0;
+    const ReducedAngle angle = reduceDegrees(x, 0.0, &remainder);
+    double value = 0.0;
+    if (exactDegrees(op, angle.quadrant, remainder, value)) {
+        return value;
+    }
+    return evaluateScalar(op, angle, false);
+}
+
+double radiansFunction(OpCode op, double x)
+{
+    return evaluateScalar(op, reduceRadians(x), op == OpCode::Tan);
+}
+
+struct TrigEntry {
+    OpCode op;
+    TrigFunction radians;
+    TrigFunction degrees;
+};
+
+const TrigEntry kTrigFunctions[] = {
+    { OpCode::Sin, sinRadians, sinDegrees },
+    { OpCode::Cos, cosRadians, cosDegrees },
+    { OpCode::Tan, tanRadians, tanDegrees },
+};
+
+} // namespace
+
+ReducedAngle reduceRadians(double hi, double lo)
+{
+    if (!std::isfinite(hi)) {
+        ReducedAngle angle;
+        angle.hi = kNaN;
+        return angle;
+    }
+    const double magnitude = std::fabs(hi);
+    ReducedAngle angle;
+    if (magnitude < kCodyWaiteLimit) {
+        angle = reduceCodyWaite(hi);
+    }
+    else {
+        angle = reducePayneHanek(magnitude);
+        if (hi < 0) {
+            angle.quadrant = (4 - angle.quadrant) & 3;
+            angle.hi = -angle.hi;
+            angle.lo = -angle.lo;
+        }
+    }
+    if (lo != 0) {
+        const DoubleDouble sum = twoSum(angle.hi, lo) + DoubleDouble(0.0, angle.lo);
+        angle.hi = sum.hi;
+        angle.lo = sum.lo;
+    }
+    return angle;
+}
+
+ReducedAngle reduceDegrees(double hi, double lo, double* remainder)
+{
+    ReducedAngle angle;
+    if (!std::isfinite(hi)) {
+        angle.hi = kNaN;
+        if (remainder) {
+            *remainder = kNaN;
+        }
+        return angle;
+    }
+    // |hi| < 2^52 时 n·90 精确，hi 与 n·90 都是 ulp(hi) 的整数倍，差不超过 46，
+    // 因此 hi - n·90 也精确；更大的 hi 是整数，先用精确的 fmod 降到 360 以内
+    const double reduced = std::fabs(hi) < 0x1p52 ? hi : std::fmod(hi, 360.0);
+    const double n = (reduced * (1.0 / 90.0) + kRoundingShift) - kRoundingShift;
+    const double r = reduced - n * 90.0;
+    angle.quadrant = static_cast<unsigned>(static_cast<std::int64_t>(n)) & 3;
+    if (remainder) {
+        *remainder = r;
+    }
+    if (lo == 0) {
+        // r·π/180 的双双精度积，常数的 Dekker 拆分预先算好
+        constexpr double split = 134217729.0;  // 2^27 + 1
+        const double c = split * r;
+        const double rh = c - (c - r);
+        const double rl = r - rh;
+        const double p = r * kRadiansPerDegree.hi;
+        const double e = ((rh * kDegreeHigh - p) + rh * kDegreeLow + rl * kDegreeHigh) + rl * kDegreeLow;
+        angle.hi = p;
+        angle.lo = e + r * kRadiansPerDegree.lo;
+        return angle;
+    }
+    const DoubleDouble radians = twoSum(r, lo) * kRadiansPerDegree;
+    angle.hi = radians.hi;
+    angle.lo = radians.lo;
+    return angle;
+}
+
+double trigOfReduced(OpCode op, const ReducedAngle& angle)
+{
+    return evaluateScalar(op, angle, false);
+}
+
+double sinDegrees(double x)
+{
+    return degreesFunction(OpCode::Sin, x);
+}
+
+double cosDegrees(double x)
+{
+    return degreesFunction(OpCode::Cos, x);
+}
+
+double tanDegrees(double x)
+{
+    return degreesFunction(OpCode::Tan, x);
+}
+
+double sinRadians(double x)
+{
+    return radiansFunction(OpCode::Sin, x);
+}
+
+double cosRadians(double x)
+{
+    return radiansFunction(OpCode::Cos, x);
+}
+
+double tanRadians(double x)
+{
+    return radiansFunction(OpCode::Tan, x);
+}
+
+bool isTrig(OpCode op)
+{
+    return trigFunction(op, false) != nullptr;
+}
+
+TrigFunction trigFunction(OpCode op, bool degrees)
+{
+    for (const TrigEntry& entry : kTrigFunctions) {
+        if (entry.op == op) {
+            return degrees ? entry.degrees : entry.radians;
+        }
+    }
+    return nullptr;
+}
+
+void evaluateTrig(OpCode op, bool degrees, const double* in, double* out, std::size_t count, SimdLevel level)
+{
+    level = std::min(level, detectSimdLevel());
+    const bool tangent = op == OpCode::Tan;
+    const bool guardTangent = tangent && !degrees;
+
+    double hi[kChunk];
+    double lo[kChunk];
+    double pick[kChunk];
+    double sign[kChunk];
+    std::size_t exactIndex[kChunk];
+    double exactValue[kChunk];
+
+    for (std::size_t start = 0; start < count; start += kChunk) {
+        const std::size_t n = std::min(kChunk, count - start);
+        std::size_t exactCount = 0;
+
+        // 规约逐元素进行；角度制的特殊角先记下精确值，多项式算完再覆盖
+        for (std::size_t i = 0; i < n; ++i) {
+            const double x = in[start + i];
+            ReducedAngle angle;
+            if (degrees) {
+                double remainder = 0.0;
+                angle = reduceDegrees(x, 0.0, &remainder);
+                if (exactDegrees(op, angle.quadrant, remainder, exactValue[exactCount])) {
+                    exactIndex[exactCount++] = i;
+                }
+            }
+            else {
+                angle = reduceRadians(x);
+            }
+            hi[i] = angle.hi;
+            lo[i] = angle.lo;
+            quadrantSelection(op, angle.quadrant, pick[i], sign[i]);
+        }
+
+        double* d = out + start;
+        std::size_t done = 0;
+        switch (level) {
+#ifdef CALC_HAVE_X86
+        case SimdLevel::AVX2:
+            done = n - n % 4;
+            trigAvx2(tangent, guardTangent, hi, lo, pick, sign, d, done);
+            break;
+        case SimdLevel::SSE2:
+            done = n - n % 2;
+            trigSse2(tangent, guardTangent, hi, lo, pick, sign, d, done);
+            break;
+#endif
+        default:
+            break;
+        }
+        trigScalar(tangent, guardTangent, hi + done, lo + done, pick + done, sign + done, d + done, n - done);
+
+        for (std::size_t k = 0; k < exactCount; ++k) {
+            d[exactIndex[k]] = exactValue[k];
+        }
+    }
+}
+
+} // namespace calc
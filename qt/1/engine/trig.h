@@ -0,0 +1,52 @@
+#ifndef CALC_TRIG_H
+#define CALC_TRIG_H
+
+#include "expression.h"
+#include "vectoreval.h"
+
+#include <cstddef>
+
+namespace calc {
+
+// 三角函数核心，不依赖 libm 的 sin/cos/tan。
+// 角度制先在度数上精确规约：fmod(x, 360) 和减去 90 的倍数都没有舍入，
+// 落在 30°、45°、90° 倍数上的角直接给出精确值（sin 180° = 0，tan 45° = 1，tan 90° 无定义）。
+// 弧度制中等大小的参数用三段 π/2 做 Cody-Waite 规约，很大的参数按 2/π 的二进制展开
+// 做 Payne-Hanek 规约，规约误差远小于 1ulp。规约之后在 [-π/4, π/4] 上求多项式
+
+// 规约后的角：原角 ≡ quadrant·π/2 + hi + lo (mod 2π)，|hi| 约不超过 π/4
+struct ReducedAngle {
+    unsigned quadrant = 0;  // 0 到 3
+    double hi = 0.0;
+    double lo = 0.0;
+};
+
+// x = hi + lo（弧度）
+ReducedAngle reduceRadians(double hi, double lo = 0.0);
+// x = hi + lo（度）。remainder 非空时写入 hi 在度数上的余量：hi = 360k + 90·quadrant + remainder，
+// remainder ∈ [-45, 45]，精确成立
+ReducedAngle reduceDegrees(double hi, double lo = 0.0, double* remainder = nullptr);
+
+// 在规约后的角上求 sin/cos/tan，误差约 1ulp（tan 约 2ulp）；tan 的分母为 0 时为 ±inf
+double trigOfReduced(OpCode op, const ReducedAngle& angle);
+
+double sinDegrees(double x);
+double cosDegrees(double x);
+double tanDegrees(double x);  // 90° + 180°k 处为 NaN
+double sinRadians(double x);
+double cosRadians(double x);
+double tanRadians(double x);  // π/2 不能精确表示，|cos x| < 1e-10 时视为无定义，返回 NaN
+
+bool isTrig(OpCode op);
+
+// 按运算和角度单位查表得到标量实现，op 不是三角函数时返回 nullptr
+using TrigFunction = double (*)(double);
+TrigFunction trigFunction(OpCode op, bool degrees);
+
+// 对整列求同一个三角函数，结果与逐个调用 trigFunction(op, degrees) 逐位一致。
+// 规约逐元素进行，多项式和象限选择按 level 在 SIMD 通道中计算。in 与 out 可以是同一块内存
+void evaluateTrig(OpCode op, bool degrees, const double* in, double* out, std::size_t count, SimdLevel level);
+
+} // namespace calc
+
+#endif // CALC_TRIG_H
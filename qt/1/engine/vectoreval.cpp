@@ -0,0 +1,218 @@
+#include "vectoreval.h"
+#include "trig.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define CALC_HAVE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+// AVX2 版本只给对应函数开启指令集，其余代码仍按基础指令集编译，
+// 不支持 AVX2 的机器不会执行到这些函数
+#if defined(__GNUC__) || defined(__clang__)
+#define CALC_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CALC_TARGET_AVX2
+#endif
+
+namespace calc {
+
+namespace {
+
+constexpr std::size_t kBlock = 256;  // 每块处理的元素数，寄存器组约占 2KB * 寄存器数
+inline double guardedDivide(double a, double b)
+{
+    return isZeroDivisor(b) ? std::numeric_limits<double>::infinity() : a / b;
+}
+
+// ---- 标量版本 ----
+#define CALC_KERNEL_NAME runScalar
+#define CALC_SIMD_LEVEL SimdLevel::Scalar
+#define CALC_KERNEL_TARGET
+#define CALC_V double
+#define CALC_W 1
+#define CALC_LOAD(p) (*(p))
+#define CALC_STORE(p, v) (*(p) = (v))
+#define CALC_SET1(v) (v)
+#define CALC_ADD(a, b) ((a) + (b))
+#define CALC_SUB(a, b) ((a) - (b))
+#define CALC_MUL(a, b) ((a) * (b))
+#define CALC_DIVG(a, b) guardedDivide((a), (b))
+#include "vectorkernel.inc"
+#undef CALC_KERNEL_NAME
+#undef CALC_SIMD_LEVEL
+#undef CALC_KERNEL_TARGET
+#undef CALC_V
+#undef CALC_W
+#undef CALC_LOAD
+#undef CALC_STORE
+#undef CALC_SET1
+#undef CALC_ADD
+#undef CALC_SUB
+#undef CALC_MUL
+#undef CALC_DIVG
+
+#ifdef CALC_HAVE_X86
+
+// ---- SSE2 版本（x86-64 基线） ----
+inline __m128d guardedDivideSse2(__m128d a, __m128d b)
+{
+    const __m128d absMask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+    const __m128d tiny = _mm_cmplt_pd(_mm_and_pd(b, absMask), _mm_set1_pd(kZeroDivisorThreshold));
+    const __m128d inf = _mm_set1_pd(std::numeric_limits<double>::infinity());
+    return _mm_or_pd(_mm_and_pd(tiny, inf), _mm_andnot_pd(tiny, _mm_div_pd(a, b)));
+}
+
+#define CALC_KERNEL_NAME runSse2
+#define CALC_SIMD_LEVEL SimdLevel::SSE2
+#define CALC_KERNEL_TARGET
+#define CALC_V __m128d
+#define CALC_W 2
+#define CALC_LOAD(p) _mm_loadu_pd(p)
+#define CALC_STORE(p, v) _mm_storeu_pd((p), (v))
+#define CALC_SET1(v) _mm_set1_pd(v)
+#define CALC_ADD(a, b) _mm_add_pd((a), (b))
+#define CALC_SUB(a, b) _mm_sub_pd((a), (b))
+#define CALC_MUL(a, b) _mm_mul_pd((a), (b))
+#define CALC_DIVG(a, b) guardedDivideSse2((a), (b))
+#include "vectorkernel.inc"
+#undef CALC_KERNEL_NAME
+#undef CALC_SIMD_LEVEL
+#undef CALC_KERNEL_TARGET
+#undef CALC_V
+#undef CALC_W
+#undef CALC_LOAD
+#undef CALC_STORE
+#undef CALC_SET1
+#undef CALC_ADD
+#undef CALC_SUB
+#undef CALC_MUL
+#undef CALC_DIVG
+
+// ---- AVX2 版本 ----
+CALC_TARGET_AVX2
+inline __m256d guardedDivideAvx2(__m256d a, __m256d b)
+{
+    const __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+    const __m256d tiny = _mm256_cmp_pd(_mm256_and_pd(b, absMask), _mm256_set1_pd(kZeroDivisorThreshold), _CMP_LT_OQ);
+    return _mm256_blendv_pd(_mm256_div_pd(a, b), _mm256_set1_pd(std::numeric_limits<double>::infinity()), tiny);
+}
+
+#define CALC_KERNEL_NAME runAvx2
+#define CALC_SIMD_LEVEL SimdLevel::AVX2
+#define CALC_KERNEL_TARGET CALC_TARGET_AVX2
+#define CALC_V __m256d
+#define CALC_W 4
+#define CALC_LOAD(p) _mm256_loadu_pd(p)
+#define CALC_STORE(p, v) _mm256_storeu_pd((p), (v))
+#define CALC_SET1(v) _mm256_set1_pd(v)
+#define CALC_ADD(a, b) _mm256_add_pd((a), (b))
+#define CALC_SUB(a, b) _mm256_sub_pd((a), (b))
+#define CALC_MUL(a, b) _mm256_mul_pd((a), (b))
+#define CALC_DIVG(a, b) guardedDivideAvx2((a), (b))
+#include "vectorkernel.inc"
+#undef CALC_KERNEL_NAME
+#undef CALC_SIMD_LEVEL
+#undef CALC_KERNEL_TARGET
+#undef CALC_V
+#undef CALC_W
+#undef CALC_LOAD
+#undef CALC_STORE
+#undef CALC_SET1
+#undef CALC_ADD
+#undef CALC_SUB
+#undef CALC_MUL
+#undef CALC_DIVG
+
+#endif // CALC_HAVE_X86
+
+SimdLevel probeSimdLevel()
+{
+#if defined(CALC_HAVE_X86) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::AVX2;
+    }
+    return __builtin_cpu_supports("sse2") ? SimdLevel::SSE2 : SimdLevel::Scalar;
+#elif defined(CALC_HAVE_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    const bool sse2 = (info[3] & (1 << 26)) != 0;
+    if (osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+        __cpuidex(info, 7, 0);
+        if (info[1] & (1 << 5)) {
+            return SimdLevel::AVX2;
+        }
+    }
+    return sse2 ? SimdLevel::SSE2 : SimdLevel::Scalar;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+} // namespace
+
+SimdLevel detectSimdLevel()
+{
+    static const SimdLevel level = probeSimdLevel();
+    return level;
+}
+
+const char* toString(SimdLevel level)
+{
+    switch (level) {
+    case SimdLevel::Scalar:
+        return "scalar";
+    case SimdLevel::SSE2:
+        return "sse2";
+    case SimdLevel::AVX2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+void evaluateColumn(const Program& program, const double* xs, double* out, std::size_t count)
+{
+    evaluateColumn(program, xs, out, count, detectSimdLevel());
+}
+
+void evaluateColumn(const Program& program, const double* xs, double* out, std::size_t count, SimdLevel level)
+{
+    if (count == 0) {
+        return;
+    }
+    if (!program.isValid()) {
+        std::fill(out, out + count, std::numeric_limits<double>::quiet_NaN());
+        return;
+    }
+
+    // 请求的指令集不能超过 CPU 实际支持的
+    level = std::min(level, detectSimdLevel());
+
+    std::vector<double> regs(static_cast<std::size_t>(program.registerCount()) * kBlock);
+    switch (level) {
+#ifdef CALC_HAVE_X86
+    case SimdLevel::AVX2:
+        runAvx2(program, xs, out, count, regs.data());
+        return;
+    case SimdLevel::SSE2:
+        runSse2(program, xs, out, count, regs.data());
+        return;
+#endif
+    default:
+        runScalar(program, xs, out, count, regs.data());
+        return;
+    }
+}
+
+} // namespace calc
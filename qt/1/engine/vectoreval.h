@@ -0,0 +1,31 @@
+#ifndef CALC_VECTOREVAL_H
+#define CALC_VECTOREVAL_H
+
+#include "program.h"
+
+#include <cstddef>
+
+namespace calc {
+
+// 列求值使用的指令集
+enum class SimdLevel {
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+// 检测当前 CPU 支持的最高指令集，结果在首次调用后缓存
+SimdLevel detectSimdLevel();
+const char* toString(SimdLevel level);
+
+// 把 x 绑定到数组 xs，对每个元素执行同一个已编译程序，结果写入调用方提供的 out。
+// 按块解释字节码：每条指令一次处理一整块数据，加减乘除在 SIMD 通道中完成，
+// sin/cos/tan 调用 evaluateTrig 的批量版本，其余函数逐元素调用标量实现，
+// 结果与 Program::run 逐个求值一致。
+// xs 与 out 可以是同一块内存。
+void evaluateColumn(const Program& program, const double* xs, double* out, std::size_t count);
+void evaluateColumn(const Program& program, const double* xs, double* out, std::size_t count, SimdLevel level);
+
+} // namespace calc
+
+#endif // CALC_VECTOREVAL_H
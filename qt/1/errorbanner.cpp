@@ -0,0 +1,65 @@
+#include "errorbanner.h"
+
+ErrorBanner::ErrorBanner(QWidget* parent)
+    : QLabel(parent)
+    , count(0)
+    , pending(false)
+{
+    setObjectName("errorBanner");
+    setAlignment(Qt::AlignCenter);
+    setWordWrap(true);
+    hide();
+
+    refreshTimer.setSingleShot(true);
+    refreshTimer.setInterval(kRefreshInterval);
+    connect(&refreshTimer, &QTimer::timeout, this, [this]() {
+        if (pending) {
+            refresh();
+        }
+    });
+
+    hideTimer.setSingleShot(true);
+    hideTimer.setInterval(kVisibleTime);
+    connect(&hideTimer, &QTimer::timeout, this, &QWidget::hide);
+}
+
+void ErrorBanner::showMessage(const QString& message)
+{
+    if (isVisible() && message == this->message) {
+        ++count;
+    }
+    else {
+        this->message = message;
+        count = 1;
+    }
+    hideTimer.start();
+
+    // 节流：上次刷新后不到 kRefreshInterval 毫秒的更新留到定时器到期时一起显示
+    if (refreshTimer.isActive()) {
+        pending = true;
+        return;
+    }
+    refresh();
+}
+
+void ErrorBanner::mousePressEvent(QMouseEvent*)
+{
+    hideTimer.stop();
+    hide();
+}
+
+void ErrorBanner::refresh()
+{
+    pending = false;
+    setText(count > 1 ? QString("❌ %1 (×%2)").arg(message).arg(count) : "❌ " + message);
+
+    // 贴在父控件（显示器）底部，宽度随父控件
+    const QRect area = parentWidget()->rect();
+    const int margin = 8;
+    const int width = area.width() - 2 * margin;
+    const int height = hasHeightForWidth() ? heightForWidth(width) : sizeHint().height();
+    setGeometry(area.left() + margin, area.bottom() - margin - height, width, height);
+    show();
+    raise();
+    refreshTimer.start();
+}
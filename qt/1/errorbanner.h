@@ -0,0 +1,37 @@
+#ifndef ERRORBANNER_H
+#define ERRORBANNER_H
+
+#include <QLabel>
+#include <QString>
+#include <QTimer>
+
+// 显示器底部的错误提示条，替代每次出错都弹出的对话框。
+// 窗口创建时建好并一直复用，显示时不进入嵌套事件循环，也不阻塞按键。
+// 连续出现的同一条错误合并显示并计数，文字最多每 kRefreshInterval 毫秒刷新一次，
+// 粘贴或回放带来的一串错误只引起很少几次重绘。一段时间没有新错误后自动隐藏，点击也可关闭
+class ErrorBanner : public QLabel
+{
+    Q_OBJECT
+
+public:
+    static constexpr int kRefreshInterval = 100;  // 毫秒
+    static constexpr int kVisibleTime = 3000;     // 最后一次出错后保持显示的毫秒数
+
+    explicit ErrorBanner(QWidget* parent);
+
+    void showMessage(const QString& message);
+
+protected:
+    void mousePressEvent(QMouseEvent* event) override;
+
+private:
+    void refresh();
+
+    QString message;    // 当前显示的错误
+    int count;          // 该错误连续出现的次数
+    bool pending;       // 节流期间有尚未显示的更新
+    QTimer refreshTimer;
+    QTimer hideTimer;
+};
+
+#endif // ERRORBANNER_H
@@ -0,0 +1,80 @@
+#include "historymodel.h"
+#include <QDateTime>
+
+HistoryModel::HistoryModel(const calc::HistoryLog& log, QObject* parent)
+    : QAbstractListModel(parent)
+    , log(log)
+    , rows(static_cast<int>(log.size()))
+    , filtered(false)
+{
+}
+
+int HistoryModel::rowCount(const QModelIndex& parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+    return filtered ? static_cast<int>(matches.size()) : rows;
+}
+
+QVariant HistoryModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= rowCount()) {
+        return QVariant();
+    }
+
+    const std::size_t i = recordAt(index.row());
+    if (role == Qt::DisplayRole) {
+        const std::string_view text = log.text(i);
+        return QString("%1. %2").arg(index.row() + 1).arg(QString::fromUtf8(text.data(), static_cast<qsizetype>(text.size())));
+    }
+    if (role == Qt::ToolTipRole) {
+        return QDateTime::fromMSecsSinceEpoch(log.record(i).timestamp).toString("yyyy-MM-dd HH:mm:ss");
+    }
+    return QVariant();
+}
+
+void HistoryModel::appendRows()
+{
+    const int total = static_cast<int>(log.size());
+    if (total <= rows) {
+        return;
+    }
+    if (filtered) {
+        rows = total;
+        return;
+    }
+    const int added = total - rows;
+    beginInsertRows(QModelIndex(), 0, added - 1);
+    rows = total;
+    endInsertRows();
+    // 行首的序号从最新一条数起，原有的行都要跟着变
+    if (added < total) {
+        emit dataChanged(index(added), index(total - 1), { Qt::DisplayRole });
+    }
+}
+
+void HistoryModel::setMatches(std::vector<std::uint32_t> ids)
+{
+    beginResetModel();
+    matches = std::move(ids);
+    filtered = true;
+    endResetModel();
+}
+
+void HistoryModel::clearMatches()
+{
+    beginResetModel();
+    matches.clear();
+    filtered = false;
+    endResetModel();
+}
+
+std::size_t HistoryModel::recordAt(int row) const
+{
+    if (filtered) {
+        return matches[static_cast<std::size_t>(row)];
+    }
+    // 第 0 行是最新的一条
+    return static_cast<std::size_t>(rows - 1 - row);
+}
@@ -0,0 +1,37 @@
+#ifndef HISTORYMODEL_H
+#define HISTORYMODEL_H
+
+#include <QAbstractListModel>
+#include <cstdint>
+#include <vector>
+#include "engine/historylog.h"
+
+// 把 HistoryLog 暴露给 QListView，最新的记录排在最前面。
+// 只在视图请求某一行时才读取对应记录，不会一次性加载整个历史
+class HistoryModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    explicit HistoryModel(const calc::HistoryLog& log, QObject* parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+    // 日志追加了新记录之后调用，把新记录插到最前面；筛选时由调用方重新搜索
+    void appendRows();
+
+    // 只显示给定的记录（HistoryIndex::search 的结果，从新到旧）
+    void setMatches(std::vector<std::uint32_t> ids);
+    void clearMatches();
+
+private:
+    const calc::HistoryLog& log;
+    int rows;
+    std::vector<std::uint32_t> matches;
+    bool filtered;
+
+    std::size_t recordAt(int row) const;
+};
+
+#endif // HISTORYMODEL_H
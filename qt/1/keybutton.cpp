@@ -0,0 +1,152 @@
+#include "keybutton.h"
+
+#include <QEvent>
+#include <QLinearGradient>
+#include <QPainter>
+#include <QPen>
+
+namespace {
+
+struct FrameColors {
+    QRgb top;
+    QRgb bottom;
+    QRgb border;
+};
+
+struct RoleStyle {
+    FrameColors frames[3];  // 普通、悬停、按下
+    int borderWidth;
+    int radius;
+    int fontPixelSize;
+    int minimumHeight;
+};
+
+// 与原来的样式表一致：数字蓝色、运算符橙色、功能绿色、内存紫色、等号青色
+const RoleStyle& styleOf(KeyButton::Role role)
+{
+    static const RoleStyle kStyles[] = {
+        { { { 0x3498db, 0x2980b9, 0x2980b9 }, { 0x5dade2, 0x3498db, 0x3498db }, { 0x2980b9, 0x1f618d, 0x1f618d } },
+          2, 12, 18, 60 },
+        { { { 0xe67e22, 0xd35400, 0xd35400 }, { 0xf39c12, 0xe67e22, 0xe67e22 }, { 0xd35400, 0xa04000, 0xa04000 } },
+          2, 12, 20, 60 },
+        { { { 0x27ae60, 0x229954, 0x229954 }, { 0x58d68d, 0x27ae60, 0x27ae60 }, { 0x229954, 0x1e8449, 0x1e8449 } },
+          2, 12, 16, 60 },
+        { { { 0x8e44ad, 0x9b59b6, 0x8e44ad }, { 0xa569bd, 0xbb8fce, 0x9b59b6 }, { 0x7d3c98, 0x8e44ad, 0x7d3c98 } },
+          2, 8, 14, 40 },
+        { { { 0x1abc9c, 0x16a085, 0x16a085 }, { 0x48c9b0, 0x1abc9c, 0x1abc9c }, { 0x16a085, 0x138d75, 0x138d75 } },
+          3, 15, 24, 60 },
+    };
+    return kStyles[static_cast<int>(role)];
+}
+
+} // namespace
+
+KeyButton::KeyButton(QWidget* parent)
+    : QPushButton(parent)
+    , keyRole(Role::Number)
+    , renderedRatio(0.0)
+{
+}
+
+void KeyButton::setRole(Role role)
+{
+    keyRole = role;
+    const RoleStyle& style = styleOf(role);
+
+    QFont keyFont = font();
+    keyFont.setFamily("Segoe UI");
+    keyFont.setPixelSize(style.fontPixelSize);
+    keyFont.setBold(true);
+    setFont(keyFont);
+    setMinimumSize(80, style.minimumHeight);
+
+    invalidateFrames();
+    update();
+}
+
+bool KeyButton::event(QEvent* event)
+{
+    // 悬停状态只影响贴哪张图，进出时重绘一次即可
+    if (event->type() == QEvent::Enter || event->type() == QEvent::Leave) {
+        update();
+    }
+    return QPushButton::event(event);
+}
+
+void KeyButton::paintEvent(QPaintEvent*)
+{
+    const Frame state = isDown() ? Pressed : (underMouse() ? Hover : Normal);
+    QPainter painter(this);
+    painter.drawPixmap(0, 0, frame(state));
+}
+
+void KeyButton::resizeEvent(QResizeEvent* event)
+{
+    invalidateFrames();
+    QPushButton::resizeEvent(event);
+}
+
+void KeyButton::changeEvent(QEvent* event)
+{
+    if (event->type() == QEvent::FontChange || event->type() == QEvent::EnabledChange) {
+        invalidateFrames();
+    }
+    QPushButton::changeEvent(event);
+}
+
+const QPixmap& KeyButton::frame(Frame state)
+{
+    // 窗口移到另一块屏幕、或者按钮文字被改过，缓存都不再可用
+    if (renderedRatio != devicePixelRatioF() || renderedText != text()) {
+        invalidateFrames();
+    }
+    if (frames[state].isNull()) {
+        renderFrame(state);
+    }
+    return frames[state];
+}
+
+void KeyButton::renderFrame(Frame state)
+{
+    const RoleStyle& style = styleOf(keyRole);
+    const FrameColors& colors = style.frames[state];
+    const qreal ratio = devicePixelRatioF();
+
+    QPixmap pixmap(size() * ratio);
+    pixmap.setDevicePixelRatio(ratio);
+    pixmap.fill(Qt::transparent);
+
+    QPainter painter(&pixmap);
+    painter.setRenderHint(QPainter::Antialiasing);
+    if (!isEnabled()) {
+        painter.setOpacity(0.5);
+    }
+
+    // 与 qlineargradient(x1:0, y1:0, x2:1, y2:1) 相同：从左上角到右下角
+    const QRectF bounds(rect());
+    QLinearGradient gradient(bounds.topLeft(), bounds.bottomRight());
+    gradient.setColorAt(0.0, QColor(colors.top));
+    gradient.setColorAt(1.0, QColor(colors.bottom));
+
+    const qreal inset = style.borderWidth / 2.0;
+    painter.setPen(QPen(QColor(colors.border), style.borderWidth));
+    painter.setBrush(gradient);
+    painter.drawRoundedRect(bounds.adjusted(inset, inset, -inset, -inset), style.radius, style.radius);
+
+    painter.setFont(font());
+    painter.setPen(Qt::white);
+    painter.drawText(rect(), Qt::AlignCenter, text());
+    painter.end();
+
+    frames[state] = pixmap;
+    renderedText = text();
+    renderedRatio = ratio;
+}
+
+void KeyButton::invalidateFrames()
+{
+    for (QPixmap& pixmap : frames) {
+        pixmap = QPixmap();
+    }
+    renderedRatio = 0.0;
+}
@@ -0,0 +1,53 @@
+#ifndef KEYBUTTON_H
+#define KEYBUTTON_H
+
+#include <QPixmap>
+#include <QPushButton>
+
+// 计算器按键。背景渐变、边框和文字按普通、悬停、按下三种状态各画一次，
+// 缓存成与屏幕 DPI 相同的位图，之后每次重绘只贴一张图，不经过样式表的绘制路径。
+// 尺寸、DPI、字体或文字改变时缓存作废，需要时重新生成
+class KeyButton : public QPushButton
+{
+    Q_OBJECT
+
+public:
+    enum class Role {
+        Number,
+        Operator,
+        Function,
+        Memory,
+        Equals,
+    };
+
+    explicit KeyButton(QWidget* parent = nullptr);
+
+    Role role() const { return keyRole; }
+    // 设置配色，同时设置对应的字体和最小尺寸
+    void setRole(Role role);
+
+protected:
+    bool event(QEvent* event) override;
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+    void changeEvent(QEvent* event) override;
+
+private:
+    enum Frame {
+        Normal,
+        Hover,
+        Pressed,
+        FrameCount,
+    };
+
+    const QPixmap& frame(Frame state);
+    void renderFrame(Frame state);
+    void invalidateFrames();
+
+    Role keyRole;
+    QPixmap frames[FrameCount];
+    QString renderedText;   // 缓存中画的文字，按钮文字改变后需要重画
+    qreal renderedRatio;    // 缓存生成时的 devicePixelRatio
+};
+
+#endif // KEYBUTTON_H
@@ -1,11 +1,57 @@
 #include "mainwindow.h"
+#include "tracedapplication.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEvent>
 #include <QStyleFactory>
 #include <QDir>
+#include <QTimer>
+#include <cstdio>
+#include <memory>
+
+namespace {
+
+void printStartupStage(const QElapsedTimer& clock, const char* stage)
+{
+    std::fprintf(stderr, "startup %-16s %7.1f ms\n", stage, clock.nsecsElapsed() / 1e6);
+}
+
+// 等待窗口第一次绘制，打印从 main() 开始的耗时后退出。
+// 窗口收到第一个 Paint 事件时，子控件也会在同一轮里绘制，
+// 因此下一次事件循环迭代（零时定时器）时整帧已经画完
+class FirstPaintProbe : public QObject
+{
+public:
+    FirstPaintProbe(const QElapsedTimer& clock, QWidget* window) : clock(clock) { window->installEventFilter(this); }
+
+protected:
+    bool eventFilter(QObject* watched, QEvent* event) override
+    {
+        if (event->type() == QEvent::Paint) {
+            watched->removeEventFilter(this);
+            QTimer::singleShot(0, this, [this]() {
+                printStartupStage(clock, "first paint");
+                QCoreApplication::quit();
+            });
+        }
+        return false;
+    }
+
+private:
+    const QElapsedTimer& clock;
+};
+
+} // namespace
 
 int main(int argc, char* argv[])
 {
-    QApplication a(argc, argv);
+    // 尽早开始计时，QApplication 的初始化也算在启动时间内
+    QElapsedTimer startupClock;
+    startupClock.start();
+
+    std::unique_ptr<calc::LatencyTrace> latencyTrace;  // 要比 a 活得久
+    TracedApplication a(argc, argv);
 
     // 设置应用程序属性
     a.setApplicationName("智能科学计算器");
@@ -20,8 +66,52 @@ int main(int argc, char* argv[])
     QFont globalFont("Segoe UI", 10);
     a.setFont(globalFont);
 
+    // --record <文件>：录制本次会话的全部按键，之后可用 calc-replay 回放
+    // --startup-time：在 stderr 打印各启动阶段的耗时，第一次绘制完成后退出
+    // --trace <文件>：记录按键到画面的延迟和事件循环卡顿，退出时写出 Chrome trace 并在 stderr 打印直方图
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption recordOption("record", "Record every key press to <file>.", "file");
+    const QCommandLineOption startupTimeOption("startup-time",
+                                               "Print startup timings up to the first paint, then exit.");
+    const QCommandLineOption traceOption("trace", "Write key-to-paint latency and stalls as a Chrome trace to <file>.",
+                                         "file");
+    const QCommandLineOption stallBudgetOption("stall-budget", "Report events handled for longer than <ms> as stalls.",
+                                               "ms", "50");
+    parser.addOption(recordOption);
+    parser.addOption(startupTimeOption);
+    parser.addOption(traceOption);
+    parser.addOption(stallBudgetOption);
+    parser.process(a);
+    const bool timeStartup = parser.isSet(startupTimeOption);
+    if (timeStartup) {
+        printStartupStage(startupClock, "application");
+    }
+
     MainWindow w;
+    if (parser.isSet(recordOption)) {
+        w.startRecording(parser.value(recordOption));
+    }
+    std::unique_ptr<FirstPaintProbe> firstPaint;
+    if (timeStartup) {
+        printStartupStage(startupClock, "window created");
+        firstPaint = std::make_unique<FirstPaintProbe>(startupClock, &w);
+    }
+    if (parser.isSet(traceOption)) {
+        const double budget = parser.value(stallBudgetOption).toDouble();
+        latencyTrace = std::make_unique<calc::LatencyTrace>(static_cast<calc::LatencyTrace::Micros>(budget * 1000));
+        a.startTrace(latencyTrace.get(), w.displayViewport());
+        w.setLatencyTrace(latencyTrace.get());
+    }
     w.show();
 
-    return a.exec();
+    const int status = a.exec();
+    if (latencyTrace) {
+        std::string error;
+        if (!latencyTrace->writeChromeTrace(parser.value(traceOption).toStdString(), &error)) {
+            std::fprintf(stderr, "%s\n", error.c_str());
+        }
+        std::fputs(latencyTrace->summary().c_str(), stderr);
+    }
+    return status;
 }
@@ -1,34 +1,80 @@
 #include "mainwindow.h"
 #include "./ui_mainwindow.h"
-#include <QMessageBox>
 #include <QDebug>
 #include <QtMath>
 #include <QRegularExpression>
 #include <QKeyEvent>
 #include <QApplication>
-#include <stdexcept>
 #include <QPropertyAnimation>
 #include <QGraphicsOpacityEffect>
 #include <QTimer>
+#include <QClipboard>
+#include <QDateTime>
+#include <QComboBox>
+#include <QDialog>
+#include <QElapsedTimer>
+#include <QDir>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QLineEdit>
+#include <QListView>
+#include <QPointer>
+#include <QPushButton>
+#include <QStandardPaths>
+#include <QTextCursor>
+#include <QVBoxLayout>
+#include "errorbanner.h"
+#include "historymodel.h"
+#include "keybutton.h"
+#include "plotview.h"
+#include "engine/numeric.h"
 #include <cmath>
 
+namespace {
+
+// 求值提交后这段时间内的按键先排队，等结果应用后按原顺序处理；
+// 之后的按键视为用户不再等待，直接作废求值
+constexpr qint64 kQueueBudgetMs = 8;
+
+// 每次空闲时补进历史索引的记录数，一批只占几毫秒，百万条历史也不会卡住界面
+constexpr std::size_t kIndexBatch = 4096;
+
+// 函数图像对话框的采样状态，只在界面线程读写。
+// 采样任务投递回来的结果可能晚于对话框关闭，所以单独分配并共享
+struct PlotSession {
+    calc::Program program;
+    calc::CancelToken pending;  // 正在进行的采样
+    calc::CancelToken calculus; // 正在进行的积分或求根
+    quint64 request = 0;        // 每次重新采样递增，只接受最新一次的结果
+    bool fitPending = true;     // 公式变化后的第一批结果要适配纵轴
+};
+
+} // namespace
+
 MainWindow::MainWindow(QWidget* parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
-    , currentNumber("0")
-    , displayText("")
-    , lastResult(0.0)
-    , waitingForOperand(true)
-    , hasResult(false)
-    , isAngleInDegrees(true)  // 默认使用度数
+    , previewLabel(nullptr)
+    , errorBanner(nullptr)
     , displayAnimation(nullptr)
-    , opacityEffect(nullptr)
-    , memoryValue(0.0)        // 初始化内存值
-    , hasMemoryValue(false)   // 初始化内存状态
-    , parenthesesCount(0)     // 初始化括号计数
+    , historyIndexTimer(nullptr)
+    , inputGeneration(0)
+    , evaluating(false)
+    , exactStreamTimer(nullptr)
+    , exactStreamed(0)
+    , latencyTrace(nullptr)
 {
     ui->setupUi(this);
 
+    // 显示器下方的实时预览，随每次按键更新
+    previewLabel = new QLabel(this);
+    previewLabel->setObjectName("previewLabel");
+    previewLabel->setAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    ui->verticalLayout->insertWidget(ui->verticalLayout->indexOf(ui->textBrowser) + 1, previewLabel);
+
+    // 显示器底部的错误提示条，平时隐藏
+    errorBanner = new ErrorBanner(ui->textBrowser);
+
     // 设置界面样式
     setupUIStyles();
 
@@ -45,240 +91,302 @@ MainWindow::MainWindow(QWidget* parent)
     // 设置窗口图标和属性
     setFixedSize(650, 800); // 调整窗口大小以适应新按钮
 
-    // 初始化动画效果
-    opacityEffect = new QGraphicsOpacityEffect(this);
-    ui->textBrowser->setGraphicsEffect(opacityEffect);
-
-    displayAnimation = new QPropertyAnimation(opacityEffect, "opacity", this);
+    // 初始化动画效果。透明度效果会让显示器每次重绘都先画到离屏缓冲再合成，
+    // 所以只在淡入进行时挂上，结束后立即摘掉
+    displayAnimation = new QPropertyAnimation(this);
+    displayAnimation->setPropertyName("opacity");
+    displayAnimation->setStartValue(0.3);
+    displayAnimation->setEndValue(1.0);
     displayAnimation->setDuration(200);
+    connect(displayAnimation, &QPropertyAnimation::finished, this, [this]() {
+        ui->textBrowser->setGraphicsEffect(nullptr);  // 同时删除效果对象
+    });
 
     // 连接新按钮的信号槽
-    connect(ui->pushButton_MC, &QPushButton::clicked, this, &MainWindow::memoryClear);
-    connect(ui->pushButton_MR, &QPushButton::clicked, this, &MainWindow::memoryRecall);
-    connect(ui->pushButton_M_plus, &QPushButton::clicked, this, &MainWindow::memoryAdd);
-    connect(ui->pushButton_M_minus, &QPushButton::clicked, this, &MainWindow::memorySubtract);
-    connect(ui->pushButton_MS, &QPushButton::clicked, this, &MainWindow::memoryStore);
+    connect(ui->pushButton_MC, &QPushButton::clicked, this, [this]() { pressKey(calc::Key::MemoryClear); });
+    connect(ui->pushButton_MR, &QPushButton::clicked, this, [this]() { pressKey(calc::Key::MemoryRecall); });
+    connect(ui->pushButton_M_plus, &QPushButton::clicked, this, [this]() { pressKey(calc::Key::MemoryAdd); });
+    connect(ui->pushButton_M_minus, &QPushButton::clicked, this, [this]() { pressKey(calc::Key::MemorySubtract); });
+    connect(ui->pushButton_MS, &QPushButton::clicked, this, [this]() { pressKey(calc::Key::MemoryStore); });
     connect(ui->pushButton_history, &QPushButton::clicked, this, &MainWindow::showHistory);
+    connect(ui->pushButton_plot, &QPushButton::clicked, this, &MainWindow::showPlot);
+
+    exactStreamTimer = new QTimer(this);
+    exactStreamTimer->setInterval(0);
+    connect(exactStreamTimer, &QTimer::timeout, this, &MainWindow::appendExactChunk);
+
+    // 后台求值结果一律排队回到界面线程处理
+    qRegisterMetaType<EvalOutcome>("EvalOutcome");
+    connect(this, &MainWindow::evaluationFinished, this, &MainWindow::onEvaluationFinished, Qt::QueuedConnection);
+    connect(this, &MainWindow::evaluationProgress, this, &MainWindow::onEvaluationProgress, Qt::QueuedConnection);
+
+    // 打开持久化历史记录，失败时只影响历史功能
+    const QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(dataDir);
+    if (!history.open(QDir(dataDir).filePath("history").toStdString())) {
+        qWarning() << "history unavailable:" << QString::fromStdString(history.errorString());
+    }
+    else if (history.size() > 0) {
+        const std::string_view last = history.text(history.size() - 1);
+        lastHistoryEntry = QString::fromUtf8(last.data(), static_cast<qsizetype>(last.size()));
+    }
+
+    // 已有的历史在事件循环空闲时分批建立搜索索引，启动和第一次搜索都不必等它
+    historyIndexTimer = new QTimer(this);
+    historyIndexTimer->setInterval(0);
+    connect(historyIndexTimer, &QTimer::timeout, this, &MainWindow::indexHistoryBatch);
+    if (history.size() > 0) {
+        historyIndexTimer->start();
+    }
 }
 
 
 MainWindow::~MainWindow()
 {
+    // 先停掉工作线程，保证之后不会再有任务访问本窗口
+    evalService.shutdown();
     delete ui;
 }
 
 // 数字按钮槽函数
-void MainWindow::on_pushButton_28_clicked() { digitClicked("7"); }
-void MainWindow::on_pushButton_31_clicked() { digitClicked("8"); }
-void MainWindow::on_pushButton_30_clicked() { digitClicked("9"); }
-void MainWindow::on_pushButton_33_clicked() { digitClicked("4"); }
-void MainWindow::on_pushButton_35_clicked() { digitClicked("5"); }
-void MainWindow::on_pushButton_34_clicked() { digitClicked("6"); }
-void MainWindow::on_pushButton_37_clicked() { digitClicked("1"); }
-void MainWindow::on_pushButton_39_clicked() { digitClicked("2"); }
-void MainWindow::on_pushButton_38_clicked() { digitClicked("3"); }
-void MainWindow::on_pushButton_43_clicked() { digitClicked("0"); }
-
-void MainWindow::on_pushButton_42_clicked()
-{
-    if (hasResult && waitingForOperand) {
-        // 如果刚计算完结果，开始新的小数
-        currentNumber = "0.";
-        hasResult = false;
-    }
-    else if (waitingForOperand || currentNumber.isEmpty() || currentNumber == "0") {
-        currentNumber = "0.";
-    }
-    else if (!currentNumber.contains('.')) {
-        currentNumber += ".";
-    }
-    waitingForOperand = false;
-    updateDisplay();
-}
+void MainWindow::on_pushButton_28_clicked() { pressKey(calc::Key::Digit7); }
+void MainWindow::on_pushButton_31_clicked() { pressKey(calc::Key::Digit8); }
+void MainWindow::on_pushButton_30_clicked() { pressKey(calc::Key::Digit9); }
+void MainWindow::on_pushButton_33_clicked() { pressKey(calc::Key::Digit4); }
+void MainWindow::on_pushButton_35_clicked() { pressKey(calc::Key::Digit5); }
+void MainWindow::on_pushButton_34_clicked() { pressKey(calc::Key::Digit6); }
+void MainWindow::on_pushButton_37_clicked() { pressKey(calc::Key::Digit1); }
+void MainWindow::on_pushButton_39_clicked() { pressKey(calc::Key::Digit2); }
+void MainWindow::on_pushButton_38_clicked() { pressKey(calc::Key::Digit3); }
+void MainWindow::on_pushButton_43_clicked() { pressKey(calc::Key::Digit0); }
+
+void MainWindow::on_pushButton_42_clicked() { pressKey(calc::Key::Point); }
 
 // 运算符按钮槽函数
-void MainWindow::on_pushButton_36_clicked() { operatorClicked("+"); }
-void MainWindow::on_pushButton_32_clicked() { operatorClicked("-"); }
-void MainWindow::on_pushButton_27_clicked() { operatorClicked("*"); }
-void MainWindow::on_pushButton_26_clicked() { operatorClicked("/"); }
+void MainWindow::on_pushButton_36_clicked() { pressKey(calc::Key::Add); }
+void MainWindow::on_pushButton_32_clicked() { pressKey(calc::Key::Subtract); }
+void MainWindow::on_pushButton_27_clicked() { pressKey(calc::Key::Multiply); }
+void MainWindow::on_pushButton_26_clicked() { pressKey(calc::Key::Divide); }
 
 // x² 按钮
-void MainWindow::on_pushButton_18_clicked()
-{
-    if (!currentNumber.isEmpty()) {
-        double value = currentNumber.toDouble();
-        double result = calculateSquare(value);
-        currentNumber = formatNumber(result);
-        waitingForOperand = true;
-        hasResult = true;
-        updateDisplay();
-    }
-}
+void MainWindow::on_pushButton_18_clicked() { pressKey(calc::Key::Square); }
 
 // √x 按钮
-void MainWindow::on_pushButton_20_clicked()
+void MainWindow::on_pushButton_20_clicked() { pressKey(calc::Key::SquareRoot); }
+
+void MainWindow::on_pushButton_40_clicked() { pressKey(calc::Key::Equals); }
+
+// 功能按钮槽函数
+void MainWindow::on_pushButton_17_clicked() { pressKey(calc::Key::ClearAll); }
+void MainWindow::on_pushButton_23_clicked() { pressKey(calc::Key::Backspace); }
+void MainWindow::on_pushButton_41_clicked() { pressKey(calc::Key::ToggleSign); }
+
+// 数学函数槽函数
+void MainWindow::on_pushButton_19_clicked() { pressKey(calc::Key::NaturalLog); }
+void MainWindow::on_pushButton_22_clicked() { pressKey(calc::Key::Log10); }
+void MainWindow::on_pushButton_21_clicked() { pressKey(calc::Key::Factorial); }
+
+bool MainWindow::startRecording(const QString& path)
 {
-    if (!currentNumber.isEmpty()) {
-        double value = currentNumber.toDouble();
-        if (value < 0) {
-            showErrorMessage("无法计算负数的平方根");
-            return;
-        }
-        double result = calculateSquareRoot(value);
-        currentNumber = formatNumber(result);
-        waitingForOperand = true;
-        hasResult = true;
-        updateDisplay();
+    if (!keyTrace.open(path.toStdString())) {
+        qWarning() << "cannot record keys:" << QString::fromStdString(keyTrace.errorString());
+        return false;
     }
+    return true;
 }
 
-void MainWindow::on_pushButton_40_clicked()
+void MainWindow::setLatencyTrace(calc::LatencyTrace* trace)
 {
-    calculate();
+    latencyTrace = trace;
 }
 
-// 功能按钮槽函数
-void MainWindow::on_pushButton_17_clicked() { clearAll(); }
-void MainWindow::on_pushButton_23_clicked() { backspace(); }
+QWidget* MainWindow::displayViewport() const
+{
+    return ui->textBrowser->viewport();
+}
 
-void MainWindow::on_pushButton_41_clicked()
+bool MainWindow::isEvaluating() const
 {
-    if (waitingForOperand && hasResult) {
-        // 如果是结果状态，直接改变符号
-        if (currentNumber.startsWith("-")) {
-            currentNumber = currentNumber.mid(1);
-        }
-        else {
-            currentNumber = "-" + currentNumber;
-        }
+    return evaluating;
+}
+
+// 辅助函数实现：按键逻辑全部在 calc::CalculatorEngine 中，这里只负责转发和刷新界面
+void MainWindow::pressKey(calc::Key key)
+{
+    if (latencyTrace) {
+        latencyTrace->keyPressed(key);
     }
-    else if (!currentNumber.isEmpty() && currentNumber != "0") {
-        if (currentNumber.startsWith("-")) {
-            currentNumber = currentNumber.mid(1);
-        }
-        else {
-            currentNumber = "-" + currentNumber;
-        }
+    if (keyTrace.isOpen()) {
+        keyTrace.record(key);
     }
-    updateDisplay();
+
+    dispatchKey(key);
 }
 
-// 数学函数槽函数
-void MainWindow::on_pushButton_19_clicked()
+void MainWindow::dispatchKey(calc::Key key)
 {
-    if (!currentNumber.isEmpty()) {
-        double value = currentNumber.toDouble();
-        if (value <= 0) {
-            showErrorMessage("自然对数的参数必须大于0");
+    // 求值刚提交（或已有按键在排队）时不打断它，按键等结果回来后再处理，
+    // 保证 "2+3=×2" 这样的快速输入与按键顺序一致。全部清除总是立即生效
+    if (evaluating && key != calc::Key::ClearAll
+        && (!queuedKeys.empty() || evaluationClock.elapsed() < kQueueBudgetMs)) {
+        queuedKeys.push_back(key);
+        return;
+    }
+
+    switch (key) {
+    case calc::Key::Equals:
+        calculate();  // 可能较慢，走后台求值
+        return;
+    case calc::Key::ClearAll:
+        clearAll();
+        return;
+    case calc::Key::Square:
+    case calc::Key::SquareRoot:
+    case calc::Key::NaturalLog:
+    case calc::Key::Log10:
+    case calc::Key::Factorial:
+        applyFunction(calc::functionOf(key));
+        return;
+    case calc::Key::MemoryStore:
+        memoryStore();
+        return;
+    case calc::Key::MemoryRecall:
+        memoryRecall();
+        return;
+    case calc::Key::MemoryAdd:
+        memoryAdd();
+        return;
+    case calc::Key::MemorySubtract:
+        memorySubtract();
+        return;
+    case calc::Key::MemoryClear:
+        memoryClear();
+        return;
+    case calc::Key::ToggleAngle:
+        toggleAngleUnit();
+        return;
+    case calc::Key::Undo:
+    case calc::Key::Redo:
+        if (key == calc::Key::Undo ? !engine.canUndo() : !engine.canRedo()) {
             return;
         }
-        double result = calculateNaturalLog(value);
-        currentNumber = formatNumber(result);
-        waitingForOperand = true;
-        hasResult = true;
-        updateDisplay();
+        break;
+    default:
+        break;
     }
+    engine.press(key);
+    updateDisplay();
 }
 
-void MainWindow::on_pushButton_22_clicked()
+void MainWindow::calculate()
 {
-    if (!currentNumber.isEmpty()) {
-        double value = currentNumber.toDouble();
-        if (value <= 0) {
-            showErrorMessage("常用对数的参数必须大于0");
-            return;
-        }
-        double result = calculateLog10(value);
-        currentNumber = formatNumber(result);
-        waitingForOperand = true;
-        hasResult = true;
-        updateDisplay();
-    }
+    evaluateAsync([](calc::CalculatorEngine& snapshot, std::string& entry, calc::JobContext&) {
+        return snapshot.equals(&entry);
+    });
 }
 
-void MainWindow::on_pushButton_21_clicked()
+void MainWindow::evaluateAsync(EvalOperation operation, bool isFunction, calc::OpCode function)
 {
-    if (!currentNumber.isEmpty()) {
-        double value = currentNumber.toDouble();
-        int intValue = static_cast<int>(value);
-        if (value != intValue || intValue < 0 || intValue > 20) {
-            showErrorMessage("阶乘只能计算0-20之间的非负整数");
-            return;
+    cancelEvaluation();
+    const quint64 generation = inputGeneration;
+    evaluating = true;
+
+    // 工作线程只操作状态副本，界面线程的 engine 在结果返回前保持不变
+    calc::CalculatorEngine snapshot(engine.state());
+    snapshot.setResultCache(&resultCache);
+    evaluationClock.start();
+    pendingEvaluation = evalService.submit(
+        [this, generation, snapshot, operation, isFunction, function](calc::JobContext& job) mutable {
+            EvalOutcome outcome;
+            outcome.error = operation(snapshot, outcome.entry, job);
+            if (job.isCancelled()) {
+                return;
+            }
+            outcome.state = snapshot.state();
+            outcome.isFunction = isFunction;
+            outcome.function = function;
+            emit evaluationFinished(generation, outcome);
+        },
+        [this, generation](double fraction) { emit evaluationProgress(generation, fraction); });
+
+    // 只有耗时明显的求值才提示，避免普通计算时标签闪烁
+    QTimer::singleShot(150, this, [this, generation]() {
+        if (evaluating && generation == inputGeneration) {
+            ui->label->setText("⏳ 计算中... (Esc 取消)");
         }
-        double result = calculateFactorial(intValue);
-        currentNumber = formatNumber(result);
-        waitingForOperand = true;
-        hasResult = true;
-        updateDisplay();
-    }
+    });
 }
 
-// 辅助函数实现
-void MainWindow::digitClicked(const QString& digit)
+void MainWindow::onEvaluationFinished(quint64 generation, const EvalOutcome& outcome)
 {
-    if (hasResult && waitingForOperand) {
-        // 如果刚计算完结果，开始新的输入
-        currentNumber = digit;
-        hasResult = false;
-        waitingForOperand = false;
-    }
-    else if (waitingForOperand || currentNumber == "0") {
-        currentNumber = digit;
-        waitingForOperand = false;
+    // 提交之后求值被新的输入作废，这个结果已经过期
+    if (generation != inputGeneration || !evaluating) {
+        return;
     }
-    else {
-        // 限制数字长度，防止显示溢出
-        if (currentNumber.length() < 15) {
-            currentNumber += digit;
-        }
+    evaluating = false;
+    applyEvaluation(outcome);
+
+    // 依次处理等结果期间排队的按键，遇到新的求值就停下，剩下的继续等它
+    while (!evaluating && !queuedKeys.empty()) {
+        const calc::Key key = queuedKeys.front();
+        queuedKeys.pop_front();
+        dispatchKey(key);
     }
-    updateDisplay();
 }
 
-void MainWindow::operatorClicked(const QString& op)
+void MainWindow::applyEvaluation(const EvalOutcome& outcome)
 {
-    if (!waitingForOperand && !hasResult && !lastOperator.isEmpty()) {
-        // 连续运算：先计算之前的结果
-        calculate();
-        if (!currentNumber.isEmpty()) {
-            displayText = currentNumber + " " + op + " ";
-            lastOperator = op;
-            waitingForOperand = true;
+    if (outcome.isFunction) {
+        if (outcome.error == calc::ErrorCode::NonPositiveLog) {
+            showErrorMessage(outcome.function == calc::OpCode::Ln ? "自然对数的参数必须大于0" : "常用对数的参数必须大于0");
+            return;
+        }
+        if (outcome.error != calc::ErrorCode::None) {
+            showErrorMessage(errorMessage(outcome.error));
+            return;
         }
+        engine.setState(outcome.state);
+        updateDisplay();
+        return;
     }
-    else {
-        lastOperator = op;
-        displayText = currentNumber + " " + op + " ";
-        waitingForOperand = true;
-        hasResult = false;
+
+    if (outcome.error == calc::ErrorCode::None) {
+        engine.setState(outcome.state);
     }
-    updateDisplay();
+    finishCalculation(outcome.error, outcome.entry);
 }
 
-void MainWindow::calculate()
+void MainWindow::onEvaluationProgress(quint64 generation, double fraction)
 {
-    if (lastOperator.isEmpty() || waitingForOperand) {
-        return;
+    if (evaluating && generation == inputGeneration) {
+        ui->label->setText(QString("⏳ 计算中 %1% (Esc 取消)").arg(qRound(fraction * 100)));
     }
+}
 
-    QString expression = displayText + currentNumber;
-    double result = evaluateExpression(expression);
+void MainWindow::cancelEvaluation()
+{
+    // 排队的按键是接着被作废的结果输入的，一并丢弃
+    if (evaluating) {
+        queuedKeys.clear();
+    }
+    pendingEvaluation.cancel();
+    ++inputGeneration;
+    evaluating = false;
+}
 
-    if (qIsInf(result) || qIsNaN(result)) {
-        showErrorMessage("计算错误或除零错误");
+void MainWindow::finishCalculation(calc::ErrorCode error, const std::string& entry)
+{
+    if (error != calc::ErrorCode::None) {
+        showErrorMessage(errorMessage(error));
         clearAll();
         return;
     }
+    if (entry.empty()) {
+        return;
+    }
 
     // 添加到历史记录
-    addToHistory(expression + " = " + formatNumber(result));
-
-    currentNumber = formatNumber(result);
-    displayText = "";
-    lastOperator.clear();
-    waitingForOperand = true;
-    hasResult = true;
-    lastResult = result;
+    addToHistory(QString::fromStdString(entry), engine.state().lastResult);
 
     // 添加结果动画效果
     animateResult();
@@ -286,287 +394,257 @@ void MainWindow::calculate()
     updateDisplay();
 }
 
-void MainWindow::updateDisplay()
+void MainWindow::applyFunction(calc::OpCode function)
 {
-    QString displayString;
+    evaluateAsync([function](calc::CalculatorEngine& snapshot, std::string&, calc::JobContext& job) {
+        return snapshot.applyFunction(function, &job);
+    }, true, function);
+}
 
-    if (hasResult && waitingForOperand && displayText.isEmpty()) {
-        // 显示最终结果，添加特殊格式
-        displayString = "= " + currentNumber;
-    }
-    else if (!displayText.isEmpty() && !waitingForOperand) {
-        // 显示完整的表达式（包括当前输入）
-        displayString = displayText + currentNumber;
-    }
-    else if (!displayText.isEmpty()) {
-        // 显示表达式（等待输入）
-        displayString = displayText + "_";  // 添加光标效果
-    }
-    else {
-        // 显示当前数字
-        displayString = currentNumber;
+void MainWindow::updateDisplay()
+{
+    // 任何输入都会使进行中的求值作废
+    cancelEvaluation();
+
+    updatePreview();
+    exactStreamTimer->stop();
+    exactStream.reset();
+    if (engine.exactResult()) {
+        startExactStream();
+        if (latencyTrace) {
+            latencyTrace->displayUpdated();
+        }
+        return;
     }
 
-    ui->textBrowser->setPlainText(displayString);
+    ui->textBrowser->setWordWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
+    ui->textBrowser->setPlainText(QString::fromStdString(engine.displayString()));
+    if (latencyTrace) {
+        latencyTrace->displayUpdated();
+    }
 
     // 在标签中显示历史记录的最后一项，使用更美观的格式
-    if (!calculationHistory.isEmpty()) {
-        ui->label->setText("📊 " + calculationHistory.last());
+    if (!lastHistoryEntry.isEmpty()) {
+        ui->label->setText("📊 " + lastHistoryEntry);
     }
     else {
         ui->label->setText("🎯 准备开始计算...");
     }
 }
 
-
-void MainWindow::clearAll()
+void MainWindow::updatePreview()
 {
-    currentNumber = "0";
-    displayText.clear();
-    lastOperator.clear();
-    lastResult = 0.0;
-    waitingForOperand = true;
-    hasResult = false;
-    ui->label->setText("🎯 准备开始计算..."); // 清除历史显示
-    updateDisplay();
-}
+    const calc::Rope expression = engine.pendingExpression();
+    if (expression.empty()) {
+        previewLabel->clear();
+        return;
+    }
 
-void MainWindow::clearEntry()
-{
-    currentNumber = "0";
-    waitingForOperand = true;
-    updateDisplay();
+    if (preview.evalOptions().angleInDegrees != engine.state().angleInDegrees) {
+        calc::EvalOptions options;
+        options.angleInDegrees = engine.state().angleInDegrees;
+        preview.setEvalOptions(options);
+    }
+    // 引擎记录了哪些部分被改动过，只重新扫描末尾，很长的公式也能逐键更新
+    const double value = preview.evaluate(expression, engine.takeUnchangedPrefix());
+    if (std::isfinite(value)) {
+        previewLabel->setText("≈ " + formatNumber(value));
+    }
+    else {
+        previewLabel->clear();
+    }
 }
 
-void MainWindow::backspace()
+void MainWindow::startExactStream()
 {
-    if (!waitingForOperand && currentNumber.length() > 1) {
-        currentNumber.chop(1);
-        if (currentNumber.isEmpty() || currentNumber == "-") {
-            currentNumber = "0";
-            waitingForOperand = true;
-        }
-        updateDisplay();
-    }
-    else if (!waitingForOperand) {
-        currentNumber = "0";
-        waitingForOperand = true;
-        updateDisplay();
+    // 几十万位的结果不拼成一个字符串，而是每次事件循环写入一段，窗口始终可以响应
+    exactStream = engine.state().exactValue;
+    exactStreamed = 0;
+    ui->textBrowser->setWordWrapMode(QTextOption::WrapAnywhere);
+    ui->textBrowser->setPlainText("= ");
+    ui->label->setText(QString("🔢 精确结果，共 %1 位").arg(exactStream->digitCount()));
+    appendExactChunk();
+    if (exactStreamed < exactStream->wordCount()) {
+        exactStreamTimer->start();
     }
 }
 
-double MainWindow::evaluateExpression(const QString& expression)
+void MainWindow::appendExactChunk()
 {
-    // 简化的表达式求值器
-    QStringList tokens = expression.split(' ', Qt::SkipEmptyParts);
-
-    if (tokens.size() != 3) {
-        return currentNumber.toDouble();
+    if (!exactStream) {
+        exactStreamTimer->stop();
+        return;
     }
 
-    double operand1 = tokens[0].toDouble();
-    QString op = tokens[1];
-    double operand2 = tokens[2].toDouble();
+    // 每段 2048 字，约 1.8 万位
+    const std::size_t count = std::min<std::size_t>(2048, exactStream->wordCount() - exactStreamed);
+    QByteArray digits(static_cast<qsizetype>(count * calc::BigInt::kBaseDigits), Qt::Uninitialized);
+    const std::size_t length = exactStream->writeDecimal(exactStreamed, count, digits.data());
+    exactStreamed += count;
 
-    if (op == "+") {
-        return operand1 + operand2;
-    }
-    else if (op == "-") {
-        return operand1 - operand2;
-    }
-    else if (op == "*") {
-        return operand1 * operand2;
-    }
-    else if (op == "/") {
-        if (qFabs(operand2) < 1e-10) {
-            return qInf();
-        }
-        return operand1 / operand2;
-    }
-    else if (op == "%") {
-        if (qFabs(operand2) < 1e-10) {
-            return qInf();
-        }
-        return fmod(operand1, operand2);
-    }
+    QTextCursor cursor(ui->textBrowser->document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(QString::fromLatin1(digits.constData(), static_cast<qsizetype>(length)));
 
-    return 0.0;
+    if (exactStreamed >= exactStream->wordCount()) {
+        exactStreamTimer->stop();
+    }
 }
 
-int MainWindow::precedence(const QString& op)
+
+void MainWindow::clearAll()
 {
-    if (op == "+" || op == "-") return 1;
-    if (op == "*" || op == "/" || op == "%") return 2;
-    return 0;
+    engine.clearAll();
+    ui->label->setText("🎯 准备开始计算..."); // 清除历史显示
+    updateDisplay();
 }
 
-bool MainWindow::isOperator(const QString& str)
+void MainWindow::pasteExpression()
 {
-    return (str == "+" || str == "-" || str == "*" || str == "/" || str == "%");
+    // 粘贴整条公式并直接求值
+    const std::string text = QApplication::clipboard()->text().simplified().toStdString();
+    evaluateAsync([text](calc::CalculatorEngine& snapshot, std::string& entry, calc::JobContext&) {
+        return snapshot.pasteExpression(text, &entry);
+    });
 }
 
-// 新增的辅助函数
 QString MainWindow::formatNumber(double number)
 {
-    // 格式化数字显示，避免科学计数法对于常见数值
-    if (qAbs(number) < 1e-10) {
-        return "0";
-    }
+    char buffer[calc::kNumberBufferSize];
+    const std::size_t length = calc::formatNumber(number, buffer);
+    return QString::fromLatin1(buffer, static_cast<int>(length));
+}
 
-    if (qAbs(number) >= 1e10 || (qAbs(number) < 1e-6 && qAbs(number) > 0)) {
-        return QString::number(number, 'e', 6);
+QString MainWindow::errorMessage(calc::ErrorCode error)
+{
+    switch (error) {
+    case calc::ErrorCode::MathError:
+        return "计算错误";
+    case calc::ErrorCode::DivisionByZero:
+        return "除数不能为0";
+    case calc::ErrorCode::Overflow:
+        return "结果超出可表示的范围";
+    case calc::ErrorCode::InvalidExpression:
+        return "无法识别的公式";
+    case calc::ErrorCode::NegativeSquareRoot:
+        return "无法计算负数的平方根";
+    case calc::ErrorCode::NonPositiveLog:
+        return "对数的参数必须大于0";
+    case calc::ErrorCode::FactorialRange:
+        return QString("阶乘只能计算0-%1之间的非负整数").arg(calc::kMaxExactFactorial);
+    case calc::ErrorCode::TanUndefined:
+        return "tan函数在该角度无定义";
+    case calc::ErrorCode::EmptyMemory:
+        return "内存中没有存储值";
+    case calc::ErrorCode::Cancelled:
+        return "计算已取消";
+    case calc::ErrorCode::None:
+        break;
     }
+    return QString();
+}
 
-    QString result = QString::number(number, 'f', 10);
+void MainWindow::addToHistory(const QString& calculation, double result)
+{
+    lastHistoryEntry = calculation;
 
-    // 移除末尾的零和小数点
-    if (result.contains('.')) {
-        while (result.endsWith('0')) {
-            result.chop(1);
-        }
-        if (result.endsWith('.')) {
-            result.chop(1);
-        }
-    }
+    // 追加到历史文件，不再限制条数
+    const QByteArray text = calculation.toUtf8();
+    history.append(std::string_view(text.constData(), static_cast<std::size_t>(text.size())), result,
+                   QDateTime::currentMSecsSinceEpoch());
 
-    return result;
+    // 索引已跟上日志时直接加入这一条；否则由分批建立的定时器一并补上
+    if (historyIndex.size() + 1 == history.size()) {
+        historyIndex.update(history);
+    }
+    else if (!historyIndexTimer->isActive()) {
+        historyIndexTimer->start();
+    }
+    emit historyAppended();
 }
 
-void MainWindow::addToHistory(const QString& calculation)
+void MainWindow::indexHistoryBatch()
 {
-    calculationHistory.append(calculation);
-
-    // 保持历史记录在合理范围内
-    if (calculationHistory.size() > 10) {
-        calculationHistory.removeFirst();
+    if (historyIndex.update(history, kIndexBatch)) {
+        historyIndexTimer->stop();
+        emit historyIndexed();
     }
 }
 
 void MainWindow::showErrorMessage(const QString& message)
 {
-    QMessageBox msgBox;
-    msgBox.setWindowTitle("⚠️ 计算器错误");
-    msgBox.setText("❌ " + message);
-    msgBox.setIcon(QMessageBox::Warning);
-    msgBox.setStyleSheet(R"(
-        QMessageBox {
-            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
-                        stop:0 #667eea, stop:1 #764ba2);
-            color: white;
-            font-family: 'Segoe UI', sans-serif;
-            font-size: 14px;
-        }
-        QMessageBox QPushButton {
-            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
-                        stop:0 #e74c3c, stop:1 #c0392b);
-            border: 2px solid #c0392b;
-            border-radius: 8px;
-            color: white;
-            font-weight: bold;
-            padding: 8px 16px;
-            min-width: 80px;
-        }
-        QMessageBox QPushButton:hover {
-            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
-                        stop:0 #ec7063, stop:1 #e74c3c);
-        }
-    )");
-    msgBox.exec();
+    // 复用显示器底部的提示条，不弹对话框，连续出错也不会阻塞输入
+    errorBanner->showMessage(message);
 }
 
-double MainWindow::performTrigFunction(double value, const QString& function)
+// 键盘事件处理
+void MainWindow::keyPressEvent(QKeyEvent* event)
 {
-    double radianValue = isAngleInDegrees ? qDegreesToRadians(value) : value;
-
-    if (function == "sin") {
-        return qSin(radianValue);
+    if (event->matches(QKeySequence::Paste)) {
+        pasteExpression();
+        return;
     }
-    else if (function == "cos") {
-        return qCos(radianValue);
+    if (event->matches(QKeySequence::Undo)) {
+        pressKey(calc::Key::Undo);
+        return;
     }
-    else if (function == "tan") {
-        // 检查tan函数的定义域
-        double cosValue = qCos(radianValue);
-        if (qAbs(cosValue) < 1e-10) {
-            throw std::runtime_error("tan function undefined");
-        }
-        return qTan(radianValue);
+    if (event->matches(QKeySequence::Redo)) {
+        pressKey(calc::Key::Redo);
+        return;
     }
 
-    return 0.0;
-}
-
-// 键盘事件处理
-void MainWindow::keyPressEvent(QKeyEvent* event)
-{
-    switch (event->key()) {
-        // 数字键
-    case Qt::Key_0:
-        digitClicked("0");
-        break;
-    case Qt::Key_1:
-        digitClicked("1");
-        break;
-    case Qt::Key_2:
-        digitClicked("2");
-        break;
-    case Qt::Key_3:
-        digitClicked("3");
-        break;
-    case Qt::Key_4:
-        digitClicked("4");
-        break;
-    case Qt::Key_5:
-        digitClicked("5");
-        break;
-    case Qt::Key_6:
-        digitClicked("6");
-        break;
-    case Qt::Key_7:
-        digitClicked("7");
-        break;
-    case Qt::Key_8:
-        digitClicked("8");
-        break;
-    case Qt::Key_9:
-        digitClicked("9");
-        break;
+    // 直接按 Qt 键码分派，不为每次按键构造字符串
+    const int code = event->key();
+    if (code >= Qt::Key_0 && code <= Qt::Key_9) {
+        pressKey(static_cast<calc::Key>(static_cast<int>(calc::Key::Digit0) + (code - Qt::Key_0)));
+        return;
+    }
 
+    switch (code) {
         // 运算符
     case Qt::Key_Plus:
-        operatorClicked("+");
+        pressKey(calc::Key::Add);
         break;
     case Qt::Key_Minus:
-        operatorClicked("-");
+        pressKey(calc::Key::Subtract);
         break;
     case Qt::Key_Asterisk:
-        operatorClicked("*");
+        pressKey(calc::Key::Multiply);
         break;
     case Qt::Key_Slash:
-        operatorClicked("/");
+        pressKey(calc::Key::Divide);
         break;
     case Qt::Key_Percent:
-        operatorClicked("%");
+        pressKey(calc::Key::Modulo);
+        break;
+    case Qt::Key_AsciiCircum:
+        pressKey(calc::Key::Power);
+        break;
+    case Qt::Key_ParenLeft:
+        pressKey(calc::Key::OpenParen);
+        break;
+    case Qt::Key_ParenRight:
+        pressKey(calc::Key::CloseParen);
         break;
 
         // 功能键
     case Qt::Key_Return:
     case Qt::Key_Enter:
     case Qt::Key_Equal:
-        calculate();
+        pressKey(calc::Key::Equals);
         break;
     case Qt::Key_Period:
     case Qt::Key_Comma:
-        on_pushButton_42_clicked(); // 小数点
+        pressKey(calc::Key::Point);
         break;
     case Qt::Key_Backspace:
-        backspace();
+        pressKey(calc::Key::Backspace);
         break;
     case Qt::Key_Delete:
-        clearEntry();
+        pressKey(calc::Key::ClearEntry);
         break;
     case Qt::Key_Escape:
-        clearAll();
+        pressKey(calc::Key::ClearAll);
         break;
 
     default:
@@ -575,11 +653,14 @@ void MainWindow::keyPressEvent(QKeyEvent* event)
     }
 }
 
-// 设置界面样式
-void MainWindow::setupUIStyles()
+namespace {
+
+// 整个窗口共用的样式表，只在窗口上设置一次：给每个控件单独 setStyleSheet 时
+// 每次都要重新解析 QSS 并 polish 该控件，启动和切换 DPI 都明显变慢。
+// 按键不在这里，由 KeyButton 自己绘制
+const QString& applicationStyleSheet()
 {
-    // 设置整体应用程序样式 - 优雅紫色主题
-    QString mainStyle = R"(
+    static const QString sheet = QStringLiteral(R"(
         QMainWindow {
             background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
                         stop:0 #667eea, stop:1 #764ba2);
@@ -615,342 +696,412 @@ void MainWindow::setupUIStyles()
             padding: 5px 10px;
             margin: 2px;
         }
-    )";
 
-    // 数字按钮样式 - 优雅蓝色渐变
-    QString numberButtonStyle = R"(
-        QPushButton {
-            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
-                        stop:0 #3498db, stop:1 #2980b9);
-            border: 2px solid #2980b9;
-            border-radius: 12px;
-            color: white;
-            font-family: 'Segoe UI', sans-serif;
+        /* 实时预览样式 */
+        QLabel#previewLabel {
+            font-family: 'Consolas', 'Monaco', monospace;
             font-size: 18px;
-            font-weight: bold;
-            min-width: 80px;
-            min-height: 60px;
-        }
-        QPushButton:hover {
-            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
-                        stop:0 #5dade2, stop:1 #3498db);
-            border: 2px solid #3498db;
-            transform: scale(1.05);
-        }
-        QPushButton:pressed {
-            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
-                        stop:0 #2980b9, stop:1 #1f618d);
-            border: 2px solid #1f618d;
+            color: rgba(255, 255, 255, 0.8);
+            background: transparent;
         }
-    )";
 
-    // 运算符按钮样式 - 温暖橙色渐变
-    QString operatorButtonStyle = R"(
-        QPushButton {
-            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
-                        stop:0 #e67e22, stop:1 #d35400);
-            border: 2px solid #d35400;
-            border-radius: 12px;
-            color: white;
-            font-family: 'Segoe UI', sans-serif;
-            font-size: 20px;
-            font-weight: bold;
-            min-width: 80px;
-            min-height: 60px;
-        }
-        QPushButton:hover {
-            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
-                        stop:0 #f39c12, stop:1 #e67e22);
-            border: 2px solid #e67e22;
-            transform: scale(1.05);
-        }
-        QPushButton:pressed {
-            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
-                        stop:0 #d35400, stop:1 #a04000);
-            border: 2px solid #a04000;
-        }
-    )";
-
-    // 功能按钮样式 - 清新绿色渐变
-    QString functionButtonStyle = R"(
-        QPushButton {
-            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
-                        stop:0 #27ae60, stop:1 #229954);
-            border: 2px solid #229954;
-            border-radius: 12px;
+        /* 错误提示条 - 红色半透明 */
+        QLabel#errorBanner {
+            background: rgba(192, 57, 43, 0.92);
+            border: 1px solid #e74c3c;
+            border-radius: 8px;
             color: white;
-            font-family: 'Segoe UI', sans-serif;
-            font-size: 16px;
+            font-size: 14px;
             font-weight: bold;
-            min-width: 80px;
-            min-height: 60px;
-        }
-        QPushButton:hover {
-            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
-                        stop:0 #58d68d, stop:1 #27ae60);
-            border: 2px solid #27ae60;
-            transform: scale(1.05);
+            padding: 6px 12px;
+            margin: 0px;
         }
-        QPushButton:pressed {
-            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
-                        stop:0 #229954, stop:1 #1e8449);
-            border: 2px solid #1e8449;
-        }
-    )";
+    )");
+    return sheet;
+}
 
-    // 等号按钮特殊样式 - 亮丽青色渐变
-    QString equalsButtonStyle = R"(
-        QPushButton {
-            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
-                        stop:0 #1abc9c, stop:1 #16a085);
-            border: 3px solid #16a085;
-            border-radius: 15px;
-            color: white;
-            font-family: 'Segoe UI', sans-serif;
-            font-size: 24px;
-            font-weight: bold;
-            min-width: 80px;
-            min-height: 60px;
-        }
-        QPushButton:hover {
-            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
-                        stop:0 #48c9b0, stop:1 #1abc9c);
-            border: 3px solid #1abc9c;
-            transform: scale(1.08);
-        }
-        QPushButton:pressed {
-            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
-                        stop:0 #16a085, stop:1 #138d75);
-            border: 3px solid #138d75;
-        }
-    )";
-
-    // 应用样式到各个按钮组
-    this->setStyleSheet(mainStyle);
-
-    // 数字按钮 (0-9, .)
-    QList<QPushButton*> numberButtons = {
-        ui->pushButton_43, // 0
-        ui->pushButton_37, ui->pushButton_39, ui->pushButton_38, // 1,2,3
-        ui->pushButton_33, ui->pushButton_35, ui->pushButton_34, // 4,5,6
-        ui->pushButton_28, ui->pushButton_31, ui->pushButton_30, // 7,8,9
-        ui->pushButton_42  // .
-    };
-    for (auto* btn : numberButtons) {
-        btn->setStyleSheet(numberButtonStyle);
-    }
+} // namespace
 
-    // 运算符按钮 (+, -, *, /)
-    QList<QPushButton*> operatorButtons = {
-        ui->pushButton_36, // +
-        ui->pushButton_32, // -
-        ui->pushButton_27, // *
-        ui->pushButton_26  // /
-    };
-    for (auto* btn : operatorButtons) {
-        btn->setStyleSheet(operatorButtonStyle);
-    }
-
-    // 功能按钮 (C, Delete, +/-, 数学函数)
-    QList<QPushButton*> functionButtons = {
-        ui->pushButton_17, // C
-        ui->pushButton_23, // Delete
-        ui->pushButton_41, // +/-
-        ui->pushButton_18, // x²
-        ui->pushButton_20, // √x
-        ui->pushButton_19, // ln
-        ui->pushButton_22, // log
-        ui->pushButton_21  // n!
+// 设置界面样式
+void MainWindow::setupUIStyles()
+{
+    const struct {
+        KeyButton::Role role;
+        QList<KeyButton*> buttons;
+    } groups[] = {
+        // 数字按钮 (0-9, .)
+        { KeyButton::Role::Number,
+          { ui->pushButton_43,                                     // 0
+            ui->pushButton_37, ui->pushButton_39, ui->pushButton_38, // 1,2,3
+            ui->pushButton_33, ui->pushButton_35, ui->pushButton_34, // 4,5,6
+            ui->pushButton_28, ui->pushButton_31, ui->pushButton_30, // 7,8,9
+            ui->pushButton_42 } },                                 // .
+        // 运算符按钮 (+, -, *, /)
+        { KeyButton::Role::Operator,
+          { ui->pushButton_36, ui->pushButton_32, ui->pushButton_27, ui->pushButton_26 } },
+        // 功能按钮 (C, Delete, +/-, x², √x, ln, log, n!)
+        { KeyButton::Role::Function,
+          { ui->pushButton_17, ui->pushButton_23, ui->pushButton_41, ui->pushButton_18,
+            ui->pushButton_20, ui->pushButton_19, ui->pushButton_22, ui->pushButton_21 } },
+        // 内存按钮、历史和绘图
+        { KeyButton::Role::Memory,
+          { ui->pushButton_MC, ui->pushButton_MR, ui->pushButton_M_plus, ui->pushButton_M_minus,
+            ui->pushButton_MS, ui->pushButton_history, ui->pushButton_plot } },
+        // 等号
+        { KeyButton::Role::Equals, { ui->pushButton_40 } },
     };
-    for (auto* btn : functionButtons) {
-        btn->setStyleSheet(functionButtonStyle);
-    }
 
-    // 内存按钮样式 - 紫色主题
-    QString memoryButtonStyle = R"(
-        QPushButton {
-            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
-                        stop:0 #8e44ad, stop:1 #9b59b6);
-            border: 2px solid #8e44ad;
-            border-radius: 8px;
-            color: white;
-            font-family: 'Segoe UI', sans-serif;
-            font-size: 14px;
-            font-weight: bold;
-            min-width: 80px;
-            min-height: 40px;
+    for (const auto& group : groups) {
+        for (KeyButton* btn : group.buttons) {
+            btn->setRole(group.role);
         }
-        QPushButton:hover {
-            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
-                        stop:0 #a569bd, stop:1 #bb8fce);
-            border: 2px solid #9b59b6;
-            transform: scale(1.03);
-        }
-        QPushButton:pressed {
-            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
-                        stop:0 #7d3c98, stop:1 #8e44ad);
-            border: 2px solid #7d3c98;
-        }
-    )";
-
-    // 内存按钮
-    QList<QPushButton*> memoryButtons = {
-        ui->pushButton_MC,      // MC
-        ui->pushButton_MR,      // MR
-        ui->pushButton_M_plus,  // M+
-        ui->pushButton_M_minus, // M-
-        ui->pushButton_MS,      // MS
-        ui->pushButton_history  // 历史
-    };
-    for (auto* btn : memoryButtons) {
-        btn->setStyleSheet(memoryButtonStyle);
     }
-
-    // 等号按钮特殊处理
-    ui->pushButton_40->setStyleSheet(equalsButtonStyle);
+    setStyleSheet(applicationStyleSheet());
 }
 
 // 结果动画效果
 void MainWindow::animateResult()
 {
-    if (displayAnimation && opacityEffect) {
-        displayAnimation->setStartValue(0.3);
-        displayAnimation->setEndValue(1.0);
-        displayAnimation->start();
+    // 连续求值时上一次淡入还没结束，让它继续播完即可，不从头再来，也不叠加新的效果
+    if (displayAnimation->state() == QAbstractAnimation::Running) {
+        return;
     }
+    QGraphicsOpacityEffect* effect = new QGraphicsOpacityEffect(ui->textBrowser);
+    ui->textBrowser->setGraphicsEffect(effect);
+    displayAnimation->setTargetObject(effect);
+    displayAnimation->start();
 }
 
 // 新增功能实现
 void MainWindow::memoryStore()
 {
-    if (!currentNumber.isEmpty()) {
-        memoryValue = currentNumber.toDouble();
-        hasMemoryValue = true;
-        ui->label->setText("💾 已存储到内存: " + formatNumber(memoryValue));
+    cancelEvaluation();
+    engine.memoryStore();
+    if (engine.state().hasMemoryValue) {
+        ui->label->setText("💾 已存储到内存: " + formatNumber(engine.state().memoryValue));
     }
 }
 
 void MainWindow::memoryRecall()
 {
-    if (hasMemoryValue) {
-        currentNumber = formatNumber(memoryValue);
-        waitingForOperand = false;
-        hasResult = true;
-        updateDisplay();
-    }
-    else {
-        showErrorMessage("内存中没有存储值");
+    const calc::ErrorCode error = engine.memoryRecall();
+    if (error != calc::ErrorCode::None) {
+        showErrorMessage(errorMessage(error));
+        return;
     }
+    updateDisplay();
 }
 
 void MainWindow::memoryAdd()
 {
-    if (!currentNumber.isEmpty()) {
-        if (!hasMemoryValue) {
-            memoryValue = 0.0;
-            hasMemoryValue = true;
-        }
-        memoryValue += currentNumber.toDouble();
-        ui->label->setText("💾 内存值已更新: " + formatNumber(memoryValue));
+    cancelEvaluation();
+    engine.memoryAdd();
+    if (engine.state().hasMemoryValue) {
+        ui->label->setText("💾 内存值已更新: " + formatNumber(engine.state().memoryValue));
     }
 }
 
 void MainWindow::memorySubtract()
 {
-    if (!currentNumber.isEmpty()) {
-        if (!hasMemoryValue) {
-            memoryValue = 0.0;
-            hasMemoryValue = true;
-        }
-        memoryValue -= currentNumber.toDouble();
-        ui->label->setText("💾 内存值已更新: " + formatNumber(memoryValue));
+    cancelEvaluation();
+    engine.memorySubtract();
+    if (engine.state().hasMemoryValue) {
+        ui->label->setText("💾 内存值已更新: " + formatNumber(engine.state().memoryValue));
     }
 }
 
 void MainWindow::memoryClear()
 {
-    memoryValue = 0.0;
-    hasMemoryValue = false;
+    cancelEvaluation();
+    engine.memoryClear();
     ui->label->setText("🗑️ 内存已清除");
 }
 
 void MainWindow::toggleAngleUnit()
 {
-    isAngleInDegrees = !isAngleInDegrees;
-    QString unit = isAngleInDegrees ? "度" : "弧度";
+    cancelEvaluation();
+    engine.toggleAngleUnit();
+    QString unit = engine.state().angleInDegrees ? "度" : "弧度";
     ui->label->setText("📐 角度单位: " + unit);
 }
 
 void MainWindow::showHistory()
 {
-    if (calculationHistory.isEmpty()) {
+    if (history.size() == 0) {
         showErrorMessage("计算历史为空");
         return;
     }
 
-    QString historyText = "📊 计算历史记录:\n\n";
-    for (int i = calculationHistory.size() - 1; i >= 0; --i) {
-        historyText += QString("%1. %2\n").arg(calculationHistory.size() - i).arg(calculationHistory[i]);
-    }
+    // 列表视图只请求可见的行，历史再多也不会一次性读入
+    QDialog dialog(this);
+    dialog.setWindowTitle("📊 计算历史");
+    dialog.resize(420, 500);
+
+    HistoryModel model(history);
+    QListView* view = new QListView(&dialog);
+    view->setUniformItemSizes(true);
+    view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    view->setModel(&model);
+
+    // 搜索框：输入即搜索，空串显示全部历史
+    QLineEdit* searchEdit = new QLineEdit(&dialog);
+    searchEdit->setPlaceholderText("🔍 搜索表达式或结果，如 3.3");
+    searchEdit->setClearButtonEnabled(true);
+    QComboBox* modeBox = new QComboBox(&dialog);
+    modeBox->addItem("包含");
+    modeBox->addItem("开头为");
+    auto summary = [this]() {
+        const calc::CacheStats stats = resultCache.stats();
+        return QString("共 %1 条 · 结果缓存命中 %2 次，未命中 %3 次")
+            .arg(history.size()).arg(stats.hits).arg(stats.misses);
+    };
+    QLabel* statusLabel = new QLabel(summary(), &dialog);
+
+    auto search = [&]() {
+        const QByteArray query = searchEdit->text().toUtf8();
+        if (query.isEmpty()) {
+            model.clearMatches();
+            statusLabel->setText(summary());
+            return;
+        }
+        QElapsedTimer timer;
+        timer.start();
+        const calc::MatchMode mode = modeBox->currentIndex() == 1 ? calc::MatchMode::Prefix : calc::MatchMode::Contains;
+        const std::size_t limit = 1000;
+        std::vector<std::uint32_t> ids = historyIndex.search(
+            history, std::string_view(query.constData(), static_cast<std::size_t>(query.size())), mode, limit);
+        const std::size_t found = ids.size();
+        model.setMatches(std::move(ids));
+        QString status = QString("找到 %1%2 条，用时 %3 ms")
+                             .arg(found)
+                             .arg(found == limit ? "+" : "")
+                             .arg(timer.nsecsElapsed() / 1e6, 0, 'f', 2);
+        // 索引还在建立时只搜索已覆盖的部分，建好后会自动重新搜索
+        if (historyIndex.size() < history.size()) {
+            status += QString(" · 索引建立中 %1/%2").arg(historyIndex.size()).arg(history.size());
+        }
+        statusLabel->setText(status);
+    };
+    connect(searchEdit, &QLineEdit::textChanged, &dialog, search);
+    connect(this, &MainWindow::historyIndexed, &dialog, search);
+    // 对话框打开期间算出的结果：全部历史时直接插到最前面，不重置视图；筛选时重新搜索
+    connect(this, &MainWindow::historyAppended, &dialog, [&]() {
+        model.appendRows();
+        if (searchEdit->text().isEmpty()) {
+            statusLabel->setText(summary());
+        }
+        else {
+            search();
+        }
+    });
+    connect(modeBox, qOverload<int>(&QComboBox::currentIndexChanged), &dialog, search);
 
-    QMessageBox msgBox;
-    msgBox.setWindowTitle("📊 计算历史");
-    msgBox.setText(historyText);
-    msgBox.setStyleSheet(R"(
-        QMessageBox {
+    QHBoxLayout* searchLayout = new QHBoxLayout;
+    searchLayout->addWidget(searchEdit);
+    searchLayout->addWidget(modeBox);
+
+    QVBoxLayout* layout = new QVBoxLayout(&dialog);
+    layout->addLayout(searchLayout);
+    layout->addWidget(view);
+    layout->addWidget(statusLabel);
+
+    dialog.setStyleSheet(R"(
+        QDialog {
             background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
                         stop:0 #667eea, stop:1 #764ba2);
+        }
+        QListView {
+            background: transparent;
+            border: none;
             color: white;
             font-family: 'Segoe UI', sans-serif;
             font-size: 12px;
-            min-width: 400px;
         }
-        QMessageBox QPushButton {
-            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
-                        stop:0 #1abc9c, stop:1 #16a085);
-            border: 2px solid #16a085;
-            border-radius: 8px;
-            color: white;
-            font-weight: bold;
-            padding: 8px 16px;
-            min-width: 80px;
+        QListView::item:selected {
+            background: rgba(255, 255, 255, 60);
         }
-        QMessageBox QPushButton:hover {
-            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
-                        stop:0 #48c9b0, stop:1 #1abc9c);
+        QLineEdit, QComboBox {
+            background: rgba(255, 255, 255, 230);
+            border: 1px solid #764ba2;
+            border-radius: 6px;
+            padding: 4px 8px;
+            font-size: 12px;
+        }
+        QLabel {
+            color: white;
+            font-size: 11px;
         }
     )");
-    msgBox.exec();
-}
-
-double MainWindow::calculateFactorial(int n)
-{
-    if (n < 0) return 0;
-    if (n == 0 || n == 1) return 1;
-
-    double result = 1;
-    for (int i = 2; i <= n; ++i) {
-        result *= i;
-    }
-    return result;
-}
-
-double MainWindow::calculateSquareRoot(double x)
-{
-    return qSqrt(x);
+    dialog.exec();
 }
 
-double MainWindow::calculateSquare(double x)
+void MainWindow::showPlot()
 {
-    return x * x;
-}
+    QDialog dialog(this);
+    dialog.setWindowTitle("📈 函数图像");
+    dialog.resize(640, 520);
+
+    QLineEdit* formulaEdit = new QLineEdit("sin(x)", &dialog);
+    formulaEdit->setPlaceholderText("输入含 x 的表达式，如 x^2 - 2");
+    formulaEdit->setClearButtonEnabled(true);
+    QPushButton* integrateButton = new QPushButton("∫ 可见区间", &dialog);
+    QPushButton* solveButton = new QPushButton("求根", &dialog);
+    PlotView* plot = new PlotView(&dialog);
+    QLabel* statusLabel = new QLabel(&dialog);
+
+    // 角度制下默认显示两个周期
+    const bool degrees = engine.state().angleInDegrees;
+    plot->setXRange(degrees ? -360.0 : -10.0, degrees ? 360.0 : 10.0);
+
+    // 采样范围左右各多出一屏，平移时先显示已有的点，新的结果随后替换
+    auto session = std::make_shared<PlotSession>();
+    const QPointer<PlotView> target(plot);
+    const QPointer<QLabel> status(statusLabel);
+    auto resample = [this, session, plot, target, status]() {
+        session->pending.cancel();
+        const quint64 request = ++session->request;
+        if (!session->program.isValid()) {
+            plot->clear();
+            return;
+        }
+        const double span = plot->xMax() - plot->xMin();
+        const double from = plot->xMin() - span;
+        const double to = plot->xMax() + span;
+        const calc::Program program = session->program;
+        session->pending = evalService.submit([session, program, from, to, request, target, status](
+                                                  calc::JobContext& job) {
+            QElapsedTimer timer;
+            timer.start();
+            calc::PlotOptions options;
+            options.initialSamples = 4096;
+            auto samples = std::make_shared<const calc::PlotSamples>(calc::samplePlot(program, from, to, options, &job));
+            if (job.isCancelled()) {
+                return;
+            }
+            const double elapsed = timer.nsecsElapsed() / 1e6;
+            // 对话框可能已经关闭，回到界面线程后再检查控件是否还在
+            QMetaObject::invokeMethod(
+                qApp,
+                [session, samples, request, target, status, elapsed]() {
+                    if (!target || request != session->request) {
+                        return;
+                    }
+                    target->setSamples(samples);
+                    if (session->fitPending) {
+                        session->fitPending = false;
+                        target->fitValues();
+                    }
+                    if (status) {
+                        status->setText(QString("%1 个采样点 · 用时 %2 ms · 滚轮缩放，拖动平移，双击适配纵轴")
+                                            .arg(samples->size())
+                                            .arg(elapsed, 0, 'f', 1));
+                    }
+                },
+                Qt::QueuedConnection);
+        });
+    };
 
-double MainWindow::calculateNaturalLog(double x)
-{
-    return qLn(x);
-}
+    // 积分取可见的 x 范围，求根从视图中心出发，都在后台进行，结果显示在状态栏
+    auto runCalculus = [this, session, plot, status](bool integral) {
+        if (!session->program.isValid()) {
+            return;
+        }
+        session->calculus.cancel();
+        const calc::Program program = session->program;
+        const double from = plot->xMin();
+        const double to = plot->xMax();
+        session->calculus = evalService.submit([program, from, to, integral, status](calc::JobContext& job) {
+            auto number = [](double value) { return QString::fromStdString(calc::formatNumber(value)); };
+            QString text;
+            if (integral) {
+                const calc::IntegralResult result = calc::integrate(program, from, to, calc::IntegrateOptions(), &job);
+                text = QString("∫[%1, %2] f(x) dx = %3%4")
+                           .arg(number(from), number(to), number(result.value),
+                                result.converged ? QString() : QString("（未收敛）"));
+            }
+            else {
+                const calc::SolveResult result = calc::solve(program, 0.5 * (from + to), calc::SolveOptions(), &job);
+                text = result.converged ? QString("f(x) = 0 的根：x = %1").arg(number(result.root))
+                                        : QString("在 %1 附近没有找到根").arg(number(0.5 * (from + to)));
+            }
+            if (job.isCancelled()) {
+                return;
+            }
+            QMetaObject::invokeMethod(
+                qApp,
+                [status, text]() {
+                    if (status) {
+                        status->setText(text);
+                    }
+                },
+                Qt::QueuedConnection);
+        });
+    };
+    connect(integrateButton, &QPushButton::clicked, &dialog, [runCalculus]() { runCalculus(true); });
+    connect(solveButton, &QPushButton::clicked, &dialog, [runCalculus]() { runCalculus(false); });
+
+    auto compileFormula = [this, session, formulaEdit, statusLabel, resample]() {
+        const QByteArray text = formulaEdit->text().toUtf8();
+        const calc::Expression expression =
+            calc::Expression::compile(std::string_view(text.constData(), static_cast<std::size_t>(text.size())));
+        calc::EvalOptions options;
+        options.angleInDegrees = engine.state().angleInDegrees;
+        session->program = expression.isValid() ? calc::Program::compile(expression, options) : calc::Program();
+        session->fitPending = true;
+        if (!expression.isValid()) {
+            statusLabel->setText(QString("❌ %1").arg(calc::describe(expression.parseError())));
+        }
+        resample();
+    };
 
-double MainWindow::calculateLog10(double x)
-{
-    return log10(x);
+    // 平移、缩放时连续触发，合并成一次重新采样
+    QTimer resampleTimer;
+    resampleTimer.setSingleShot(true);
+    resampleTimer.setInterval(30);
+    connect(&resampleTimer, &QTimer::timeout, &dialog, resample);
+    connect(plot, &PlotView::xRangeChanged, &resampleTimer, qOverload<>(&QTimer::start));
+    connect(formulaEdit, &QLineEdit::textChanged, &dialog, compileFormula);
+
+    QHBoxLayout* formulaLayout = new QHBoxLayout;
+    formulaLayout->addWidget(formulaEdit, 1);
+    formulaLayout->addWidget(integrateButton);
+    formulaLayout->addWidget(solveButton);
+
+    QVBoxLayout* layout = new QVBoxLayout(&dialog);
+    layout->addLayout(formulaLayout);
+    layout->addWidget(plot, 1);
+    layout->addWidget(statusLabel);
+
+    dialog.setStyleSheet(R"(
+        QDialog {
+            background: qlineargradient(x1:0, y1:0, x2:1, y2:1,
+                        stop:0 #667eea, stop:1 #764ba2);
+        }
+        QLineEdit {
+            background: rgba(255, 255, 255, 230);
+            border: 1px solid #764ba2;
+            border-radius: 6px;
+            padding: 4px 8px;
+            font-size: 13px;
+        }
+        QPushButton {
+            background: rgba(255, 255, 255, 60);
+            border: 1px solid rgba(255, 255, 255, 120);
+            border-radius: 6px;
+            color: white;
+            padding: 4px 12px;
+            font-size: 13px;
+        }
+        QPushButton:hover {
+            background: rgba(255, 255, 255, 90);
+        }
+        QLabel {
+            color: white;
+            font-size: 11px;
+        }
+    )");
+    compileFormula();
+    dialog.exec();
+    session->pending.cancel();
+    session->calculus.cancel();
 }
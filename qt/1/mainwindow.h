@@ -7,7 +7,30 @@
 #include <QKeyEvent>
 #include <QStringList>
 #include <QPropertyAnimation>
-#include <QGraphicsOpacityEffect>
+#include <QTimer>
+#include <QLabel>
+#include <QElapsedTimer>
+#include <deque>
+#include "engine/calculatorengine.h"
+#include "engine/evalservice.h"
+#include "engine/historyindex.h"
+#include "engine/historylog.h"
+#include "engine/incremental.h"
+#include "engine/keytrace.h"
+#include "engine/latencytrace.h"
+#include "engine/resultcache.h"
+
+class ErrorBanner;
+
+// 后台求值的结果，由工作线程通过 queued 信号送回界面线程
+struct EvalOutcome {
+    calc::CalculatorState state;                     // 求值之后的引擎状态
+    calc::ErrorCode error = calc::ErrorCode::None;
+    std::string entry;                               // 历史记录条目，为空表示不写入
+    bool isFunction = false;                         // 是否来自一元函数按钮
+    calc::OpCode function = calc::OpCode::PushConst;
+};
+Q_DECLARE_METATYPE(EvalOutcome)
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -23,6 +46,19 @@ public:
     MainWindow(QWidget* parent = nullptr);
     ~MainWindow();
 
+    // 按钮和键盘共用的按键入口，回放录制的按键时也从这里进入
+    void pressKey(calc::Key key);
+    // 是否有后台求值尚未返回；返回之前按下的键在排队，回放时据此等待按键处理完
+    bool isEvaluating() const;
+
+    // 把之后的每次按键录制到 path（calc::KeyTraceWriter 格式），供 calc-replay 回放
+    bool startRecording(const QString& path);
+
+    // 报告按键、显示更新的时间，用于测量按键到画面的延迟；传 nullptr 停止报告
+    void setLatencyTrace(calc::LatencyTrace* trace);
+    // 显示器的绘制区域，事件分发层据此识别显示器的 Paint 事件
+    QWidget* displayViewport() const;
+
 private slots:
     // 数字按钮
     void on_pushButton_28_clicked(); // 7
@@ -56,42 +92,66 @@ private slots:
     void on_pushButton_22_clicked(); // cos
     void on_pushButton_21_clicked(); // tan
 
+signals:
+    // 由工作线程发出，以 Qt::QueuedConnection 投递到界面线程
+    void evaluationFinished(quint64 generation, const EvalOutcome& outcome);
+    void evaluationProgress(quint64 generation, double fraction);
+    // 历史日志追加了一条记录
+    void historyAppended();
+    // 历史索引已覆盖全部记录
+    void historyIndexed();
+
 protected:
     void keyPressEvent(QKeyEvent* event) override;
 
 private:
     Ui::MainWindow* ui;
-    QString currentNumber;      // 当前输入的数字
-    QString displayText;        // 显示在屏幕上的完整表达式
-    QString lastOperator;       // 最后一个运算符
-    double lastResult;          // 最后的计算结果
-    bool waitingForOperand;     // 是否等待新的操作数
-    bool hasResult;             // 是否已有结果
-    QStringList calculationHistory; // 计算历史记录
-    bool isAngleInDegrees;      // 角度单位：true为度，false为弧度
-    QPropertyAnimation* displayAnimation; // 显示动画
-    QGraphicsOpacityEffect* opacityEffect; // 透明度效果
-
-    // 新增功能变量
-    double memoryValue;         // 内存存储值
-    bool hasMemoryValue;        // 是否有内存值
-    int parenthesesCount;       // 括号计数器
+    calc::CalculatorEngine engine;  // 与界面无关的计算核心，持有全部输入状态
+    calc::HistoryLog history;       // 持久化的计算历史记录
+    calc::HistoryIndex historyIndex; // 历史搜索索引，启动后在空闲时分批建立，之后随追加增量更新
+    QTimer* historyIndexTimer;      // 分批建立历史索引的定时器，跟上之后停止
+    calc::ResultCache resultCache;  // 表达式及其子式的结果缓存，各求值线程共享
+    QString lastHistoryEntry;       // 最近一条历史，用于标签显示
+    QLabel* previewLabel;           // 显示器下方的实时预览
+    ErrorBanner* errorBanner;       // 显示器底部的错误提示条，代替弹出对话框
+    calc::IncrementalEvaluator preview; // 预览求值器，每次按键只处理表达式末尾
+    QPropertyAnimation* displayAnimation; // 显示器淡入动画，只在播放期间挂透明度效果
+    calc::EvalService evalService;  // 后台求值线程池
+    calc::CancelToken pendingEvaluation; // 正在进行的求值
+    quint64 inputGeneration;        // 每次输入变化递增，用于丢弃过期的求值结果
+    bool evaluating;                // 是否有求值尚未返回
+    QElapsedTimer evaluationClock;  // 最近一次求值提交以来的时间
+    std::deque<calc::Key> queuedKeys; // 等待求值结果期间按下、尚未处理的键
+    QTimer* exactStreamTimer;       // 分帧写入大整数结果的定时器
+    std::shared_ptr<const calc::BigInt> exactStream; // 正在显示的大整数
+    std::size_t exactStreamed;      // 已写入的字数（每字 9 位十进制）
+    calc::KeyTraceWriter keyTrace;  // 按键录制，未开始录制时不写任何东西
+    calc::LatencyTrace* latencyTrace; // 延迟测量，为空时不记录
 
     // 辅助函数
-    void digitClicked(const QString& digit);
-    void operatorClicked(const QString& op);
+    void dispatchKey(calc::Key key);  // pressKey 去掉录制和计时之后的部分，排队的按键从这里重放
     void calculate();
+    void finishCalculation(calc::ErrorCode error, const std::string& entry);
+    // 在引擎状态的副本上后台执行 operation，完成后由 onEvaluationFinished 应用结果
+    using EvalOperation = std::function<calc::ErrorCode(calc::CalculatorEngine&, std::string&, calc::JobContext&)>;
+    void evaluateAsync(EvalOperation operation, bool isFunction = false,
+                       calc::OpCode function = calc::OpCode::PushConst);
+    void onEvaluationFinished(quint64 generation, const EvalOutcome& outcome);
+    void applyEvaluation(const EvalOutcome& outcome);
+    void onEvaluationProgress(quint64 generation, double fraction);
+    void cancelEvaluation();    // 取消进行中的求值并作废其结果
+    void applyFunction(calc::OpCode function);
     void updateDisplay();
+    void updatePreview();
+    void startExactStream();    // 开始分帧显示大整数结果
+    void appendExactChunk();    // 写入下一段数字
     void clearAll();
-    void clearEntry();
-    void backspace();
-    double evaluateExpression(const QString& expression);
-    int precedence(const QString& op);
-    bool isOperator(const QString& str);
+    void pasteExpression();     // 粘贴并计算整条公式
     QString formatNumber(double number);
-    void addToHistory(const QString& calculation);
+    QString errorMessage(calc::ErrorCode error);
+    void addToHistory(const QString& calculation, double result);
+    void indexHistoryBatch();   // 给历史索引补进一批记录
     void showErrorMessage(const QString& message);
-    double performTrigFunction(double value, const QString& function);
     void setupUIStyles(); // 设置界面样式
     void animateResult(); // 结果动画效果
 
@@ -103,10 +163,6 @@ private:
     void memoryClear();         // 清除内存
     void toggleAngleUnit();     // 切换角度单位
     void showHistory();         // 显示历史记录
-    double calculateFactorial(int n);  // 计算阶乘
-    double calculateSquareRoot(double x); // 计算平方根
-    double calculateSquare(double x);     // 计算平方
-    double calculateNaturalLog(double x); // 计算自然对数
-    double calculateLog10(double x);      // 计算常用对数
+    void showPlot();            // 显示函数图像
 };
 #endif // MAINWINDOW_H
@@ -0,0 +1,239 @@
+#include "plotview.h"
+
+#include <QMouseEvent>
+#include <QPainter>
+#include <QPen>
+#include <QWheelEvent>
+#include <algorithm>
+#include <cmath>
+#include "engine/numberformat.h"
+
+namespace {
+
+constexpr int kGridSpacing = 80;         // 网格线之间的最小像素间距
+constexpr double kZoomStep = 0.85;       // 滚轮每格的缩放比例
+constexpr double kFitMargin = 0.05;      // 适配纵轴时上下各留的比例
+constexpr double kMinimumSpan = 1e-12;   // 相对于坐标量级的最小跨度，再放大就只剩舍入噪声
+constexpr double kMaximumSpan = 1e12;
+
+// 不小于 span * spacing / pixels 的 1、2、5 × 10^k
+double niceStep(double span, int pixels, int spacing)
+{
+    const double raw = span * spacing / std::max(pixels, 1);
+    const double magnitude = std::pow(10.0, std::floor(std::log10(raw)));
+    for (const double multiple : {1.0, 2.0, 5.0}) {
+        if (multiple * magnitude >= raw) {
+            return multiple * magnitude;
+        }
+    }
+    return 10.0 * magnitude;
+}
+
+QString tickLabel(double value, double step)
+{
+    char buffer[calc::kNumberBufferSize];
+    // 刻度值是 step 的整数倍，比 step 小得多的部分只是累积的舍入
+    const std::size_t length = calc::formatNumber(value, buffer, step * 1e-6);
+    return QString::fromLatin1(buffer, static_cast<int>(length));
+}
+
+bool acceptableSpan(double low, double high)
+{
+    const double span = high - low;
+    const double magnitude = std::max({std::fabs(low), std::fabs(high), 1.0});
+    return std::isfinite(span) && span > kMinimumSpan * magnitude && span < kMaximumSpan;
+}
+
+} // namespace
+
+PlotView::PlotView(QWidget* parent)
+    : QWidget(parent)
+    , dragging(false)
+{
+    setMinimumSize(200, 150);
+    setCursor(Qt::OpenHandCursor);
+}
+
+void PlotView::setSamples(std::shared_ptr<const calc::PlotSamples> samples)
+{
+    this->samples = std::move(samples);
+    update();
+}
+
+void PlotView::clear()
+{
+    samples.reset();
+    update();
+}
+
+void PlotView::setXRange(double xMin, double xMax)
+{
+    if (!acceptableSpan(xMin, xMax)) {
+        return;
+    }
+    range.xMin = xMin;
+    range.xMax = xMax;
+    update();
+    emit xRangeChanged(xMin, xMax);
+}
+
+void PlotView::fitValues()
+{
+    double low = 0.0;
+    double high = 0.0;
+    if (!samples || !calc::plotValueRange(*samples, range.xMin, range.xMax, low, high)) {
+        return;
+    }
+    const double margin = (high - low) * kFitMargin;
+    if (acceptableSpan(low - margin, high + margin)) {
+        range.yMin = low - margin;
+        range.yMax = high + margin;
+        update();
+    }
+}
+
+calc::PlotViewport PlotView::viewport() const
+{
+    calc::PlotViewport view = range;
+    view.width = width();
+    view.height = height();
+    return view;
+}
+
+void PlotView::paintEvent(QPaintEvent*)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), QColor(0xfa, 0xfa, 0xfc));
+    const calc::PlotViewport view = viewport();
+    drawGrid(painter, view);
+    drawCurve(painter, view);
+}
+
+void PlotView::drawGrid(QPainter& painter, const calc::PlotViewport& view)
+{
+    const double sx = view.width / (view.xMax - view.xMin);
+    const double sy = view.height / (view.yMax - view.yMin);
+    const double xStep = niceStep(view.xMax - view.xMin, view.width, kGridSpacing);
+    const double yStep = niceStep(view.yMax - view.yMin, view.height, kGridSpacing);
+
+    QFont font = painter.font();
+    font.setPixelSize(11);
+    painter.setFont(font);
+    const QPen gridPen(QColor(0xe3, 0xe3, 0xea), 1);
+    const QPen labelPen(QColor(0x70, 0x70, 0x80));
+
+    for (double k = std::ceil(view.xMin / xStep); k * xStep <= view.xMax; k += 1.0) {
+        const double x = (k * xStep - view.xMin) * sx;
+        painter.setPen(gridPen);
+        painter.drawLine(QPointF(x, 0), QPointF(x, view.height));
+        painter.setPen(labelPen);
+        painter.drawText(QPointF(x + 3, view.height - 4), tickLabel(k * xStep, xStep));
+    }
+    for (double k = std::ceil(view.yMin / yStep); k * yStep <= view.yMax; k += 1.0) {
+        const double y = (view.yMax - k * yStep) * sy;
+        painter.setPen(gridPen);
+        painter.drawLine(QPointF(0, y), QPointF(view.width, y));
+        painter.setPen(labelPen);
+        painter.drawText(QPointF(3, y - 3), tickLabel(k * yStep, yStep));
+    }
+
+    // 坐标轴在可见时画得更深
+    painter.setPen(QPen(QColor(0x50, 0x50, 0x60), 1));
+    if (view.xMin <= 0.0 && 0.0 <= view.xMax) {
+        const double x = -view.xMin * sx;
+        painter.drawLine(QPointF(x, 0), QPointF(x, view.height));
+    }
+    if (view.yMin <= 0.0 && 0.0 <= view.yMax) {
+        const double y = view.yMax * sy;
+        painter.drawLine(QPointF(0, y), QPointF(view.width, y));
+    }
+}
+
+void PlotView::drawCurve(QPainter& painter, const calc::PlotViewport& view)
+{
+    if (!samples) {
+        return;
+    }
+    calc::decimatePlot(*samples, view, points);
+
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(QPen(QColor(0x76, 0x4b, 0xa2), 2));
+    // NaN 点把折线分成几段，分别绘制
+    polyline.clear();
+    auto flush = [&]() {
+        if (polyline.size() > 1) {
+            painter.drawPolyline(polyline);
+        }
+        else if (polyline.size() == 1) {
+            painter.drawPoint(polyline.front());
+        }
+        polyline.clear();
+    };
+    for (const calc::PlotPoint& point : points) {
+        if (std::isnan(point.x)) {
+            flush();
+        }
+        else {
+            polyline.append(QPointF(point.x, point.y));
+        }
+    }
+    flush();
+}
+
+void PlotView::wheelEvent(QWheelEvent* event)
+{
+    const double factor = std::pow(kZoomStep, event->angleDelta().y() / 120.0);
+    const QPointF position = event->position();
+    // 光标所在的坐标保持不动
+    const double cx = range.xMin + (range.xMax - range.xMin) * position.x() / std::max(width(), 1);
+    const double cy = range.yMax - (range.yMax - range.yMin) * position.y() / std::max(height(), 1);
+    const double xMin = cx - (cx - range.xMin) * factor;
+    const double xMax = cx + (range.xMax - cx) * factor;
+    const double yMin = cy - (cy - range.yMin) * factor;
+    const double yMax = cy + (range.yMax - cy) * factor;
+    if (!acceptableSpan(xMin, xMax) || !acceptableSpan(yMin, yMax)) {
+        return;
+    }
+    range.yMin = yMin;
+    range.yMax = yMax;
+    setXRange(xMin, xMax);
+    event->accept();
+}
+
+void PlotView::mousePressEvent(QMouseEvent* event)
+{
+    if (event->button() != Qt::LeftButton) {
+        QWidget::mousePressEvent(event);
+        return;
+    }
+    dragging = true;
+    dragOrigin = event->pos();
+    dragRange = range;
+    setCursor(Qt::ClosedHandCursor);
+}
+
+void PlotView::mouseMoveEvent(QMouseEvent* event)
+{
+    if (!dragging) {
+        return;
+    }
+    const QPoint delta = event->pos() - dragOrigin;
+    const double dx = delta.x() * (dragRange.xMax - dragRange.xMin) / std::max(width(), 1);
+    const double dy = delta.y() * (dragRange.yMax - dragRange.yMin) / std::max(height(), 1);
+    range.yMin = dragRange.yMin + dy;
+    range.yMax = dragRange.yMax + dy;
+    setXRange(dragRange.xMin - dx, dragRange.xMax - dx);
+}
+
+void PlotView::mouseReleaseEvent(QMouseEvent* event)
+{
+    if (event->button() == Qt::LeftButton) {
+        dragging = false;
+        setCursor(Qt::OpenHandCursor);
+    }
+}
+
+void PlotView::mouseDoubleClickEvent(QMouseEvent*)
+{
+    fitValues();
+}
@@ -0,0 +1,58 @@
+#ifndef PLOTVIEW_H
+#define PLOTVIEW_H
+
+#include <QPoint>
+#include <QPolygonF>
+#include <QWidget>
+#include <memory>
+#include <vector>
+#include "engine/plot.h"
+
+// 函数图像。每次绘制都把采样点按像素列 min/max 抽稀（calc::decimatePlot），
+// 交给 QPainter 的点数只与控件宽度有关，千万个采样点也能流畅平移、缩放。
+// 滚轮以光标为中心缩放，左键拖动平移，双击让纵轴适配可见的曲线。
+// 本控件只负责显示，横向范围改变后由调用方重新采样并调用 setSamples
+class PlotView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit PlotView(QWidget* parent = nullptr);
+
+    // 采样的横向范围可以比视图宽，平移时先显示已有的部分
+    void setSamples(std::shared_ptr<const calc::PlotSamples> samples);
+    void clear();
+
+    double xMin() const { return range.xMin; }
+    double xMax() const { return range.xMax; }
+    void setXRange(double xMin, double xMax);
+    // 纵轴适配可见范围内的曲线，上下各留一点边距
+    void fitValues();
+
+signals:
+    // 平移或缩放改变了横向范围
+    void xRangeChanged(double xMin, double xMax);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void wheelEvent(QWheelEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+    void mouseReleaseEvent(QMouseEvent* event) override;
+    void mouseDoubleClickEvent(QMouseEvent* event) override;
+
+private:
+    calc::PlotViewport viewport() const;
+    void drawGrid(QPainter& painter, const calc::PlotViewport& view);
+    void drawCurve(QPainter& painter, const calc::PlotViewport& view);
+
+    std::shared_ptr<const calc::PlotSamples> samples;
+    calc::PlotViewport range;              // 只用其中的坐标范围，像素尺寸取控件当前大小
+    std::vector<calc::PlotPoint> points;   // 抽稀结果，每帧复用
+    QPolygonF polyline;                    // 一段连续折线，每帧复用
+    bool dragging;
+    QPoint dragOrigin;
+    calc::PlotViewport dragRange;          // 开始拖动时的范围
+};
+
+#endif // PLOTVIEW_H
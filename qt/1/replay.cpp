@@ -0,0 +1,163 @@
+// calc-replay：无界面回放录制的按键，测量每次按键的界面响应时间
+//
+// 用法: calc-replay [--repeat 次数] [--realtime] [--max-p99 微秒] [--trace 文件 [--stall-budget 毫秒]] 录制文件...
+// 录制文件由 "1 --record <文件>" 生成。每个按键经 MainWindow::pressKey 进入引擎，
+// 随后处理事件循环直到后台求值返回、界面刷新完成，两者合计作为一次按键的耗时。
+// 默认使用 offscreen 平台，不需要显示器；--realtime 按录制时的间隔回放，等待期间照常处理事件。
+// 指定 --max-p99 时 p99 超过该值以退出码 1 结束，可以接到 CI 中做性能回归检查。
+// 指定 --trace 时另外测量按键到显示器绘制完成的延迟和事件循环卡顿，写出 Chrome trace 并打印直方图。
+
+#include "mainwindow.h"
+#include "tracedapplication.h"
+#include "engine/keytrace.h"
+#include "engine/latencytrace.h"
+#include "engine/samplestats.h"
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QStandardPaths>
+#include <QTimer>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+    int repeat = 1;
+    bool realtime = false;
+    double maxP99 = 0.0;  // 微秒，0 表示不检查
+    std::string tracePath;
+    double stallBudget = 50.0;  // 毫秒
+    std::vector<std::string> paths;
+};
+
+void usage()
+{
+    std::fprintf(stderr,
+                 "usage: calc-replay [--repeat n] [--realtime] [--max-p99 us] [--trace file [--stall-budget ms]] "
+                 "trace...\n");
+}
+
+bool parseArguments(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            options.repeat = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--realtime") == 0) {
+            options.realtime = true;
+        }
+        else if (std::strcmp(argv[i], "--max-p99") == 0 && i + 1 < argc) {
+            options.maxP99 = std::strtod(argv[++i], nullptr);
+        }
+        else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            options.tracePath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--stall-budget") == 0 && i + 1 < argc) {
+            options.stallBudget = std::strtod(argv[++i], nullptr);
+        }
+        else if (argv[i][0] == '-') {
+            return false;
+        }
+        else {
+            options.paths.emplace_back(argv[i]);
+        }
+    }
+    return options.repeat > 0 && !options.paths.empty();
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    // 没有显示器的构建机上也能运行
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    // 历史记录写到测试目录，不污染真实数据
+    QStandardPaths::setTestModeEnabled(true);
+    std::unique_ptr<calc::LatencyTrace> latencyTrace;  // 要比 app 活得久
+    TracedApplication app(argc, argv);
+
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    std::vector<calc::KeyEvent> events;
+    for (const std::string& path : options.paths) {
+        std::vector<calc::KeyEvent> trace;
+        std::string error;
+        if (!calc::readKeyTrace(path, trace, &error)) {
+            std::fprintf(stderr, "calc-replay: %s\n", error.c_str());
+            return 1;
+        }
+        events.insert(events.end(), trace.begin(), trace.end());
+    }
+    if (events.empty()) {
+        std::fprintf(stderr, "calc-replay: no key events\n");
+        return 1;
+    }
+
+    MainWindow window;
+    if (!options.tracePath.empty()) {
+        latencyTrace = std::make_unique<calc::LatencyTrace>(
+            static_cast<calc::LatencyTrace::Micros>(options.stallBudget * 1000));
+        app.startTrace(latencyTrace.get(), window.displayViewport());
+        window.setLatencyTrace(latencyTrace.get());
+    }
+    window.show();
+    QCoreApplication::processEvents();
+
+    std::vector<double> latencies;
+    latencies.reserve(events.size() * static_cast<std::size_t>(options.repeat));
+    QElapsedTimer total;
+    total.start();
+    for (int round = 0; round < options.repeat; ++round) {
+        for (const calc::KeyEvent& event : events) {
+            if (options.realtime && event.delayMicros > 0) {
+                // 像真实用户一样在按键间隔里让事件循环继续跑，不能睡眠阻塞结果的投递
+                QEventLoop pause;
+                QTimer::singleShot(static_cast<int>((event.delayMicros + 500) / 1000), Qt::PreciseTimer, &pause,
+                                   &QEventLoop::quit);
+                pause.exec();
+            }
+            QElapsedTimer timer;
+            timer.start();
+            window.pressKey(event.key);
+            // 求值结果从后台线程投递回来，等它返回、排队的按键处理完，再把重绘一并计入
+            while (window.isEvaluating()) {
+                QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+            }
+            QCoreApplication::processEvents();
+            latencies.push_back(timer.nsecsElapsed() / 1000.0);
+        }
+    }
+    const double seconds = total.nsecsElapsed() / 1e9;
+
+    const calc::SampleStats stats = calc::summarizeSamples(latencies);
+    std::printf("events            %zu x %d\n", events.size(), options.repeat);
+    std::printf("total             %.3f s\n", seconds);
+    std::printf("per event (us)    mean %.1f  p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+                stats.mean, stats.p50, stats.p90, stats.p99, stats.p999, stats.max);
+    if (latencyTrace) {
+        std::string error;
+        if (!latencyTrace->writeChromeTrace(options.tracePath, &error)) {
+            std::fprintf(stderr, "calc-replay: %s\n", error.c_str());
+            return 1;
+        }
+        std::printf("\n%s", latencyTrace->summary().c_str());
+    }
+    if (options.maxP99 > 0.0 && stats.p99 > options.maxP99) {
+        std::fprintf(stderr, "calc-replay: p99 %.1f us exceeds %.1f us\n", stats.p99, options.maxP99);
+        return 1;
+    }
+    return 0;
+}
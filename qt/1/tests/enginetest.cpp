@@ -0,0 +1,105 @@
+// calc-enginetest：计算引擎的回归测试
+//
+// 用法: calc-enginetest
+// 每个用例用 calc::keyFromChar 的单字符记法写一串按键，逐个交给 CalculatorEngine::press，
+// 再核对最后一次求值写出的历史记录（表达式 = 结果）；另有直接调用各求值路径、核对结果一致的用例。
+// 有用例失败时以退出码 1 结束。
+
+#include "calculatorengine.h"
+#include "precise.h"
+#include "vectoreval.h"
+
+#include <cmath>
+#include <cstdio>
+#include <optional>
+#include <string>
+
+namespace {
+
+int failures = 0;
+
+// 按下 keys 里的全部按键，返回最后一次求值的历史记录
+std::string pressKeys(const char* keys)
+{
+    calc::CalculatorEngine engine;
+    std::string history;
+    for (const char* p = keys; *p; ++p) {
+        if (std::optional<calc::Key> key = calc::keyFromChar(*p)) {
+            engine.press(*key, &history);
+        }
+    }
+    return history;
+}
+
+void expectHistory(const char* keys, const char* expected)
+{
+    const std::string history = pressKeys(keys);
+    if (history != expected) {
+        std::printf("FAIL %s: expected \"%s\", got \"%s\"\n", keys, expected, history.c_str());
+        ++failures;
+    }
+}
+
+// 括号前后省略的乘号，以及刚闭合括号后的退格、清除输入和读取内存
+void testParentheses()
+{
+    expectHistory("(2)5=", "( 2 ) * 5 = 10");
+    expectHistory("5(2+3)=", "5 * ( 2 + 3 ) = 25");
+    expectHistory("2(3)=", "2 * ( 3 ) = 6");
+    expectHistory("(2)(3)=", "( 2 ) * ( 3 ) = 6");
+    expectHistory("(2+3)<=", "( 2 + 3 ) = 5");
+    expectHistory("(2+3)<5=", "( 2 + 35 ) = 37");
+    expectHistory("((2))<<3=", "( ( 23 ) ) = 23");
+    expectHistory("(2+3)e5=", "( 2 + 3 ) * 5 = 25");
+    expectHistory("(2+3)e+1=", "( 2 + 3 ) + 1 = 6");
+    expectHistory("2M(2+3)R=", "2 * ( 2 + 3 ) * 2 = 20");
+    expectHistory("2Mc1+R+3=", "1 + 2 + 3 = 6");
+}
+
+void expect(bool condition, const char* what)
+{
+    if (!condition) {
+        std::printf("FAIL %s\n", what);
+        ++failures;
+    }
+}
+
+// "=" 的精确求值、实时预览的解释器、字节码和各级 SIMD 列求值对很小的除数判断一致
+void testZeroDivisor()
+{
+    const calc::Expression divide = calc::Expression::compile("1 / x");
+    const calc::Program program = calc::Program::compile(divide);
+    const double divisors[] = { 1e-11, -1e-11, 0.0, 1e-9, -1e-9 };
+    for (const double x : divisors) {
+        calc::EvalOptions options;
+        options.x = x;
+        const bool zero = calc::isZeroDivisor(x);
+        expect(std::isinf(divide.evaluate(options)) == zero, "Expression::evaluate");
+        expect(std::isinf(program.run(x)) == zero, "Program::run");
+        expect(std::isinf(calc::evaluatePrecise(divide, options).value) == zero, "evaluatePrecise");
+        for (int level = 0; level <= static_cast<int>(calc::detectSimdLevel()); ++level) {
+            double result = 0.0;
+            calc::evaluateColumn(program, &x, &result, 1, static_cast<calc::SimdLevel>(level));
+            expect(std::isinf(result) == zero, calc::toString(static_cast<calc::SimdLevel>(level)));
+        }
+    }
+
+    calc::CalculatorEngine engine;
+    expect(engine.pasteExpression("1 / 1e-11") == calc::ErrorCode::DivisionByZero, "1 / 1e-11 =");
+    expect(engine.pasteExpression("1 % 1e-11") == calc::ErrorCode::DivisionByZero, "1 % 1e-11 =");
+    expect(engine.pasteExpression("1 / 1e-9") == calc::ErrorCode::None, "1 / 1e-9 =");
+}
+
+} // namespace
+
+int main()
+{
+    testParentheses();
+    testZeroDivisor();
+    if (failures > 0) {
+        std::printf("%d failed\n", failures);
+        return 1;
+    }
+    std::printf("all passed\n");
+    return 0;
+}
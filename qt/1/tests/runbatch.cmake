@@ -0,0 +1,14 @@
+# 用 calc-batch 求值 INPUT，核对标准输出与 EXPECTED 一致、退出码为 EXIT_CODE
+# 用法: cmake -DBATCH=... -DINPUT=... -DEXPECTED=... -DEXIT_CODE=... -P runbatch.cmake
+execute_process(
+    COMMAND ${BATCH} -q ${INPUT}
+    OUTPUT_VARIABLE output
+    RESULT_VARIABLE result
+)
+file(READ ${EXPECTED} expected)
+if(NOT output STREQUAL expected)
+    message(FATAL_ERROR "calc-batch output differs:\n${output}\nexpected:\n${expected}")
+endif()
+if(NOT result EQUAL EXIT_CODE)
+    message(FATAL_ERROR "calc-batch exited with ${result}, expected ${EXIT_CODE}")
+endif()
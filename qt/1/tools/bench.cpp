@@ -0,0 +1,323 @@
+// calc-bench：计算引擎热点路径的基准套件
+//
+// 用法: calc-bench [--filter 子串] [--samples n] [--warmup 秒] [--json 文件|-] [--baseline 文件]
+// 覆盖表达式编译与求值、结果格式化、逐键输入、三角函数、阶乘、函数图像、积分与求根。每项先预热再重复采样，
+// 报告每次操作耗时的中位数和离散程度；--json 保存结果，--baseline 与之前保存的结果对比。
+// 构建目录中执行 "cmake --build . --target bench" 会运行全部基准并写出 bench.json。
+
+#include "benchmark.h"
+
+#include "bigint.h"
+#include "calculatorengine.h"
+#include "expression.h"
+#include "numberformat.h"
+#include "numeric.h"
+#include "plot.h"
+#include "precise.h"
+#include "program.h"
+#include "resultcache.h"
+#include "trig.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+void usage()
+{
+    std::fprintf(stderr, "usage: calc-bench %s\n", bench::kOptionsUsage);
+}
+
+bool parseArguments(int argc, char* argv[], bench::Options& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        if (!bench::parseOption(argc, argv, i, options)) {
+            return false;
+        }
+    }
+    return options.settings.samples > 1;
+}
+
+// 典型的按键式表达式和一条较长的公式
+const char* const kShortExpression = "12.5 * 3 + 4 / 2 - 7";
+const char* const kScientificExpression = "sin(30) + cos(60) * sqrt(2) ^ 3 - ln(10) / log(100) + 5!";
+
+std::string longExpression()
+{
+    std::mt19937 rng(7);
+    std::string text;
+    for (int i = 0; i < 2000; ++i) {
+        text += std::to_string(rng() % 1000);
+        text += " +-*/"[1 + rng() % 4];
+        text += ' ';
+    }
+    text += "1";
+    return text;
+}
+
+void benchExpressions(bench::Runner& runner)
+{
+    const calc::EvalOptions options;
+    const std::string longText = longExpression();
+
+    runner.run("expression/compile short", [](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            bench::doNotOptimize(calc::Expression::compile(kShortExpression));
+        }
+    });
+    runner.run("expression/compile scientific", [](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            bench::doNotOptimize(calc::Expression::compile(kScientificExpression));
+        }
+    });
+    runner.run("expression/compile 8k chars", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            bench::doNotOptimize(calc::Expression::compile(longText));
+        }
+    });
+
+    const calc::Expression scientific = calc::Expression::compile(kScientificExpression);
+    runner.run("expression/evaluate scientific", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            bench::doNotOptimize(scientific.evaluate(options));
+        }
+    });
+    runner.run("expression/evaluatePrecise", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            bench::doNotOptimize(calc::evaluatePrecise(scientific, options).value);
+        }
+    });
+
+    const calc::Program program = calc::Program::compile(scientific, options);
+    runner.run("program/run scientific", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            bench::doNotOptimize(program.run());
+        }
+    });
+
+    calc::ResultCache cache(1024);
+    runner.run("cache/evaluateCached hit", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            bench::doNotOptimize(calc::evaluateCached(scientific, options, cache));
+        }
+    });
+}
+
+void benchFormat(bench::Runner& runner)
+{
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> uniform(-1e6, 1e6);
+    std::vector<double> values(4096);
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        // 整数、两位小数、舍入误差和科学计数法轮流出现
+        switch (i % 4) {
+        case 0: values[i] = std::round(uniform(rng)); break;
+        case 1: values[i] = std::round(uniform(rng) * 100) / 100; break;
+        case 2: values[i] = uniform(rng) / 3; break;
+        default: values[i] = uniform(rng) * 1e12; break;
+        }
+    }
+
+    runner.run("format/formatNumber buffer", [&](std::size_t n) {
+        char buffer[calc::kNumberBufferSize];
+        for (std::size_t i = 0; i < n; ++i) {
+            bench::doNotOptimize(calc::formatNumber(values[i % values.size()], buffer));
+        }
+    });
+    runner.run("format/formatNumber string", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            bench::doNotOptimize(calc::formatNumber(values[i % values.size()]));
+        }
+    });
+}
+
+void benchInput(bench::Runner& runner)
+{
+    // 每次操作是一个按键；数字输满 12 位后清除当前输入重来
+    runner.run("input/digit keys", [](std::size_t n) {
+        calc::CalculatorEngine engine;
+        for (std::size_t i = 0; i < n; ++i) {
+            const std::size_t k = i % 13;
+            engine.press(k == 12 ? calc::Key::ClearEntry : static_cast<calc::Key>(1 + k % 9));
+        }
+        bench::doNotOptimize(engine.state().currentNumber.size());
+    });
+
+    // "123 + " 这样数字与运算符交替，表达式不断变长，每 400 键全部清除
+    runner.run("input/typing formula", [](std::size_t n) {
+        static const calc::Key kPattern[] = { calc::Key::Digit1, calc::Key::Digit2, calc::Key::Digit3, calc::Key::Add,
+                                              calc::Key::Digit4, calc::Key::Point,  calc::Key::Digit5, calc::Key::Multiply };
+        calc::CalculatorEngine engine;
+        for (std::size_t i = 0; i < n; ++i) {
+            engine.press(i % 400 == 399 ? calc::Key::ClearAll : kPattern[i % 8]);
+        }
+        bench::doNotOptimize(engine.state().displayText.size());
+    });
+
+    runner.run("input/equals short", [](std::size_t n) {
+        static const calc::Key kKeys[] = { calc::Key::Digit1, calc::Key::Digit2, calc::Key::Add,
+                                           calc::Key::Digit3, calc::Key::Multiply, calc::Key::Digit4 };
+        calc::CalculatorEngine engine;
+        for (std::size_t i = 0; i < n; ++i) {
+            for (const calc::Key key : kKeys) {
+                engine.press(key);
+            }
+            bench::doNotOptimize(engine.press(calc::Key::Equals));
+        }
+    });
+}
+
+void benchTrig(bench::Runner& runner)
+{
+    std::vector<double> angles(1024);
+    for (std::size_t i = 0; i < angles.size(); ++i) {
+        angles[i] = static_cast<double>(i) * 0.7 - 300.0;
+    }
+    calc::EvalOptions degrees;
+    calc::EvalOptions radians;
+    radians.angleInDegrees = false;
+
+    const struct {
+        const char* name;
+        calc::OpCode op;
+        const calc::EvalOptions* options;
+    } cases[] = {
+        { "trig/sin degrees", calc::OpCode::Sin, &degrees },
+        { "trig/cos degrees", calc::OpCode::Cos, &degrees },
+        { "trig/tan degrees", calc::OpCode::Tan, &degrees },
+        { "trig/sin radians", calc::OpCode::Sin, &radians },
+    };
+    for (const auto& c : cases) {
+        runner.run(c.name, [&](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) {
+                bench::doNotOptimize(calc::applyUnary(c.op, angles[i % angles.size()], *c.options));
+            }
+        });
+    }
+
+    // 整列求值，每次操作是一个元素
+    std::vector<double> out(angles.size());
+    for (const auto& c : cases) {
+        const std::string name = std::string("trig/batch ") + (c.name + std::strlen("trig/"));
+        runner.run(name, [&](std::size_t n) {
+            for (std::size_t done = 0; done < n; done += angles.size()) {
+                const std::size_t count = std::min(n - done, angles.size());
+                calc::evaluateTrig(c.op, c.options->angleInDegrees, angles.data(), out.data(), count,
+                                   calc::detectSimdLevel());
+                bench::doNotOptimize(out[0]);
+            }
+        });
+    }
+}
+
+void benchFactorial(bench::Runner& runner)
+{
+    const calc::EvalOptions options;
+    runner.run("factorial/double 0..20", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            bench::doNotOptimize(calc::applyUnary(calc::OpCode::Factorial, static_cast<double>(i % 21), options));
+        }
+    });
+    for (const std::uint32_t value : { 100u, 1000u, 10000u }) {
+        runner.run("factorial/bigint " + std::to_string(value), [value](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) {
+                bench::doNotOptimize(calc::BigInt::factorial(value)->digitCount());
+            }
+        });
+    }
+}
+
+} // namespace
+
+void benchPlot(bench::Runner& runner)
+{
+    calc::EvalOptions radians;
+    radians.angleInDegrees = false;
+    // 每次操作是一次完整的自适应采样
+    for (const char* text : { "sin(x)", "tan(x)", "sin(1/x)" }) {
+        const calc::Program program = calc::Program::compile(calc::Expression::compile(text), radians);
+        runner.run(std::string("plot/sample ") + text, [&](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) {
+                bench::doNotOptimize(calc::samplePlot(program, -10.0, 10.0).size());
+            }
+        });
+    }
+
+    // 每次操作是把一千万个点抽稀到 1280 像素宽，相当于界面重绘一帧
+    calc::PlotSamples samples;
+    const std::size_t count = 10000000;
+    samples.xs.resize(count);
+    samples.ys.resize(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        samples.xs[i] = -10.0 + 20.0 * (static_cast<double>(i) / static_cast<double>(count - 1));
+    }
+    calc::evaluateTrig(calc::OpCode::Sin, false, samples.xs.data(), samples.ys.data(), count, calc::detectSimdLevel());
+    calc::PlotViewport view;
+    view.yMin = -1.5;
+    view.yMax = 1.5;
+    view.width = 1280;
+    view.height = 720;
+    std::vector<calc::PlotPoint> points;
+    runner.run("plot/decimate 10M samples", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            calc::decimatePlot(samples, view, points);
+            bench::doNotOptimize(points.size());
+        }
+    });
+}
+
+void benchCalculus(bench::Runner& runner)
+{
+    calc::EvalOptions radians;
+    radians.angleInDegrees = false;
+    // 每次操作是一次完整的积分或求根
+    const struct {
+        const char* name;
+        const char* text;
+        double a;
+        double b;
+    } integrals[] = {
+        { "calculus/integrate e^(-x^2) [-10,10]", "e^(-x^2)", -10.0, 10.0 },
+        { "calculus/integrate sin(100x)^2 [0,10]", "sin(100*x)^2", 0.0, 10.0 },
+    };
+    for (const auto& c : integrals) {
+        const calc::Program program = calc::Program::compile(calc::Expression::compile(c.text), radians);
+        runner.run(c.name, [&](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) {
+                bench::doNotOptimize(calc::integrate(program, c.a, c.b).value);
+            }
+        });
+    }
+    const calc::Program cubic = calc::Program::compile(calc::Expression::compile("x^3-2*x-5"), radians);
+    runner.run("calculus/solve x^3-2x-5", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            bench::doNotOptimize(calc::solve(cubic, 2.0).root);
+        }
+    });
+}
+
+int main(int argc, char* argv[])
+{
+    bench::Options options;
+    if (!parseArguments(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    bench::Runner runner(options.settings);
+    benchExpressions(runner);
+    benchFormat(runner);
+    benchInput(runner);
+    benchTrig(runner);
+    benchFactorial(runner);
+    benchPlot(runner);
+    benchCalculus(runner);
+
+    return bench::report(runner, options, "calc-bench") ? 0 : 1;
+}
@@ -0,0 +1,235 @@
+// 命令行基准程序共用的小型测量框架
+//
+// 每个基准先预热一段时间并校准每个样本的迭代次数，使一个样本至少持续 minSampleTime，
+// 然后重复采样，按每次操作的纳秒数做统计（中位数、均值、标准差、分位数）。
+// 结果可以写成 JSON，也可以与之前保存的 JSON 对比，按中位数报告变化。
+
+#ifndef CALC_TOOLS_BENCHMARK_H
+#define CALC_TOOLS_BENCHMARK_H
+
+#include "samplestats.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+// 阻止编译器把只为测量而计算的值优化掉
+template <typename T>
+inline void doNotOptimize(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+struct Settings {
+    double warmupSeconds = 0.2;
+    double minSampleSeconds = 0.01;
+    int samples = 30;
+    std::string filter;       // 只运行名字包含该子串的基准
+    std::FILE* log = stdout;  // 逐项结果输出到这里，JSON 写到标准输出时改为 stderr
+};
+
+struct Result {
+    std::string name;
+    std::size_t iterations = 0;  // 每个样本的迭代次数
+    calc::SampleStats nsPerOp;
+};
+
+class Runner
+{
+public:
+    explicit Runner(const Settings& settings) : settings(settings) {}
+
+    // fn(iterations) 执行 iterations 次被测操作
+    template <typename Fn>
+    void run(const std::string& name, Fn&& fn);
+
+    const std::vector<Result>& results() const { return all; }
+
+    bool writeJson(const std::string& path) const;
+    // 与 baseline（writeJson 的输出）按名字对比中位数，打印变化百分比
+    bool compare(const std::string& baselinePath) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    template <typename Fn>
+    static double secondsFor(Fn& fn, std::size_t iterations)
+    {
+        const Clock::time_point start = Clock::now();
+        fn(iterations);
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    Settings settings;
+    std::vector<Result> all;
+};
+
+template <typename Fn>
+void Runner::run(const std::string& name, Fn&& fn)
+{
+    if (!settings.filter.empty() && name.find(settings.filter) == std::string::npos) {
+        return;
+    }
+
+    // 预热期间顺便校准：迭代次数翻倍直到单次调用足够长
+    std::size_t iterations = 1;
+    double warmed = 0.0;
+    for (;;) {
+        const double elapsed = secondsFor(fn, iterations);
+        warmed += elapsed;
+        if (elapsed >= settings.minSampleSeconds && warmed >= settings.warmupSeconds) {
+            break;
+        }
+        if (elapsed < settings.minSampleSeconds) {
+            iterations *= 2;
+        }
+    }
+
+    std::vector<double> samples;
+    samples.reserve(static_cast<std::size_t>(settings.samples));
+    for (int i = 0; i < settings.samples; ++i) {
+        samples.push_back(secondsFor(fn, iterations) * 1e9 / static_cast<double>(iterations));
+    }
+
+    Result result;
+    result.name = name;
+    result.iterations = iterations;
+    result.nsPerOp = calc::summarizeSamples(samples);
+    const calc::SampleStats& s = result.nsPerOp;
+    std::fprintf(settings.log, "%-34s %12.1f ns  ±%5.1f%%  (min %.1f, p90 %.1f, %zu x %d)\n", name.c_str(), s.p50,
+                s.mean > 0.0 ? 100.0 * s.stddev / s.mean : 0.0, s.min, s.p90, iterations, settings.samples);
+    std::fflush(settings.log);
+    all.push_back(result);
+}
+
+inline bool Runner::writeJson(const std::string& path) const
+{
+    std::ostringstream out;
+    out << "{\n  \"settings\": {\"warmup_s\": " << settings.warmupSeconds << ", \"min_sample_s\": "
+        << settings.minSampleSeconds << ", \"samples\": " << settings.samples << "},\n  \"benchmarks\": [\n";
+    for (std::size_t i = 0; i < all.size(); ++i) {
+        const Result& r = all[i];
+        const calc::SampleStats& s = r.nsPerOp;
+        out << "    {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations << ", \"samples\": " << s.count
+            << ", \"median_ns\": " << s.p50 << ", \"mean_ns\": " << s.mean << ", \"stddev_ns\": " << s.stddev
+            << ", \"min_ns\": " << s.min << ", \"p90_ns\": " << s.p90 << ", \"max_ns\": " << s.max << "}"
+            << (i + 1 < all.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+
+    if (path == "-") {
+        std::fputs(out.str().c_str(), stdout);
+        return true;
+    }
+    std::ofstream file(path);
+    file << out.str();
+    return static_cast<bool>(file);
+}
+
+inline bool Runner::compare(const std::string& baselinePath) const
+{
+    std::ifstream file(baselinePath);
+    if (!file) {
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string text = buffer.str();
+
+    // 只读取 writeJson 自己写出的格式：每个条目的 name 之后跟着 median_ns
+    std::map<std::string, double> baseline;
+    const std::string nameKey = "\"name\": \"";
+    const std::string medianKey = "\"median_ns\": ";
+    for (std::size_t pos = text.find(nameKey); pos != std::string::npos; pos = text.find(nameKey, pos)) {
+        pos += nameKey.size();
+        const std::size_t end = text.find('"', pos);
+        const std::size_t median = text.find(medianKey, end);
+        if (end == std::string::npos || median == std::string::npos) {
+            break;
+        }
+        baseline[text.substr(pos, end - pos)] = std::strtod(text.c_str() + median + medianKey.size(), nullptr);
+    }
+
+    std::printf("\n%-34s %12s %12s %9s\n", "vs baseline", "before ns", "after ns", "change");
+    for (const Result& r : all) {
+        const auto it = baseline.find(r.name);
+        if (it == baseline.end() || it->second <= 0.0) {
+            std::printf("%-34s %12s %12.1f %9s\n", r.name.c_str(), "-", r.nsPerOp.p50, "new");
+            continue;
+        }
+        std::printf("%-34s %12.1f %12.1f %+8.1f%%\n", r.name.c_str(), it->second, r.nsPerOp.p50,
+                    100.0 * (r.nsPerOp.p50 / it->second - 1.0));
+    }
+    return true;
+}
+
+// 各基准程序共用的命令行选项
+struct Options {
+    Settings settings;
+    const char* json = nullptr;      // 结果写成 JSON，"-" 表示标准输出
+    const char* baseline = nullptr;  // 与之前保存的 JSON 对比
+};
+
+constexpr const char* kOptionsUsage = "[--filter text] [--samples n] [--warmup seconds] [--json file|-] [--baseline file]";
+
+// argv[i] 是共用选项时读入它和它的参数并返回 true，i 停在最后一个用掉的参数上
+inline bool parseOption(int argc, char* argv[], int& i, Options& options)
+{
+    if (i + 1 >= argc) {
+        return false;
+    }
+    if (std::strcmp(argv[i], "--filter") == 0) {
+        options.settings.filter = argv[++i];
+    }
+    else if (std::strcmp(argv[i], "--samples") == 0) {
+        options.settings.samples = std::atoi(argv[++i]);
+    }
+    else if (std::strcmp(argv[i], "--warmup") == 0) {
+        options.settings.warmupSeconds = std::strtod(argv[++i], nullptr);
+    }
+    else if (std::strcmp(argv[i], "--json") == 0) {
+        options.json = argv[++i];
+        // JSON 占用标准输出时，逐项结果改写到标准错误
+        if (std::strcmp(options.json, "-") == 0) {
+            options.settings.log = stderr;
+        }
+    }
+    else if (std::strcmp(argv[i], "--baseline") == 0) {
+        options.baseline = argv[++i];
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+// 按选项写出 JSON、与基线对比；失败时以 program 为前缀报错并返回 false
+inline bool report(const Runner& runner, const Options& options, const char* program)
+{
+    if (options.json && !runner.writeJson(options.json)) {
+        std::fprintf(stderr, "%s: cannot write %s\n", program, options.json);
+        return false;
+    }
+    if (options.baseline && !runner.compare(options.baseline)) {
+        std::fprintf(stderr, "%s: cannot read %s\n", program, options.baseline);
+        return false;
+    }
+    return true;
+}
+
+} // namespace bench
+
+#endif // CALC_TOOLS_BENCHMARK_H
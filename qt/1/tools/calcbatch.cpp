@@ -0,0 +1,398 @@
+// calc-batch：不依赖 Qt 的批量求值工具
+//
+// 用法: calc-batch [-j 线程数] [--radians] [-q] [--cache 条数] [--column 表达式]
+//                   [--integrate a b | --solve x0] [文件|-]
+// 从文件或标准输入逐行读取表达式，在线程池中求值，按输入顺序逐行输出结果，
+// 结束时在标准错误输出吞吐量统计。语法错误和除以零等求值错误的行输出 error 和原因，退出码为 1。
+// 指定 --column 时输入改为每行一个数值，作为 x 代入同一个表达式做 SIMD 列求值。
+// 指定 --cache 时各线程共享一个 LRU 结果缓存，结束时一并输出命中统计。
+// 指定 --integrate 或 --solve 时每行是 x 的函数，输出它在 [a, b] 上的积分或 x0 附近的根，
+// 没有收敛的行输出 error 和最好的结果。
+
+#include "calculatorengine.h"
+#include "expression.h"
+#include "numeric.h"
+#include "resultcache.h"
+#include "vectoreval.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t kChunkLines = 4096;     // 每个任务块包含的行数
+constexpr std::size_t kColumnChunk = 1 << 16;  // 列模式每次求值的数值个数
+constexpr std::size_t kCalculusChunkLines = 16; // 积分、求根每行耗时较多，块小一些才能分给各线程
+
+struct Options {
+    unsigned threads = 0;
+    bool radians = false;
+    bool quiet = false;
+    const char* path = nullptr;
+    const char* column = nullptr;  // 列模式的表达式
+    std::size_t cacheSize = 0;     // 结果缓存条数，0 表示不缓存
+    bool integrate = false;        // 对每行求 [lower, upper] 上的积分
+    double lower = 0.0;
+    double upper = 0.0;
+    bool solve = false;            // 对每行求 start 附近的根
+    double start = 0.0;
+};
+
+// 一块连续的输入行及其输出文本
+struct Chunk {
+    std::size_t index = 0;
+    std::vector<std::string> lines;
+    std::string output;
+    std::size_t errors = 0;
+};
+
+void usage()
+{
+    std::fprintf(stderr, "usage: calc-batch [-j threads] [--radians] [-q] [--cache entries] [--column expr]\n"
+                         "                  [--integrate a b | --solve x0] [file|-]\n");
+}
+
+bool parseArguments(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strcmp(arg, "-j") == 0 && i + 1 < argc) {
+            options.threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(arg, "--cache") == 0 && i + 1 < argc) {
+            options.cacheSize = static_cast<std::size_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(arg, "--column") == 0 && i + 1 < argc) {
+            options.column = argv[++i];
+        }
+        else if (std::strcmp(arg, "--integrate") == 0 && i + 2 < argc) {
+            options.integrate = true;
+            options.lower = std::strtod(argv[++i], nullptr);
+            options.upper = std::strtod(argv[++i], nullptr);
+        }
+        else if (std::strcmp(arg, "--solve") == 0 && i + 1 < argc) {
+            options.solve = true;
+            options.start = std::strtod(argv[++i], nullptr);
+        }
+        else if (std::strcmp(arg, "--radians") == 0) {
+            options.radians = true;
+        }
+        else if (std::strcmp(arg, "-q") == 0) {
+            options.quiet = true;
+        }
+        else if (std::strcmp(arg, "-h") == 0 || std::strcmp(arg, "--help") == 0) {
+            return false;
+        }
+        else if (!options.path) {
+            options.path = arg;
+        }
+        else {
+            return false;
+        }
+    }
+    return !(options.integrate && options.solve);
+}
+
+// 积分或求根：整行编译一次，之后直接在字节码上求值。
+// 未收敛时返回 false，value 仍是最好的结果
+bool evaluateCalculus(const calc::Expression& expr, const Options& options, const calc::EvalOptions& evalOptions,
+                      double& value)
+{
+    const calc::Program program = calc::Program::compile(expr, evalOptions);
+    if (options.integrate) {
+        // 行之间已经并行，单个积分不再开线程
+        calc::IntegrateOptions integrateOptions;
+        integrateOptions.threads = 1;
+        const calc::IntegralResult result = calc::integrate(program, options.lower, options.upper, integrateOptions);
+        value = result.value;
+        return result.converged;
+    }
+    const calc::SolveResult result = calc::solve(program, options.start);
+    value = result.root;
+    return result.converged;
+}
+
+void evaluateChunk(Chunk& chunk, const Options& batchOptions, const calc::EvalOptions& options,
+                   calc::ResultCache* cache)
+{
+    char buffer[64];
+    for (const std::string& line : chunk.lines) {
+        if (line.empty()) {
+            chunk.output += '\n';
+            continue;
+        }
+
+        const calc::Expression expr = calc::Expression::compile(line);
+        if (!expr.isValid()) {
+            ++chunk.errors;
+            const int n = std::snprintf(buffer, sizeof(buffer), "error: %s at %zu\n",
+                                        calc::describe(expr.parseError()), expr.errorPosition() + 1);
+            chunk.output.append(buffer, static_cast<std::size_t>(n));
+            continue;
+        }
+
+        if (batchOptions.integrate || batchOptions.solve) {
+            double value = 0.0;
+            if (!evaluateCalculus(expr, batchOptions, options, value)) {
+                ++chunk.errors;
+                chunk.output += "error: not converged, best ";
+            }
+            const auto result = std::to_chars(buffer, buffer + sizeof(buffer) - 1, value);
+            *result.ptr = '\n';
+            chunk.output.append(buffer, static_cast<std::size_t>(result.ptr - buffer + 1));
+            continue;
+        }
+
+        const double value = cache ? calc::evaluateCached(expr, options, *cache) : expr.evaluate(options);
+        if (!std::isfinite(value)) {
+            // 除以零、负数开方等得到 inf/NaN，和界面一样报出原因
+            ++chunk.errors;
+            const int n = std::snprintf(buffer, sizeof(buffer), "error: %s\n",
+                                        calc::describe(calc::diagnoseFailure(expr, options)));
+            chunk.output.append(buffer, static_cast<std::size_t>(n));
+            continue;
+        }
+        // 最短往返格式，保证输出可被精确读回
+        const auto result = std::to_chars(buffer, buffer + sizeof(buffer) - 1, value);
+        *result.ptr = '\n';
+        chunk.output.append(buffer, static_cast<std::size_t>(result.ptr - buffer + 1));
+    }
+    chunk.lines.clear();
+    chunk.lines.shrink_to_fit();
+}
+
+// 列模式：一次编译，按块读入数值后整列求值
+int runColumn(std::istream& input, const Options& options, const calc::EvalOptions& evalOptions)
+{
+    const calc::Expression expr = calc::Expression::compile(options.column);
+    if (!expr.isValid()) {
+        std::fprintf(stderr, "calc-batch: %s at %zu in --column expression\n",
+                     calc::describe(expr.parseError()), expr.errorPosition() + 1);
+        return 2;
+    }
+    const calc::Program program = calc::Program::compile(expr, evalOptions);
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<double> values;
+    values.reserve(kColumnChunk);
+    std::string line;
+    std::string output;
+    std::size_t total = 0;
+    std::size_t errors = 0;
+    char buffer[64];
+
+    auto flush = [&] {
+        calc::evaluateColumn(program, values.data(), values.data(), values.size());
+        output.clear();
+        for (const double value : values) {
+            const auto result = std::to_chars(buffer, buffer + sizeof(buffer) - 1, value);
+            *result.ptr = '\n';
+            output.append(buffer, static_cast<std::size_t>(result.ptr - buffer + 1));
+        }
+        std::fwrite(output.data(), 1, output.size(), stdout);
+        total += values.size();
+        values.clear();
+    };
+
+    while (std::getline(input, line)) {
+        double value = std::numeric_limits<double>::quiet_NaN();
+        const char* begin = line.data();
+        const char* end = begin + line.size();
+        while (begin != end && (*begin == ' ' || *begin == '\t')) {
+            ++begin;
+        }
+        if (std::from_chars(begin, end, value).ec != std::errc()) {
+            value = std::numeric_limits<double>::quiet_NaN();
+            ++errors;
+        }
+        values.push_back(value);
+        if (values.size() == kColumnChunk) {
+            flush();
+        }
+    }
+    if (!values.empty()) {
+        flush();
+    }
+    std::fflush(stdout);
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!options.quiet) {
+        std::fprintf(stderr, "calc-batch: %zu values, %zu unparsable, %.3f s, %.0f values/s, %s\n",
+                     total, errors, seconds, seconds > 0 ? total / seconds : 0.0,
+                     calc::toString(calc::detectSimdLevel()));
+    }
+    return errors == 0 ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+    if (options.threads == 0) {
+        options.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::ios::sync_with_stdio(false);
+    std::ifstream file;
+    std::istream* input = &std::cin;
+    if (options.path && std::strcmp(options.path, "-") != 0) {
+        file.open(options.path, std::ios::binary);
+        if (!file) {
+            std::fprintf(stderr, "calc-batch: cannot open %s\n", options.path);
+            return 1;
+        }
+        input = &file;
+    }
+
+    calc::EvalOptions evalOptions;
+    evalOptions.angleInDegrees = !options.radians;
+    if (options.column) {
+        return runColumn(*input, options, evalOptions);
+    }
+
+    std::unique_ptr<calc::ResultCache> cache;
+    if (options.cacheSize > 0) {
+        cache = std::make_unique<calc::ResultCache>(options.cacheSize);
+    }
+
+    // 读取线程按块投递任务，工作线程并行求值，写出线程按块序号顺序输出；
+    // 同时在途的块数有上限，内存占用与输入总量无关
+    const std::size_t maxInFlight = options.threads * 2;
+    std::mutex mutex;
+    std::condition_variable workReady;
+    std::condition_variable doneReady;
+    std::condition_variable slotFree;
+    std::deque<Chunk> pending;
+    std::map<std::size_t, Chunk> finished;
+    std::size_t inFlight = 0;
+    std::size_t chunkCount = 0;
+    bool inputDone = false;
+
+    std::vector<std::thread> workers;
+    workers.reserve(options.threads);
+    for (unsigned i = 0; i < options.threads; ++i) {
+        workers.emplace_back([&] {
+            for (;;) {
+                Chunk chunk;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    workReady.wait(lock, [&] { return !pending.empty() || inputDone; });
+                    if (pending.empty()) {
+                        return;
+                    }
+                    chunk = std::move(pending.front());
+                    pending.pop_front();
+                }
+                evaluateChunk(chunk, options, evalOptions, cache.get());
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    const std::size_t index = chunk.index;
+                    finished.emplace(index, std::move(chunk));
+                }
+                doneReady.notify_one();
+            }
+        });
+    }
+
+    std::size_t totalLines = 0;
+    std::size_t totalErrors = 0;
+    std::thread writer([&] {
+        for (std::size_t next = 0;; ++next) {
+            Chunk chunk;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                doneReady.wait(lock, [&] { return finished.count(next) != 0 || (inputDone && next == chunkCount); });
+                auto it = finished.find(next);
+                if (it == finished.end()) {
+                    return;
+                }
+                chunk = std::move(it->second);
+                finished.erase(it);
+                --inFlight;
+            }
+            slotFree.notify_one();
+            totalErrors += chunk.errors;
+            std::fwrite(chunk.output.data(), 1, chunk.output.size(), stdout);
+        }
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::size_t chunkLines = options.integrate || options.solve ? kCalculusChunkLines : kChunkLines;
+    Chunk chunk;
+    std::string line;
+    auto submit = [&] {
+        std::unique_lock<std::mutex> lock(mutex);
+        slotFree.wait(lock, [&] { return inFlight < maxInFlight; });
+        chunk.index = chunkCount++;
+        ++inFlight;
+        pending.push_back(std::move(chunk));
+        lock.unlock();
+        workReady.notify_one();
+        chunk = Chunk();
+        chunk.lines.reserve(chunkLines);
+    };
+
+    chunk.lines.reserve(chunkLines);
+    while (std::getline(*input, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        chunk.lines.push_back(std::move(line));
+        ++totalLines;
+        if (chunk.lines.size() == chunkLines) {
+            submit();
+        }
+    }
+    if (!chunk.lines.empty()) {
+        submit();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        inputDone = true;
+    }
+    workReady.notify_all();
+    doneReady.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    doneReady.notify_all();
+    writer.join();
+    std::fflush(stdout);
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!options.quiet) {
+        std::fprintf(stderr, "calc-batch: %zu expressions, %zu errors, %.3f s, %.0f expr/s, %u threads\n",
+                     totalLines, totalErrors, seconds, seconds > 0 ? totalLines / seconds : 0.0, options.threads);
+        if (cache) {
+            const calc::CacheStats stats = cache->stats();
+            std::fprintf(stderr, "calc-batch: cache %llu hits, %llu misses, %llu evictions; subexpressions %llu hits, %llu misses\n",
+                         static_cast<unsigned long long>(stats.hits), static_cast<unsigned long long>(stats.misses),
+                         static_cast<unsigned long long>(stats.evictions),
+                         static_cast<unsigned long long>(stats.subexpressionHits),
+                         static_cast<unsigned long long>(stats.subexpressionMisses));
+        }
+    }
+    return totalErrors == 0 ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+// calc-formatbench：结果格式化的微基准
+//
+// 用法: calc-formatbench [--filter 子串] [--samples n] [--warmup 秒] [--json 文件|-] [--baseline 文件]
+// 对比旧实现（按 10 位小数格式化后逐个 chop 末尾的 0，每次返回新字符串）
+// 与 calc::formatNumber 写栈缓冲区的新实现。用 benchmark.h 预热、采样，报告每次调用耗时的中位数和离散程度。
+
+#include "benchmark.h"
+
+#include "numberformat.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// 旧版 MainWindow::formatNumber 的等价实现
+std::string legacyFormatNumber(double number)
+{
+    if (std::fabs(number) < 1e-10) {
+        return "0";
+    }
+    char buffer[64];
+    if (std::fabs(number) >= 1e10 || std::fabs(number) < 1e-6) {
+        std::snprintf(buffer, sizeof(buffer), "%.6e", number);
+        return buffer;
+    }
+    std::string result(buffer, static_cast<std::size_t>(std::snprintf(buffer, sizeof(buffer), "%.10f", number)));
+    if (result.find('.') != std::string::npos) {
+        while (!result.empty() && result.back() == '0') {
+            result.pop_back();
+        }
+        if (!result.empty() && result.back() == '.') {
+            result.pop_back();
+        }
+    }
+    return result;
+}
+
+void usage()
+{
+    std::fprintf(stderr, "usage: calc-formatbench %s\n", bench::kOptionsUsage);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    bench::Options options;
+    for (int i = 1; i < argc; ++i) {
+        if (!bench::parseOption(argc, argv, i, options)) {
+            usage();
+            return 2;
+        }
+    }
+
+    // 典型计算结果：整数、两位小数、运算误差（如 0.1 + 0.2）、大数和小数
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> uniform(-1e6, 1e6);
+    std::vector<double> values;
+    for (int i = 0; i < 20000; ++i) {
+        values.push_back(std::round(uniform(rng)));
+        values.push_back(std::round(uniform(rng) * 100) / 100);
+        values.push_back(uniform(rng) / 3);
+        values.push_back(0.1 * (i % 10) + 0.2);
+        values.push_back(uniform(rng) * 1e8);
+        values.push_back(uniform(rng) * 1e-12);
+    }
+
+    bench::Runner runner(options.settings);
+    runner.run("format/legacy chop loop", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            bench::doNotOptimize(legacyFormatNumber(values[i % values.size()]).size());
+        }
+    });
+    runner.run("format/formatNumber string", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            bench::doNotOptimize(calc::formatNumber(values[i % values.size()]).size());
+        }
+    });
+    runner.run("format/formatNumber buffer", [&](std::size_t n) {
+        char buffer[calc::kNumberBufferSize];
+        for (std::size_t i = 0; i < n; ++i) {
+            bench::doNotOptimize(calc::formatNumber(values[i % values.size()], buffer));
+        }
+    });
+
+    std::size_t changed = 0;
+    for (const double value : values) {
+        changed += legacyFormatNumber(value) != calc::formatNumber(value);
+    }
+    std::fprintf(options.settings.log,
+                 "changed output: %zu of %zu values (binary noise beyond the shortest representation)\n", changed,
+                 values.size());
+
+    return bench::report(runner, options, "calc-formatbench") ? 0 : 1;
+}
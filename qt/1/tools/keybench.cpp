@@ -0,0 +1,297 @@
+// calc-keybench：按键处理的微基准
+//
+// 用法: calc-keybench [--keys 个数] [--preview] [--max-p99 微秒] [--filter 子串] [--samples n] [--warmup 秒]
+//                     [--json 文件|-] [--baseline 文件] [文件]
+// 不启动界面，把一串按键逐个交给 calc::CalculatorEngine::press。
+// 按键序列默认随机生成（数字、运算符、括号、退格、正负号、撤销，偶尔求值），
+// 也可以从文件读取：界面 --record 录下的按键文件，或用 calc::keyFromChar 单字符记法写的文本。
+// 指定 --preview 时每次按键之后再像界面一样增量求值一次实时预览。
+// 每键平均耗时由 benchmark.h 循环回放按键序列测得，可写成 JSON 或与基线对比；
+// 之后再从头逐键回放一遍，统计每键耗时的分位数、堆分配次数和按键引起的计算错误。
+// 指定 --max-p99 时 p99 超过该值以退出码 1 结束，可以用作性能回归检查。
+
+#include "benchmark.h"
+
+#include "calculatorengine.h"
+#include "incremental.h"
+#include "keytrace.h"
+#include "samplestats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// 统计本进程的全部堆分配
+std::atomic<std::size_t> allocationCount{0};
+
+struct Options {
+    bench::Options bench;
+    std::size_t keys = 1000000;
+    bool preview = false;
+    double maxP99 = 0.0;  // 微秒，0 表示不检查
+    const char* path = nullptr;
+};
+
+void usage()
+{
+    std::fprintf(stderr, "usage: calc-keybench [--keys count] [--preview] [--max-p99 us] %s [file]\n",
+                 bench::kOptionsUsage);
+}
+
+bool parseArguments(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--keys") == 0 && i + 1 < argc) {
+            options.keys = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--preview") == 0) {
+            options.preview = true;
+        }
+        else if (std::strcmp(argv[i], "--max-p99") == 0 && i + 1 < argc) {
+            options.maxP99 = std::strtod(argv[++i], nullptr);
+        }
+        else if (bench::parseOption(argc, argv, i, options.bench)) {
+            continue;
+        }
+        else if (argv[i][0] == '-') {
+            return false;
+        }
+        else {
+            options.path = argv[i];
+        }
+    }
+    return options.keys > 0 && options.bench.settings.samples > 1;
+}
+
+// 模拟输入一条很长的公式：多位数字与运算符交替，夹杂括号、改错和撤销，
+// 平均每两千键求值一次、每两万键全部清除一次
+std::vector<calc::Key> randomKeys(std::size_t count)
+{
+    static const char kOperators[] = "+-*/^";
+    std::mt19937 rng(42);
+    std::vector<calc::Key> keys;
+    keys.reserve(count);
+    std::string pending;
+    while (keys.size() < count) {
+        const unsigned roll = rng() % 1000;
+        if (roll < 1) {
+            pending = "c";
+        }
+        else if (roll < 6) {
+            pending = "=";
+        }
+        else if (roll < 40) {
+            pending = "(";
+        }
+        else if (roll < 75) {
+            pending = ")";
+        }
+        else if (roll < 110) {
+            pending = "<";
+        }
+        else if (roll < 120) {
+            pending = "~";
+        }
+        else if (roll < 130) {
+            pending = rng() % 2 ? "z" : "zy";
+        }
+        else {
+            const std::size_t digits = 1 + rng() % 6;
+            pending.clear();
+            for (std::size_t i = 0; i < digits; ++i) {
+                pending += static_cast<char>('0' + rng() % 10);
+            }
+            if (rng() % 5 == 0) {
+                pending += '.';
+                pending += static_cast<char>('0' + rng() % 10);
+            }
+            pending += kOperators[rng() % 5];
+        }
+        for (const char c : pending) {
+            if (keys.size() < count) {
+                keys.push_back(*calc::keyFromChar(c));
+            }
+        }
+    }
+    return keys;
+}
+
+bool readKeys(const char* path, std::vector<calc::Key>& keys)
+{
+    std::vector<calc::KeyEvent> events;
+    if (calc::readKeyTrace(path, events)) {
+        for (const calc::KeyEvent& event : events) {
+            keys.push_back(event.key);
+        }
+        return true;
+    }
+
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    const std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    for (const char c : text) {
+        if (const std::optional<calc::Key> key = calc::keyFromChar(c)) {
+            keys.push_back(*key);
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    std::vector<calc::Key> keys;
+    if (options.path) {
+        if (!readKeys(options.path, keys)) {
+            std::fprintf(stderr, "calc-keybench: cannot read %s\n", options.path);
+            return 1;
+        }
+    }
+    else {
+        keys = randomKeys(options.keys);
+    }
+    if (keys.empty()) {
+        std::fprintf(stderr, "calc-keybench: no keys\n");
+        return 1;
+    }
+
+    calc::CalculatorEngine engine;
+    calc::IncrementalEvaluator preview;
+    std::string entry;
+    entry.reserve(1 << 16);
+    double sink = 0.0;
+    auto press = [&](calc::Key key) {
+        const calc::ErrorCode error = engine.press(key, &entry);
+        if (options.preview) {
+            const calc::Rope pending = engine.pendingExpression();
+            if (!pending.empty()) {
+                sink += preview.evaluate(pending, engine.takeUnchangedPrefix());
+            }
+        }
+        return error;
+    };
+
+    // 每键平均耗时：循环回放按键序列，每轮从全部清除开始
+    bench::Runner runner(options.bench.settings);
+    std::size_t next = keys.size();
+    runner.run(options.preview ? "keys/press with preview" : "keys/press", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            if (next == keys.size()) {
+                press(calc::Key::ClearAll);
+                next = 0;
+            }
+            press(keys[next++]);
+        }
+    });
+
+    // 分位数和分配次数要逐键记录，框架只给出平均值，所以从头再回放一遍。
+    // 求值本身要编译表达式，分配次数与按键处理分开统计
+    press(calc::Key::ClearAll);
+    std::size_t equalsCount = 0;
+    std::size_t equalsAllocations = 0;
+    std::size_t keyAllocations = 0;
+    std::size_t longestExpression = 0;
+    std::size_t errorCounts[calc::kErrorCodeCount] = {};
+    std::vector<double> latencies;
+    latencies.reserve(keys.size());
+
+    using Clock = std::chrono::steady_clock;
+    for (const calc::Key key : keys) {
+        const Clock::time_point before = Clock::now();
+        const std::size_t allocationsBefore = allocationCount.load(std::memory_order_relaxed);
+        const calc::ErrorCode error = press(key);
+        const std::size_t allocations = allocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+        latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - before).count());
+        ++errorCounts[static_cast<std::size_t>(error)];
+        if (key == calc::Key::Equals) {
+            ++equalsCount;
+            equalsAllocations += allocations;
+        }
+        else {
+            keyAllocations += allocations;
+            longestExpression = std::max(longestExpression, engine.state().displayText.size());
+        }
+    }
+    bench::doNotOptimize(sink);
+
+    std::FILE* log = options.bench.settings.log;
+    const std::size_t otherKeys = keys.size() - equalsCount;
+    const calc::SampleStats stats = calc::summarizeSamples(latencies);
+    std::fprintf(log, "keys              %zu (%zu x '=')%s\n", keys.size(), equalsCount,
+                 options.preview ? " with preview" : "");
+    std::fprintf(log, "per key (us)      mean %.3f  p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  max %.1f\n",
+                 stats.mean, stats.p50, stats.p90, stats.p99, stats.p999, stats.max);
+    std::fprintf(log, "allocations/key   %.4f (excluding '=', %zu total)\n",
+                 otherKeys ? static_cast<double>(keyAllocations) / otherKeys : 0.0, keyAllocations);
+    std::fprintf(log, "allocations/'='   %.1f\n",
+                 equalsCount ? static_cast<double>(equalsAllocations) / equalsCount : 0.0);
+    std::fprintf(log, "longest formula   %zu bytes\n", longestExpression);
+    for (std::size_t i = 1; i < calc::kErrorCodeCount; ++i) {
+        if (errorCounts[i] > 0) {
+            std::fprintf(log, "errors            %zu x %s\n", errorCounts[i],
+                         calc::describe(static_cast<calc::ErrorCode>(i)));
+        }
+    }
+    if (!bench::report(runner, options.bench, "calc-keybench")) {
+        return 1;
+    }
+    if (options.maxP99 > 0.0 && stats.p99 > options.maxP99) {
+        std::fprintf(stderr, "calc-keybench: p99 %.3f us exceeds %.3f us\n", stats.p99, options.maxP99);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include "tracedapplication.h"
+
+#include <QEvent>
+#include <QMetaEnum>
+
+TracedApplication::TracedApplication(int& argc, char** argv)
+    : QApplication(argc, argv)
+    , trace(nullptr)
+    , display(nullptr)
+    , depth(0)
+{
+}
+
+void TracedApplication::startTrace(calc::LatencyTrace* trace, QWidget* display)
+{
+    this->trace = trace;
+    this->display = display;
+}
+
+bool TracedApplication::notify(QObject* receiver, QEvent* event)
+{
+    if (!trace) {
+        return QApplication::notify(receiver, event);
+    }
+
+    // 处理过程中接收者可能被删除，事先取出之后要用的信息
+    const QEvent::Type type = event->type();
+    const char* className = receiver->metaObject()->className();
+    const bool topLevel = depth == 0;
+
+    const calc::LatencyTrace::Micros start = trace->now();
+    ++depth;
+    const bool handled = QApplication::notify(receiver, event);
+    --depth;
+    const calc::LatencyTrace::Micros duration = trace->now() - start;
+
+    if (receiver == display && type == QEvent::Paint) {
+        trace->displayPainted(start, start + duration);
+    }
+    else if (trace->shouldRecord(duration)) {
+        const char* typeName = QMetaEnum::fromType<QEvent::Type>().valueToKey(type);
+        std::string name = typeName ? typeName : "Event " + std::to_string(static_cast<int>(type));
+        name += " -> ";
+        name += className;
+        trace->eventHandled(name, start, duration, topLevel);
+    }
+    return handled;
+}
@@ -0,0 +1,26 @@
+#ifndef TRACEDAPPLICATION_H
+#define TRACEDAPPLICATION_H
+
+#include <QApplication>
+#include "engine/latencytrace.h"
+
+// 可选的事件分发计时。startTrace 之后每个事件的处理时长都报告给 calc::LatencyTrace：
+// 由事件循环直接分发、处理超过阈值的事件记为卡顿（模态对话框的 exec() 也会这样暴露出来），
+// 发给显示器的 Paint 事件另外计为一次显示器绘制。没有开始记录时只多一次指针判断
+class TracedApplication : public QApplication
+{
+public:
+    TracedApplication(int& argc, char** argv);
+
+    // trace 由调用者持有，必须比本对象活得久；display 是要测量绘制的控件
+    void startTrace(calc::LatencyTrace* trace, QWidget* display);
+
+    bool notify(QObject* receiver, QEvent* event) override;
+
+private:
+    calc::LatencyTrace* trace;
+    QWidget* display;
+    int depth;  // notify 的嵌套层数，0 表示正在处理的事件来自事件循环
+};
+
+#endif // TRACEDAPPLICATION_H